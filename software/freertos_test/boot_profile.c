@@ -0,0 +1,60 @@
+#include "sys/alt_irq.h"
+
+#include "FreeRTOS/FreeRTOS.h"
+
+#include "boot_profile.h"
+#include "log.h"
+
+static const char * const phase_names[BOOT_PHASES] = {"alt_main", "main", "scheduler", "first sample", "protection", "keyboard", "display"};
+
+static unsigned int phase_time[BOOT_PHASES];
+static volatile unsigned int reached = 0; // bit per phase
+
+void __real_alt_main(void);
+
+// Entered from crt0 in place of alt_main, see the --wrap option in the Makefile
+void __wrap_alt_main(void)
+{
+	vPortTimestampStart();
+	boot_mark(BOOT_ALT_MAIN);
+	__real_alt_main();
+}
+
+static void boot_report(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < BOOT_PHASES; i++) {
+		LOG("boot: %s at %u us\n", phase_names[i], (phase_time[i] - phase_time[BOOT_ALT_MAIN]) / (portTIMESTAMP_HZ / 1000000));
+	}
+}
+
+void boot_mark(boot_phase phase)
+{
+	unsigned int now;
+	int done;
+	alt_irq_context ctx;
+
+	if (reached & (1 << phase)) {
+		return; // the common case, cheap enough to leave in the analyser ISR
+	}
+	now = ulPortGetTimestamp();
+	ctx = alt_irq_disable_all();
+	if (reached & (1 << phase)) {
+		alt_irq_enable_all(ctx);
+		return;
+	}
+	phase_time[phase] = now;
+	reached |= 1 << phase;
+	done = (reached == (1 << BOOT_PHASES) - 1);
+	alt_irq_enable_all(ctx);
+
+	if (done) {
+		boot_report();
+	}
+}
+
+int boot_reached(boot_phase phase)
+{
+	return (reached & (1 << phase)) != 0;
+}
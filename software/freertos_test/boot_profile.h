@@ -0,0 +1,38 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+/*
+ * Boot phase timestamps, from alt_main to the first frame on the VGA display.
+ *
+ * The application is linked with -Wl,--wrap=alt_main so boot_profile.c runs first: it starts the
+ * port timestamp (vPortTimestampStart) and then calls the HAL's alt_main. Every phase is timed
+ * from there with ulPortGetTimestamp(), and the table is LOGged once all phases are reached.
+ * The reset handler in crt0 (cache initialisation, clearing .bss) runs before alt_main and is
+ * not counted.
+ *
+ * With BOOT_PROTECTION_FIRST set, main() only starts what frequency protection needs (the
+ * analyser ISR, the RoC and load management tasks) and Init_Task brings up the journal,
+ * keyboard, buttons and display once the first sample has been through the threshold check.
+ * Cleared, everything is initialised in main() before the scheduler starts, as before.
+ */
+
+#define BOOT_PROTECTION_FIRST 1
+#define BOOT_PROTECTION_WAIT_MS 100 // Init_Task gives up waiting for the first sample after this
+
+typedef enum {
+	BOOT_ALT_MAIN, // time 0
+	BOOT_MAIN, // HAL drivers initialised by alt_sys_init, including the LCD power-on delays
+	BOOT_SCHEDULER, // vTaskStartScheduler() called
+	BOOT_FIRST_SAMPLE, // first analyser interrupt
+	BOOT_PROTECTION, // first sample through the threshold check, the FSM can shed from here on
+	BOOT_KEYBOARD, // PS/2 keyboard and push buttons initialised
+	BOOT_DISPLAY, // VGA cleared and axes drawn, or the first seven-segment write when headless
+	BOOT_PHASES
+} boot_phase;
+
+// The first call for each phase counts. Safe to call from tasks, ISRs and before the scheduler starts
+void boot_mark(boot_phase phase);
+
+int boot_reached(boot_phase phase);
+
+#endif /* BOOT_PROFILE_H */
@@ -0,0 +1,92 @@
+#include <string.h>
+
+#include "command.h"
+
+void cmd_parser_init(cmd_parser *p)
+{
+	memset(p, 0, sizeof(*p));
+}
+
+int cmd_parser_feed(cmd_parser *p, uint8_t byte)
+{
+	switch (p->received) {
+	case 0:
+		if (byte != CMD_SYNC) {
+			return 0; // hunting, a lost frame resynchronises on the next sync byte
+		}
+		p->sum = 0;
+		break;
+	case 1:
+		p->type = byte;
+		break;
+	case 2:
+		if (byte > CMD_MAX_PAYLOAD) {
+			p->bad_frames++;
+			p->received = 0;
+			return 0;
+		}
+		p->len = byte;
+		break;
+	case 3:
+		p->seq = byte;
+		break;
+	case 4:
+		p->seq |= byte << 8;
+		break;
+	default:
+		if (p->received < (unsigned int)(CMD_HEADER_SIZE + p->len)) {
+			p->payload[p->received - CMD_HEADER_SIZE] = byte;
+			break;
+		}
+		// checksum
+		p->received = 0;
+		if ((uint8_t)(p->sum + byte) != 0) {
+			p->bad_frames++;
+			return 0;
+		}
+		return 1;
+	}
+	if (p->received > 0) {
+		p->sum += byte;
+	}
+	p->received++;
+	return 0;
+}
+
+void cmd_put_u16(uint8_t *buf, unsigned int v)
+{
+	buf[0] = v & 0xff;
+	buf[1] = (v >> 8) & 0xff;
+}
+
+void cmd_put_u32(uint8_t *buf, uint32_t v)
+{
+	cmd_put_u16(buf, v);
+	cmd_put_u16(buf + 2, v >> 16);
+}
+
+void cmd_put_f32(uint8_t *buf, double v)
+{
+	float f = (float)v;
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	cmd_put_u32(buf, bits);
+}
+
+unsigned int cmd_get_u16(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8);
+}
+
+uint32_t cmd_get_u32(const uint8_t *buf)
+{
+	return cmd_get_u16(buf) | ((uint32_t)cmd_get_u16(buf + 2) << 16);
+}
+
+float cmd_get_f32(const uint8_t *buf)
+{
+	uint32_t bits = cmd_get_u32(buf);
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
@@ -0,0 +1,77 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+/*
+ * Request/response protocol for the remote (SCADA) side, on the serial UART next to telemetry.
+ *
+ * Requests from the host are framed like telemetry records, without the tick:
+ *   0xA5 | type | payload length | seq (u16 LE) | payload | checksum
+ * where checksum is the two's complement of the byte sum from type to the end of the payload.
+ * Each request is answered with one TLM_RESPONSE telemetry record (telemetry.h) whose payload is
+ *   request type (u8) | request seq (u16 LE) | status (u8) | response data
+ * so the host matches responses to requests by seq and can keep several in flight.
+ *
+ * All values are little endian, floats are IEEE single precision. This file is only the framing:
+ * pure C with no RTOS or HAL calls, so the host benchmark (software/host_tools/cmd_bench.c) runs
+ * the same parser as the relay.
+ */
+
+#include <stdint.h>
+
+#define CMD_SYNC 0xA5
+#define CMD_HEADER_SIZE 5 // sync, type, len, seq(2)
+#define CMD_MAX_PAYLOAD 16
+#define CMD_MAX_RESPONSE 48 // response data, after the type, seq and status
+
+// Request types
+#define CMD_GET_STATUS 		0x81 // no payload
+#define CMD_SET_THRESHOLDS 	0x82 // payload: freq threshold (f32), roc threshold (f32)
+#define CMD_SET_LOAD_MASK 	0x83 // payload: loads the remote side allows on (u8), bit 0 is load 0
+
+// CMD_GET_STATUS response data, CMD_STATUS_SIZE bytes
+#define CMD_STATUS_STATE 		0 // u8, system state
+#define CMD_STATUS_STABLE 		1 // u8
+#define CMD_STATUS_CONNECTED 	2 // u8, mask of connected loads
+#define CMD_STATUS_SHED 		3 // u8, mask of loads shed by the relay
+#define CMD_STATUS_REMOTE_MASK 	4 // u8, the last CMD_SET_LOAD_MASK
+#define CMD_STATUS_FREQ 		5 // f32, Hz, newest sample
+#define CMD_STATUS_ROC 			9 // f32, Hz/s
+#define CMD_STATUS_FREQ_THRESHOLD 13 // f32
+#define CMD_STATUS_ROC_THRESHOLD 17 // f32
+#define CMD_STATUS_SHED_TIME 	21 // u16, ms, last initial shed
+#define CMD_STATUS_MIN_SHED 	23 // u16
+#define CMD_STATUS_MAX_SHED 	25 // u16
+#define CMD_STATUS_AVG_SHED 	27 // f32
+#define CMD_STATUS_SHED_COUNT 	31 // u32
+#define CMD_STATUS_SIZE 		35
+
+// Response status
+#define CMD_OK 			0
+#define CMD_BAD_REQUEST 1 // unknown type, or the wrong payload length for it
+#define CMD_BAD_VALUE 	2 // out of range, nothing was changed
+
+typedef struct {
+	unsigned int received; // bytes of the current frame, 0 while hunting for the sync byte
+	uint8_t type;
+	uint8_t len;
+	uint16_t seq;
+	uint8_t sum;
+	uint8_t payload[CMD_MAX_PAYLOAD];
+	unsigned int bad_frames; // checksum errors and oversized frames
+} cmd_parser;
+
+void cmd_parser_init(cmd_parser *p);
+
+// Non-zero when byte completes a frame with a good checksum. Its type, seq, len and payload are
+// then valid until the next call
+int cmd_parser_feed(cmd_parser *p, uint8_t byte);
+
+// Little endian fields of payloads and responses
+void cmd_put_u16(uint8_t *buf, unsigned int v);
+void cmd_put_u32(uint8_t *buf, uint32_t v);
+void cmd_put_f32(uint8_t *buf, double v);
+unsigned int cmd_get_u16(const uint8_t *buf);
+uint32_t cmd_get_u32(const uint8_t *buf);
+float cmd_get_f32(const uint8_t *buf);
+
+#endif /* COMMAND_H */
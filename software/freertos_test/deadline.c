@@ -0,0 +1,105 @@
+#include "system.h"
+#include "alt_types.h"
+#include "sys/alt_irq.h"
+#include "altera_avalon_timer_regs.h"
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+#include "FreeRTOS/timers.h"
+
+#include "deadline.h"
+
+static TaskHandle_t deadline_task = NULL;
+static volatile int deadline_fired = 0;
+static volatile unsigned int deadline_late_max = 0;
+
+#if DEADLINE_HW_TIMER
+
+static unsigned int deadline_due; // timestamp the armed deadline falls due at
+
+static void deadline_isr(void* context, alt_u32 id)
+{
+	BaseType_t higher_prio_woken = pdFALSE;
+	unsigned int late = ulPortGetTimestamp() - deadline_due;
+
+	IOWR_ALTERA_AVALON_TIMER_STATUS(TIMER1US_BASE, 0);
+	if (late > deadline_late_max) {
+		deadline_late_max = late;
+	}
+	deadline_fired = 1;
+	vTaskNotifyGiveFromISR(deadline_task, &higher_prio_woken);
+	portEND_SWITCHING_ISR(higher_prio_woken);
+}
+
+void deadline_init(TaskHandle_t task)
+{
+	deadline_task = task;
+	IOWR_ALTERA_AVALON_TIMER_CONTROL(TIMER1US_BASE, ALTERA_AVALON_TIMER_CONTROL_STOP_MSK);
+	IOWR_ALTERA_AVALON_TIMER_STATUS(TIMER1US_BASE, 0);
+	alt_irq_register(TIMER1US_IRQ, NULL, deadline_isr);
+}
+
+void deadline_arm(unsigned int ms)
+{
+	unsigned int period = ms * (TIMER1US_FREQ / 1000) - 1;
+	alt_irq_context ctx = alt_irq_disable_all();
+
+	// writing the period stops the timer and reloads the counter, no CONT so it stops at zero
+	IOWR_ALTERA_AVALON_TIMER_PERIODL(TIMER1US_BASE, period & 0xFFFF);
+	IOWR_ALTERA_AVALON_TIMER_PERIODH(TIMER1US_BASE, period >> 16);
+	IOWR_ALTERA_AVALON_TIMER_STATUS(TIMER1US_BASE, 0);
+	deadline_fired = 0;
+	deadline_due = ulPortGetTimestamp() + period + 1;
+	IOWR_ALTERA_AVALON_TIMER_CONTROL(TIMER1US_BASE, ALTERA_AVALON_TIMER_CONTROL_START_MSK | ALTERA_AVALON_TIMER_CONTROL_ITO_MSK);
+	alt_irq_enable_all(ctx);
+}
+
+void deadline_cancel(void)
+{
+	alt_irq_context ctx = alt_irq_disable_all();
+	IOWR_ALTERA_AVALON_TIMER_CONTROL(TIMER1US_BASE, ALTERA_AVALON_TIMER_CONTROL_STOP_MSK);
+	IOWR_ALTERA_AVALON_TIMER_STATUS(TIMER1US_BASE, 0);
+	deadline_fired = 0;
+	alt_irq_enable_all(ctx);
+}
+
+#else
+
+static TimerHandle_t deadline_timer = NULL;
+
+static void deadline_callback(TimerHandle_t timer)
+{
+	deadline_fired = 1;
+	xTaskNotifyGive(deadline_task);
+}
+
+void deadline_init(TaskHandle_t task)
+{
+	deadline_task = task;
+	deadline_timer = xTimerCreate("deadline", 1, pdFALSE, NULL, deadline_callback);
+}
+
+void deadline_arm(unsigned int ms)
+{
+	deadline_fired = 0;
+	// 10 ticks that the caller can be held in the blocked state waiting for room in the timer command queue
+	xTimerChangePeriod(deadline_timer, ms / portTICK_PERIOD_MS, 10);
+}
+
+void deadline_cancel(void)
+{
+	xTimerStop(deadline_timer, 10);
+	deadline_fired = 0;
+}
+
+#endif /* DEADLINE_HW_TIMER */
+
+int deadline_expired(void)
+{
+	return deadline_fired;
+}
+
+unsigned int deadline_worst_late(void)
+{
+	return deadline_late_max;
+}
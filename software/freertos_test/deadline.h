@@ -0,0 +1,36 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+/*
+ * One-shot deadline timer for the load management FSM.
+ *
+ * With DEADLINE_HW_TIMER set, the deadline runs on the spare TIMER1US peripheral in one-shot
+ * mode: deadline_arm() and deadline_cancel() are a few register writes, and the expiry ISR
+ * notifies the owning task directly (vTaskNotifyGiveFromISR), so the deadline is seen within
+ * the interrupt latency instead of going through the timer service task and a polling loop.
+ * With DEADLINE_HW_TIMER cleared, the same API is backed by a FreeRTOS software timer, for
+ * builds where TIMER1US is used by something else (IRQ_STORM_TEST).
+ *
+ * The owning task waits with ulTaskNotifyTake() and then checks deadline_expired().
+ */
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#define DEADLINE_HW_TIMER 1
+
+// Takes over the deadline timer, expiries notify task
+void deadline_init(TaskHandle_t task);
+
+// Clears any earlier expiry and (re)starts the deadline. Task context only
+void deadline_arm(unsigned int ms);
+
+void deadline_cancel(void);
+
+// Non-zero once the armed deadline has passed, until the next deadline_arm()
+int deadline_expired(void);
+
+// Worst time from the deadline to the expiry being signalled, in timestamp counts (hardware timer only)
+unsigned int deadline_worst_late(void);
+
+#endif /* DEADLINE_H */
@@ -304,6 +304,14 @@ extern "C" {
 	#define portSETUP_TCB( pxTCB ) ( void ) pxTCB
 #endif
 
+#ifndef portTASK_SELECTION_START
+	#define portTASK_SELECTION_START()
+#endif
+
+#ifndef portTASK_SELECTION_END
+	#define portTASK_SELECTION_END()
+#endif
+
 #ifndef configQUEUE_REGISTRY_SIZE
 	#define configQUEUE_REGISTRY_SIZE 0U
 #endif
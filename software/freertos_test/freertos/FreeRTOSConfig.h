@@ -94,6 +94,13 @@
 #define configTIMER_TASK_PRIORITY		(configMAX_PRIORITIES - 1)
 #define configTIMER_QUEUE_LENGTH		10
 #define	configTIMER_TASK_STACK_DEPTH	2048
+
+/* Set to 1 to keep the active software timers in the hierarchical timing wheel
+in timer_wheel.c instead of the sorted list, making starting and stopping a
+timer O(1) in the number of active timers.  A timer more than 32 ticks away
+wakes the timer task at each cascade on the way, so the list suits a few long
+timers and tickless idle better. */
+#define configUSE_TIMER_WHEEL			0
 #define configTICK_RATE_HZ				( ( portTickType ) 1000 )
 #define configCPU_CLOCK_HZ				( ( unsigned long ) ALT_SYS_CLK ) 
 #define configMAX_PRIORITIES			( ( unsigned portBASE_TYPE ) 12 )
@@ -109,6 +116,12 @@
 #define configUSE_COUNTING_SEMAPHORES	1
 #define configCHECK_FOR_STACK_OVERFLOW	2 
 #define configQUEUE_REGISTRY_SIZE		0
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION	1
+#define configUSE_TICKLESS_IDLE			1
+
+/* Set to 1 to time the ready task selection done by vTaskSwitchContext() with
+the port timestamp, see vPortGetTaskSelectionTime() in port.c. */
+#define configMEASURE_TASK_SELECTION	0
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES 			0
@@ -121,10 +134,12 @@ to exclude the API function. */
 #define INCLUDE_uxTaskPriorityGet			0
 #define INCLUDE_vTaskDelete					1
 #define INCLUDE_vTaskCleanUpResources		1
-#define INCLUDE_vTaskSuspend				0
+#define INCLUDE_vTaskSuspend				1
 #define INCLUDE_vTaskDelayUntil				0
 #define INCLUDE_vTaskDelay					1
 #define INCLUDE_uxTaskGetStackHighWaterMark	1
+#define INCLUDE_pcTaskGetTaskName			1
+#define INCLUDE_xTaskGetCurrentTaskHandle	1
 
 /* The priority at which the tick interrupt runs.  This should probably be
 kept at 1. */
@@ -83,6 +83,7 @@
 /* Scheduler includes. */
 #include "FreeRTOS.h"
 #include "task.h"
+#include "port_tick.h"
 
 /* Interrupts are enabled. */
 #define portINITIAL_ESTATUS     ( StackType_t ) 0x01 
@@ -98,6 +99,10 @@ void vApplicationStackOverflowHook(TaskHandle_t *pxTask, signed char *pcTaskName
 
 /*-----------------------------------------------------------*/
 
+/* Set by portEND_SWITCHING_ISR(), checked and cleared on interrupt exit in
+port_asm.S. */
+volatile uint32_t ulPortYieldPending = 0;
+
 /* 
  * Setup the timer to generate the tick interrupts.
  */
@@ -195,28 +200,99 @@ void prvSetupTimerInterrupt( void )
 	else
 	{
 		/* Configure SysTick to interrupt at the requested rate. */
-		IOWR_ALTERA_AVALON_TIMER_CONTROL( SYS_CLK_BASE, ALTERA_AVALON_TIMER_CONTROL_STOP_MSK );
-		IOWR_ALTERA_AVALON_TIMER_PERIODL( SYS_CLK_BASE, ( configCPU_CLOCK_HZ / configTICK_RATE_HZ ) & 0xFFFF );
-		IOWR_ALTERA_AVALON_TIMER_PERIODH( SYS_CLK_BASE, ( configCPU_CLOCK_HZ / configTICK_RATE_HZ ) >> 16 );
-		IOWR_ALTERA_AVALON_TIMER_CONTROL( SYS_CLK_BASE, ALTERA_AVALON_TIMER_CONTROL_CONT_MSK | ALTERA_AVALON_TIMER_CONTROL_START_MSK | ALTERA_AVALON_TIMER_CONTROL_ITO_MSK );	
+		vPortTickTimerStart();
 	} 
-
-	/* Clear any already pending interrupts generated by the Timer. */
-	IOWR_ALTERA_AVALON_TIMER_STATUS( SYS_CLK_BASE, ~ALTERA_AVALON_TIMER_STATUS_TO_MSK );
 }
 /*-----------------------------------------------------------*/
 
 void vPortSysTickHandler( void * context, alt_u32 id )
 {
-	/* Increment the kernel tick. */
-	if( xTaskIncrementTick() != pdFALSE )
+	/* Increment the kernel tick, switching on the way out if required. */
+	portEND_SWITCHING_ISR( xTaskIncrementTick() );
+		
+	/* Clear the interrupt, and restore the tick period after tickless idle. */
+	vPortTickTimerExpired();
+}
+/*-----------------------------------------------------------*/
+
+
+#if( configUSE_PORT_OPTIMISED_TASK_SELECTION == 1 )
+
+/* The ready priorities bitmap is a single 32-bit word. */
+typedef char xPortReadyBitmapCheck[ ( configMAX_PRIORITIES <= 32 ) ? 1 : -1 ];
+
+/*
+ * Index of the most significant set bit of each byte value, used by
+ * portGET_HIGHEST_PRIORITY().  Entry 0 is never used as the idle task is
+ * always ready.
+ */
+const uint8_t ucPortHighestBit[ 256 ] =
+{
+	0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+	5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7
+};
+
+#endif /* configUSE_PORT_OPTIMISED_TASK_SELECTION */
+/*-----------------------------------------------------------*/
+
+#if( configMEASURE_TASK_SELECTION == 1 )
+
+static uint32_t ulSelectionStart = 0;
+static volatile uint32_t ulSelectionMax = 0;
+static volatile uint32_t ulSelectionTotal = 0;
+static volatile uint32_t ulSelectionCount = 0;
+
+/* Called from portTASK_SELECTION_START() and portTASK_SELECTION_END() around
+the ready task selection in vTaskSwitchContext(), always with interrupts
+disabled. */
+void vPortTaskSelectionStart( void )
+{
+	ulSelectionStart = ulPortGetTimestamp();
+}
+
+void vPortTaskSelectionEnd( void )
+{
+uint32_t ulElapsed = ulPortGetTimestamp() - ulSelectionStart;
+
+	if( ulElapsed > ulSelectionMax )
 	{
-        vTaskSwitchContext();
+		ulSelectionMax = ulElapsed;
 	}
-		
-	/* Clear the interrupt. */
-	IOWR_ALTERA_AVALON_TIMER_STATUS( SYS_CLK_BASE, ~ALTERA_AVALON_TIMER_STATUS_TO_MSK );
+	ulSelectionTotal += ulElapsed;
+	ulSelectionCount++;
+}
+
+/* Reports the worst case and total timestamp counts spent selecting the next
+task, and the number of selections, then restarts the measurement.  The counts
+include the cost of one ulPortGetTimestamp() call. */
+void vPortGetTaskSelectionTime( uint32_t *pulMax, uint32_t *pulTotal, uint32_t *pulCount )
+{
+alt_irq_context xContext = alt_irq_disable_all();
+
+	*pulMax = ulSelectionMax;
+	*pulTotal = ulSelectionTotal;
+	*pulCount = ulSelectionCount;
+	ulSelectionMax = 0;
+	ulSelectionTotal = 0;
+	ulSelectionCount = 0;
+	alt_irq_enable_all( xContext );
 }
+
+#endif /* configMEASURE_TASK_SELECTION */
 /*-----------------------------------------------------------*/
 
 /** This function is a re-implementation of the Altera provided function.
@@ -0,0 +1,276 @@
+/*
+ * Tick timer, timestamp and tickless idle for the Nios II port.
+ *
+ * The Avalon interval timer counts down from its period register to zero,
+ * sets TO and reloads.  Writing the period registers stops it, so changing
+ * the period always means latching the counter, writing the new period and
+ * starting it again, which loses portTICK_TIMER_RESTART_CLOCKS.  Three values
+ * keep track of time across those restarts:
+ *
+ *   ulPeriodLength - timer clocks in the period being counted
+ *   ulPeriodStart  - timestamp at which that period started
+ *   ulTickTime     - timestamp of the last tick counted for the kernel
+ *
+ * The timestamp is ulPeriodStart plus the clocks elapsed in the current
+ * period, so it stays continuous whatever the period.  ulTickTime only ever
+ * moves in whole ticks, so the kernel tick count does not drift from the
+ * timer clock when tickless idle stretches a period: a sleep is always
+ * programmed to end on a whole tick after ulTickTime.
+ */
+
+#include "port_tick.h"
+
+/* Tickless idle has nothing to wait on, as Nios II has no wait for interrupt
+instruction.  The simulation uses this to advance time. */
+#ifndef portTICK_SLEEP_POLL
+	#define portTICK_SLEEP_POLL()
+#endif
+
+static uint32_t ulPeriodLength = portTICK_TIMER_RELOAD;
+static uint32_t ulPeriodStart = 0;
+static uint32_t ulTickTime = 0;
+
+/* Ticks counted against the timer, the tick interrupts plus the ticks stepped
+over by tickless idle.  Matches the kernel tick count except while ticks are
+pended with the scheduler suspended. */
+static TickType_t xTimerTicks = 0;
+
+static volatile uint32_t ulTickInterrupts = 0;
+
+/* Set once vPortTimestampStart() has the timer running. */
+static BaseType_t xTimestampRunning = pdFALSE;
+
+#if( configUSE_TICKLESS_IDLE == 1 )
+	/* Set while the timer counts a stretched period, cleared by the tick
+	interrupt that ends it. */
+	static volatile BaseType_t xSleeping = pdFALSE;
+#endif
+/*-----------------------------------------------------------*/
+
+/*
+ * Latches the counter and returns the clocks elapsed in the current period.
+ * Must be called with interrupts disabled.
+ */
+static uint32_t prvElapsed( void )
+{
+uint32_t ulSnap, ulElapsed;
+
+	/* Writing either snap register latches the counter. */
+	IOWR_ALTERA_AVALON_TIMER_SNAPL( portTICK_TIMER_BASE, 0 );
+	ulSnap = IORD_ALTERA_AVALON_TIMER_SNAPL( portTICK_TIMER_BASE ) & 0xFFFF;
+	ulSnap |= ( IORD_ALTERA_AVALON_TIMER_SNAPH( portTICK_TIMER_BASE ) & 0xFFFF ) << 16;
+	ulElapsed = ulPeriodLength - 1 - ulSnap;
+
+	/* The counter may have reloaded with the interrupt still pending.  A
+	snapshot from the first half of the period was then taken after the reload,
+	so the period that ended has to be counted too. */
+	if( ( IORD_ALTERA_AVALON_TIMER_STATUS( portTICK_TIMER_BASE ) & ALTERA_AVALON_TIMER_STATUS_TO_MSK ) && ( ulElapsed < ulPeriodLength / 2 ) )
+	{
+		ulElapsed += ulPeriodLength;
+	}
+
+	return ulElapsed;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Restarts the timer with a period of ulLength clocks.  ulNow is the timestamp
+ * just read with prvElapsed(), the new period starts the restart clocks after
+ * it.  Must be called with interrupts disabled.
+ */
+static void prvRestart( uint32_t ulNow, uint32_t ulLength )
+{
+	/* Writing the period stops the timer. */
+	IOWR_ALTERA_AVALON_TIMER_PERIODL( portTICK_TIMER_BASE, ( ulLength - 1 ) & 0xFFFF );
+	IOWR_ALTERA_AVALON_TIMER_PERIODH( portTICK_TIMER_BASE, ( ulLength - 1 ) >> 16 );
+	IOWR_ALTERA_AVALON_TIMER_STATUS( portTICK_TIMER_BASE, ~ALTERA_AVALON_TIMER_STATUS_TO_MSK );
+	IOWR_ALTERA_AVALON_TIMER_CONTROL( portTICK_TIMER_BASE, ALTERA_AVALON_TIMER_CONTROL_CONT_MSK | ALTERA_AVALON_TIMER_CONTROL_START_MSK | ALTERA_AVALON_TIMER_CONTROL_ITO_MSK );
+
+	ulPeriodStart = ulNow + portTICK_TIMER_RESTART_CLOCKS;
+	ulPeriodLength = ulLength;
+}
+/*-----------------------------------------------------------*/
+
+void vPortTimestampStart( void )
+{
+alt_irq_context xContext;
+
+	xContext = alt_irq_disable_all();
+
+	/* The longest period the timer has, 43 s, without its interrupt: the HAL
+	only enables the interrupt to drive its own system clock, which nothing
+	needs before the scheduler starts and takes the timer over. */
+	IOWR_ALTERA_AVALON_TIMER_CONTROL( portTICK_TIMER_BASE, ALTERA_AVALON_TIMER_CONTROL_STOP_MSK );
+	prvRestart( ( uint32_t ) 0 - portTICK_TIMER_RESTART_CLOCKS, 0xFFFFFFFFUL );
+	IOWR_ALTERA_AVALON_TIMER_CONTROL( portTICK_TIMER_BASE, ALTERA_AVALON_TIMER_CONTROL_CONT_MSK | ALTERA_AVALON_TIMER_CONTROL_START_MSK );
+	xTimestampRunning = pdTRUE;
+
+	alt_irq_enable_all( xContext );
+}
+/*-----------------------------------------------------------*/
+
+void vPortTickTimerStart( void )
+{
+uint32_t ulNow = ( uint32_t ) 0 - portTICK_TIMER_RESTART_CLOCKS;
+
+	/* Keep the time base of a timestamp started during boot. */
+	if( xTimestampRunning != pdFALSE )
+	{
+		ulNow = ulPeriodStart + prvElapsed();
+	}
+
+	IOWR_ALTERA_AVALON_TIMER_CONTROL( portTICK_TIMER_BASE, ALTERA_AVALON_TIMER_CONTROL_STOP_MSK );
+	prvRestart( ulNow, portTICK_TIMER_RELOAD );
+	ulTickTime = ulPeriodStart;
+	xTimerTicks = 0;
+}
+/*-----------------------------------------------------------*/
+
+void vPortTickTimerExpired( void )
+{
+	ulTickInterrupts++;
+	xTimerTicks++;
+	ulTickTime += portTICK_TIMER_RELOAD;
+
+	ulPeriodStart += ulPeriodLength;
+	IOWR_ALTERA_AVALON_TIMER_STATUS( portTICK_TIMER_BASE, ~ALTERA_AVALON_TIMER_STATUS_TO_MSK );
+
+	/* The period that just ended was stretched or shortened by tickless idle,
+	and the counter has reloaded it.  Go back to the tick period.  The
+	interrupt latency delays the following ticks by a few microseconds until
+	the next sleep, which is programmed from ulTickTime and so lines them up
+	again. */
+	if( ulPeriodLength != portTICK_TIMER_RELOAD )
+	{
+		prvRestart( ulPeriodStart + prvElapsed(), portTICK_TIMER_RELOAD );
+
+		#if( configUSE_TICKLESS_IDLE == 1 )
+			xSleeping = pdFALSE;
+		#endif
+	}
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulPortTickInterrupts( void )
+{
+	return ulTickInterrupts;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Free running count of timer input clocks.  It wraps every 2^32 clocks
+ * (about 43 s at 100 MHz) so is only meant for measuring short intervals.
+ * Safe to call from tasks, ISRs and before the scheduler starts.
+ */
+uint32_t ulPortGetTimestamp( void )
+{
+uint32_t ulNow;
+alt_irq_context xContext;
+
+	xContext = alt_irq_disable_all();
+	ulNow = ulPeriodStart + prvElapsed();
+	alt_irq_enable_all( xContext );
+
+	return ulNow;
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_TICKLESS_IDLE == 1 )
+
+void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime )
+{
+const TickType_t xMaximumSuppressedTicks = ( 0xFFFFFFFFUL / portTICK_TIMER_RELOAD ) - 1;
+uint32_t ulNow, ulIntoTick, ulLength;
+TickType_t xTicks;
+alt_irq_context xContext;
+
+	if( xExpectedIdleTime > xMaximumSuppressedTicks )
+	{
+		xExpectedIdleTime = xMaximumSuppressedTicks;
+	}
+
+	xContext = alt_irq_disable_all();
+
+	/* Do not sleep if a tick is due or pended, as the expected idle time was
+	worked out without it, or if a task was readied since the idle task
+	decided to sleep. */
+	if( ( IORD_ALTERA_AVALON_TIMER_STATUS( portTICK_TIMER_BASE ) & ALTERA_AVALON_TIMER_STATUS_TO_MSK ) ||
+		( xTimerTicks != xTaskGetTickCountFromISR() ) ||
+		( eTaskConfirmSleepModeStatus() == eAbortSleep ) )
+	{
+		alt_irq_enable_all( xContext );
+		return;
+	}
+
+	/* Stretch the current period so it ends on the tick the kernel next
+	needs.  The current period can run a little past ulTickTime + one tick
+	after the interrupt latency delayed it, never before ulTickTime. */
+	ulNow = ulPeriodStart + prvElapsed();
+	ulIntoTick = ulNow - ulTickTime;
+	if( ( int32_t ) ulIntoTick < 0 )
+	{
+		ulIntoTick = 0;
+	}
+	ulLength = ( xExpectedIdleTime * portTICK_TIMER_RELOAD ) - ulIntoTick - portTICK_TIMER_RESTART_CLOCKS;
+	prvRestart( ulNow, ulLength );
+	xSleeping = pdTRUE;
+
+	alt_irq_enable_all( xContext );
+
+	/* Wait for the stretched period to end or for an interrupt to ready a
+	task.  The gain is the tick interrupts not taken in the meantime. */
+	while( xSleeping != pdFALSE )
+	{
+		xContext = alt_irq_disable_all();
+		if( eTaskConfirmSleepModeStatus() == eAbortSleep )
+		{
+			alt_irq_enable_all( xContext );
+			break;
+		}
+		alt_irq_enable_all( xContext );
+		portTICK_SLEEP_POLL();
+	}
+
+	xContext = alt_irq_disable_all();
+
+	/* If the stretched period ran out meanwhile, let the tick interrupt count
+	it first. */
+	if( IORD_ALTERA_AVALON_TIMER_STATUS( portTICK_TIMER_BASE ) & ALTERA_AVALON_TIMER_STATUS_TO_MSK )
+	{
+		alt_irq_enable_all( xContext );
+		xContext = alt_irq_disable_all();
+	}
+
+	ulNow = ulPeriodStart + prvElapsed();
+
+	/* Step over the whole ticks that passed, less one if the tick interrupt
+	ended the sleep as it counted that one.  The last tick of the expected idle
+	time is always left to the tick interrupt so it unblocks the waiting task. */
+	xTicks = ( ulNow - ulTickTime ) / portTICK_TIMER_RELOAD;
+	if( xTicks > xExpectedIdleTime - 1 )
+	{
+		xTicks = xExpectedIdleTime - 1;
+	}
+	ulTickTime += xTicks * portTICK_TIMER_RELOAD;
+	xTimerTicks += xTicks;
+
+	if( xSleeping != pdFALSE )
+	{
+		/* Woken early by another interrupt.  Restart the timer for what is
+		left of the current tick. */
+		xSleeping = pdFALSE;
+		ulLength = ulTickTime + portTICK_TIMER_RELOAD - ( ulNow + portTICK_TIMER_RESTART_CLOCKS );
+		if( ( int32_t ) ulLength < ( int32_t ) portTICK_TIMER_MIN_PERIOD )
+		{
+			ulLength = portTICK_TIMER_MIN_PERIOD;
+		}
+		prvRestart( ulNow, ulLength );
+	}
+
+	vTaskStepTick( xTicks );
+
+	alt_irq_enable_all( xContext );
+}
+
+#endif /* configUSE_TICKLESS_IDLE */
+/*-----------------------------------------------------------*/
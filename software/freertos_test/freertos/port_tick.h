@@ -0,0 +1,51 @@
+#ifndef PORT_TICK_H
+#define PORT_TICK_H
+
+/*
+ * Tick timer management for the Nios II port, see port_tick.c.
+ *
+ * The tick comes from an Avalon interval timer.  Everything that touches the
+ * timer (the tick period, the timestamp and tickless idle) lives in
+ * port_tick.c so it can be built on a host against a simulated timer:
+ * defining portTICK_TIMER_SIMULATED replaces the kernel and Altera headers
+ * with port_tick_sim.h, which must provide the same register macros and kernel
+ * functions (see software/host_tools/tickless_sim.c).
+ */
+
+#ifdef portTICK_TIMER_SIMULATED
+	#include "port_tick_sim.h"
+#else
+	#include "system.h"
+	#include "sys/alt_irq.h"
+	#include "altera_avalon_timer_regs.h"
+	#include "FreeRTOS.h"
+	#include "task.h"
+
+	#define portTICK_TIMER_BASE		TIMER1MS_BASE
+	#define portTICK_TIMER_FREQ		TIMER1MS_FREQ
+#endif
+
+/* Timer clocks in one tick. */
+#define portTICK_TIMER_RELOAD		( ( uint32_t ) ( portTICK_TIMER_FREQ / configTICK_RATE_HZ ) )
+
+/* Timer clocks lost between latching the counter and restarting it with a new
+period, added back so the timestamp and the tick stay in step with the timer
+input clock.  An estimate for the Nios II/f on this system, check it against
+an external reference if the CPU or the bus to the timer changes. */
+#ifndef portTICK_TIMER_RESTART_CLOCKS
+	#define portTICK_TIMER_RESTART_CLOCKS	40
+#endif
+
+/* Shortest period the timer is ever restarted with (20 us), long enough that
+it cannot expire twice before the tick interrupt is taken. */
+#define portTICK_TIMER_MIN_PERIOD	( ( uint32_t ) ( portTICK_TIMER_FREQ / 50000 ) )
+
+/* Starts the timer generating one interrupt per tick. */
+void vPortTickTimerStart( void );
+
+/* Called from the tick interrupt after the tick count has been incremented.
+Clears the interrupt and goes back to the normal tick period if the period
+just ended was shortened or stretched by tickless idle. */
+void vPortTickTimerExpired( void );
+
+#endif /* PORT_TICK_H */
@@ -122,7 +122,72 @@ typedef unsigned long UBaseType_t;
 
 extern void vTaskSwitchContext( void );
 #define portYIELD()									asm volatile ( "trap" );
-#define portEND_SWITCHING_ISR( xSwitchRequired ) 	if( xSwitchRequired ) 	vTaskSwitchContext()
+
+/* Context switches requested by ISRs are deferred to the interrupt exit in
+port_asm.S, so the task woken by an ISR runs as soon as alt_irq_handler
+returns instead of at the next tick. */
+extern volatile uint32_t ulPortYieldPending;
+#define portEND_SWITCHING_ISR( xSwitchRequired ) 	do { if( xSwitchRequired ) ulPortYieldPending = 1; } while( 0 )
+#define portYIELD_FROM_ISR( xSwitchRequired )		portEND_SWITCHING_ISR( xSwitchRequired )
+
+
+/* Port optimised ready task selection.  The ready priorities are kept as a
+bitmap and the highest one is found with byte lookups, as Nios II has no count
+leading zeros instruction.  configMAX_PRIORITIES must not exceed 32, which is
+checked in port.c. */
+#if( configUSE_PORT_OPTIMISED_TASK_SELECTION == 1 )
+
+	/* ucPortHighestBit[ x ] is the index of the most significant set bit of x,
+	defined in port.c. */
+	extern const uint8_t ucPortHighestBit[ 256 ];
+
+	static inline UBaseType_t uxPortHighestSetBit( uint32_t ulBitmap )
+	{
+		if( ulBitmap >> 16 )
+		{
+			return ( ulBitmap >> 24 ) ? 24 + ucPortHighestBit[ ulBitmap >> 24 ] : 16 + ucPortHighestBit[ ( ulBitmap >> 16 ) & 0xFF ];
+		}
+		if( ulBitmap >> 8 )
+		{
+			return 8 + ucPortHighestBit[ ulBitmap >> 8 ];
+		}
+		return ucPortHighestBit[ ulBitmap ];
+	}
+
+	#define portRECORD_READY_PRIORITY( uxPriority, uxReadyPriorities )	( uxReadyPriorities ) |= ( 1UL << ( uxPriority ) )
+	#define portRESET_READY_PRIORITY( uxPriority, uxReadyPriorities )	( uxReadyPriorities ) &= ~( 1UL << ( uxPriority ) )
+	#define portGET_HIGHEST_PRIORITY( uxTopPriority, uxReadyPriorities )	uxTopPriority = uxPortHighestSetBit( uxReadyPriorities )
+
+#endif /* configUSE_PORT_OPTIMISED_TASK_SELECTION */
+
+
+/* Tickless idle, see port_tick.c. */
+#if( configUSE_TICKLESS_IDLE == 1 )
+	extern void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime );
+	#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime )	vPortSuppressTicksAndSleep( xExpectedIdleTime )
+#endif
+
+/* Number of tick interrupts taken since the scheduler started. */
+extern uint32_t ulPortTickInterrupts( void );
+
+
+/* High resolution timestamp for instrumentation, see port_tick.c. */
+#define portTIMESTAMP_HZ							( TIMER1MS_FREQ )
+extern uint32_t ulPortGetTimestamp( void );
+
+/* Runs the timestamp before the scheduler starts, for timing the boot.  The
+tick timer then carries on from it instead of restarting it at zero. */
+extern void vPortTimestampStart( void );
+
+#if( configMEASURE_TASK_SELECTION == 1 )
+	/* Called directly around taskSELECT_HIGHEST_PRIORITY_TASK(), so the run
+	time stats and stack overflow checks are not counted. */
+	extern void vPortTaskSelectionStart( void );
+	extern void vPortTaskSelectionEnd( void );
+	#define portTASK_SELECTION_START()	vPortTaskSelectionStart()
+	#define portTASK_SELECTION_END()	vPortTaskSelectionEnd()
+	extern void vPortGetTaskSelectionTime( uint32_t *pulMax, uint32_t *pulTotal, uint32_t *pulCount );
+#endif
 
 
 /* Include the port_asm.S file where the Context saving/restoring is defined. */
@@ -2241,7 +2241,9 @@ void vTaskSwitchContext( void )
 
 		/* Select a new task to run using either the generic C or port
 		optimised asm code. */
+		portTASK_SELECTION_START();
 		taskSELECT_HIGHEST_PRIORITY_TASK();
+		portTASK_SELECTION_END();
 		traceTASK_SWITCHED_IN();
 
 		#if ( configUSE_NEWLIB_REENTRANT == 1 )
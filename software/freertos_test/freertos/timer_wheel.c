@@ -0,0 +1,245 @@
+/*
+ * Hierarchical timing wheel for the software timers, see timer_wheel.h.
+ */
+
+#include "timer_wheel.h"
+
+#if( configUSE_TIMERS == 1 ) && ( configUSE_TIMER_WHEEL == 1 )
+
+#if( configUSE_16_BIT_TICKS == 1 )
+	#error The timer wheel needs 32 bit ticks.
+#endif
+
+#define tmrWHEEL_SLOT_MASK		( tmrWHEEL_SLOTS - 1UL )
+#define tmrWHEEL_RANGE			( ( TickType_t ) 1UL << ( tmrWHEEL_SLOT_BITS * tmrWHEEL_LEVELS ) )
+
+/* Signed distance from xFrom to xTo, valid while they are less than 2^31 ticks
+apart. */
+#define tmrTICKS_UNTIL( xFrom, xTo )	( ( int32_t ) ( ( TickType_t ) ( ( xTo ) - ( xFrom ) ) ) )
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Index of the least significant set bit of a non-zero bitmap.  Nios II has no
+ * count trailing zeros instruction, so the lowest bit is isolated and hashed
+ * with a de Bruijn sequence.
+ */
+static UBaseType_t prvLowestSetBit( uint32_t ulBits )
+{
+static const uint8_t ucBitIndex[ 32 ] =
+{
+	0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+	31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+};
+
+	return ucBitIndex[ ( uint32_t ) ( ( ulBits & ( 0UL - ulBits ) ) * 0x077CB531UL ) >> 27 ];
+}
+/*-----------------------------------------------------------*/
+
+/* Rotates a slot bitmap right, so bit 0 of the result is slot uxFirst. */
+static uint32_t prvRotate( uint32_t ulBits, UBaseType_t uxFirst )
+{
+	if( uxFirst == 0 )
+	{
+		return ulBits;
+	}
+	return ( ulBits >> uxFirst ) | ( ulBits << ( tmrWHEEL_SLOTS - uxFirst ) );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Puts an item in the slot for its expiry time, relative to the wheel's
+ * current time.
+ */
+static void prvPlace( TimerWheel_t * const pxWheel, ListItem_t * const pxItem )
+{
+TickType_t xExpiry = listGET_LIST_ITEM_VALUE( pxItem );
+TickType_t xDelta = xExpiry - pxWheel->xTime;
+UBaseType_t uxLevel = 0, uxSlot;
+
+	if( tmrTICKS_UNTIL( pxWheel->xTime, xExpiry ) < 0 )
+	{
+		/* Already due, it expires with the slot processed next. */
+		uxSlot = pxWheel->xTime & tmrWHEEL_SLOT_MASK;
+	}
+	else
+	{
+		while( ( uxLevel < ( tmrWHEEL_LEVELS - 1 ) ) && ( xDelta >= ( ( TickType_t ) 1UL << ( tmrWHEEL_SLOT_BITS * ( uxLevel + 1 ) ) ) ) )
+		{
+			uxLevel++;
+		}
+
+		if( xDelta >= tmrWHEEL_RANGE )
+		{
+			/* Out of range, park it in the furthest slot.  It is placed again
+			each time that slot is cascaded. */
+			xExpiry = pxWheel->xTime + tmrWHEEL_RANGE - 1;
+		}
+
+		uxSlot = ( xExpiry >> ( tmrWHEEL_SLOT_BITS * uxLevel ) ) & tmrWHEEL_SLOT_MASK;
+	}
+
+	vListInsertEnd( &( pxWheel->xSlots[ uxLevel ][ uxSlot ] ), pxItem );
+	pxWheel->ulOccupied[ uxLevel ] |= 1UL << uxSlot;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Empties the slot of a level that the wheel's time has just reached into the
+ * lower levels.  Returns the index of that slot, 0 when the level above has to
+ * be cascaded too.
+ */
+static UBaseType_t prvCascade( TimerWheel_t * const pxWheel, const UBaseType_t uxLevel )
+{
+UBaseType_t uxSlot = ( pxWheel->xTime >> ( tmrWHEEL_SLOT_BITS * uxLevel ) ) & tmrWHEEL_SLOT_MASK;
+List_t * const pxSlot = &( pxWheel->xSlots[ uxLevel ][ uxSlot ] );
+UBaseType_t uxItems;
+ListItem_t *pxItem;
+
+	if( ( pxWheel->ulOccupied[ uxLevel ] & ( 1UL << uxSlot ) ) != 0 )
+	{
+		pxWheel->ulOccupied[ uxLevel ] &= ~( 1UL << uxSlot );
+
+		/* Only the items that were there, a parked item can land in the same
+		level again. */
+		for( uxItems = listCURRENT_LIST_LENGTH( pxSlot ); uxItems > 0; uxItems-- )
+		{
+			pxItem = listGET_HEAD_ENTRY( pxSlot );
+			( void ) uxListRemove( pxItem );
+			prvPlace( pxWheel, pxItem );
+		}
+	}
+
+	return uxSlot;
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelInitialise( TimerWheel_t * const pxWheel, const TickType_t xTimeNow )
+{
+UBaseType_t uxLevel, uxSlot;
+
+	for( uxLevel = 0; uxLevel < tmrWHEEL_LEVELS; uxLevel++ )
+	{
+		for( uxSlot = 0; uxSlot < tmrWHEEL_SLOTS; uxSlot++ )
+		{
+			vListInitialise( &( pxWheel->xSlots[ uxLevel ][ uxSlot ] ) );
+		}
+		pxWheel->ulOccupied[ uxLevel ] = 0;
+	}
+	pxWheel->xTime = xTimeNow;
+	pxWheel->uxTimers = 0;
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelInsert( TimerWheel_t * const pxWheel, ListItem_t * const pxItem, const TickType_t xTimeNow )
+{
+	/* An empty wheel is not advanced, catch it up so the expiry time is in
+	range. */
+	if( pxWheel->uxTimers == 0 )
+	{
+		pxWheel->xTime = xTimeNow;
+	}
+
+	prvPlace( pxWheel, pxItem );
+	pxWheel->uxTimers++;
+}
+/*-----------------------------------------------------------*/
+
+void vTimerWheelRemove( TimerWheel_t * const pxWheel, ListItem_t * const pxItem )
+{
+List_t * const pxSlot = ( List_t * ) listLIST_ITEM_CONTAINER( pxItem );
+UBaseType_t uxIndex = ( UBaseType_t ) ( pxSlot - &( pxWheel->xSlots[ 0 ][ 0 ] ) );
+
+	if( uxListRemove( pxItem ) == 0 )
+	{
+		pxWheel->ulOccupied[ uxIndex >> tmrWHEEL_SLOT_BITS ] &= ~( 1UL << ( uxIndex & tmrWHEEL_SLOT_MASK ) );
+	}
+	pxWheel->uxTimers--;
+}
+/*-----------------------------------------------------------*/
+
+ListItem_t *pxTimerWheelNextExpired( TimerWheel_t * const pxWheel, const TickType_t xTimeNow )
+{
+UBaseType_t uxSlot, uxLevel;
+TickType_t xStep;
+uint32_t ulAhead;
+ListItem_t *pxItem;
+
+	if( pxWheel->uxTimers == 0 )
+	{
+		pxWheel->xTime = xTimeNow + 1;
+		return NULL;
+	}
+
+	while( tmrTICKS_UNTIL( pxWheel->xTime, xTimeNow ) >= 0 )
+	{
+		uxSlot = pxWheel->xTime & tmrWHEEL_SLOT_MASK;
+		if( ( pxWheel->ulOccupied[ 0 ] & ( 1UL << uxSlot ) ) != 0 )
+		{
+			pxItem = listGET_HEAD_ENTRY( &( pxWheel->xSlots[ 0 ][ uxSlot ] ) );
+			vTimerWheelRemove( pxWheel, pxItem );
+			return pxItem;
+		}
+
+		/* Skip to the next occupied slot or the next cascade, whichever comes
+		first, without going past xTimeNow. */
+		ulAhead = pxWheel->ulOccupied[ 0 ] >> uxSlot;
+		xStep = ( ulAhead != 0 ) ? prvLowestSetBit( ulAhead ) : tmrWHEEL_SLOTS - uxSlot;
+		if( xStep > ( xTimeNow - pxWheel->xTime ) + 1 )
+		{
+			xStep = ( xTimeNow - pxWheel->xTime ) + 1;
+		}
+		pxWheel->xTime += xStep;
+
+		if( ( pxWheel->xTime & tmrWHEEL_SLOT_MASK ) == 0 )
+		{
+			for( uxLevel = 1; ( uxLevel < tmrWHEEL_LEVELS ) && ( prvCascade( pxWheel, uxLevel ) == 0 ); uxLevel++ )
+			{
+			}
+		}
+	}
+
+	return NULL;
+}
+/*-----------------------------------------------------------*/
+
+TickType_t xTimerWheelNextExpireTime( const TimerWheel_t * const pxWheel, BaseType_t * const pxWheelWasEmpty )
+{
+TickType_t xSoonest = tmrWHEEL_RANGE, xStart;
+UBaseType_t uxLevel, uxShift, uxSlot;
+uint32_t ulBits;
+
+	*pxWheelWasEmpty = ( pxWheel->uxTimers == 0 ) ? pdTRUE : pdFALSE;
+	if( *pxWheelWasEmpty != pdFALSE )
+	{
+		return ( TickType_t ) 0U;
+	}
+
+	/* Level 0 slots hold the exact tick, from the current one on. */
+	ulBits = prvRotate( pxWheel->ulOccupied[ 0 ], pxWheel->xTime & tmrWHEEL_SLOT_MASK );
+	if( ulBits != 0 )
+	{
+		xSoonest = prvLowestSetBit( ulBits );
+	}
+
+	/* A slot of a higher level holds nothing earlier than the cascade that
+	empties it, the first one after the current slot of that level. */
+	for( uxLevel = 1; uxLevel < tmrWHEEL_LEVELS; uxLevel++ )
+	{
+		uxShift = tmrWHEEL_SLOT_BITS * uxLevel;
+		uxSlot = ( pxWheel->xTime >> uxShift ) & tmrWHEEL_SLOT_MASK;
+		ulBits = prvRotate( pxWheel->ulOccupied[ uxLevel ], ( uxSlot + 1 ) & tmrWHEEL_SLOT_MASK );
+		if( ulBits != 0 )
+		{
+			xStart = ( ( pxWheel->xTime >> uxShift ) + prvLowestSetBit( ulBits ) + 1 ) << uxShift;
+			if( xStart - pxWheel->xTime < xSoonest )
+			{
+				xSoonest = xStart - pxWheel->xTime;
+			}
+		}
+	}
+
+	return pxWheel->xTime + xSoonest;
+}
+
+#endif /* configUSE_TIMER_WHEEL */
@@ -0,0 +1,71 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+/*
+ * Hierarchical timing wheel for the software timers, used by timers.c when
+ * configUSE_TIMER_WHEEL is 1.
+ *
+ * The sorted active list makes starting a timer O(n) in the active timers.
+ * Here a timer goes into one of tmrWHEEL_SLOTS unsorted lists on one of
+ * tmrWHEEL_LEVELS levels, chosen from how far away its expiry time is:
+ *
+ *   level 0 - expiring within 32 ticks, one slot per tick
+ *   level 1 - within 1024 ticks, one slot per 32 ticks
+ *   level 2 - within 32768 ticks, one slot per 1024 ticks
+ *   level 3 - later, one slot per 32768 ticks
+ *
+ * so inserting and removing a timer are O(1).  Each time the wheel passes a
+ * multiple of 32 ticks, the level 1 slot for the next 32 ticks is emptied into
+ * level 0, and likewise for the higher levels (a cascade), so a timer is moved
+ * at most once per level.  A bitmap of occupied slots per level lets the wheel
+ * skip empty slots and work out how long the timer task can sleep.  Timers
+ * more than 2^20 ticks away wait in the last level 3 slot and are cascaded
+ * back into it until they are in range.  Expiry times must be less than 2^31
+ * ticks away.
+ *
+ * The list item value of each timer holds its expiry time, as in the sorted
+ * list, and the slots are ordinary lists, so listIS_CONTAINED_WITHIN() still
+ * tells whether a timer is active.  All calls are made by the timer task only.
+ * Defining tmrWHEEL_SIMULATED replaces the kernel headers with
+ * timer_wheel_sim.h (see software/host_tools/timer_wheel_bench.c).
+ */
+
+#ifdef tmrWHEEL_SIMULATED
+	#include "timer_wheel_sim.h"
+#else
+	#include "FreeRTOS.h"
+	#include "list.h"
+#endif
+
+#define tmrWHEEL_SLOT_BITS		5
+#define tmrWHEEL_SLOTS			( 1UL << tmrWHEEL_SLOT_BITS )
+#define tmrWHEEL_LEVELS			4
+
+typedef struct tmrTimerWheel
+{
+	List_t xSlots[ tmrWHEEL_LEVELS ][ tmrWHEEL_SLOTS ];
+	uint32_t ulOccupied[ tmrWHEEL_LEVELS ];	/*<< Bit n set while slot n of the level holds timers. */
+	TickType_t xTime;						/*<< The next tick to be processed, earlier slots are empty. */
+	UBaseType_t uxTimers;
+} TimerWheel_t;
+
+void vTimerWheelInitialise( TimerWheel_t * const pxWheel, const TickType_t xTimeNow );
+
+/* Inserts a timer whose list item value is set to its expiry time.  A time
+that has already passed expires on the next call to
+pxTimerWheelNextExpired(). */
+void vTimerWheelInsert( TimerWheel_t * const pxWheel, ListItem_t * const pxItem, const TickType_t xTimeNow );
+
+void vTimerWheelRemove( TimerWheel_t * const pxWheel, ListItem_t * const pxItem );
+
+/* Advances the wheel up to xTimeNow and removes and returns one timer that has
+expired, or returns NULL when none has. */
+ListItem_t *pxTimerWheelNextExpired( TimerWheel_t * const pxWheel, const TickType_t xTimeNow );
+
+/* The earliest time a timer can expire, which is the expiry time itself when
+it is within 32 ticks and otherwise the next cascade that could bring one
+closer.  *pxWheelWasEmpty is set to pdTRUE, and 0 returned, when there are no
+timers. */
+TickType_t xTimerWheelNextExpireTime( const TimerWheel_t * const pxWheel, BaseType_t * const pxWheelWasEmpty );
+
+#endif /* TIMER_WHEEL_H */
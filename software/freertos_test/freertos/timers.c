@@ -80,6 +80,10 @@ task.h is included from an application file. */
 #include "queue.h"
 #include "timers.h"
 
+#if ( configUSE_TIMER_WHEEL == 1 )
+	#include "timer_wheel.h"
+#endif
+
 #if ( INCLUDE_xTimerPendFunctionCall == 1 ) && ( configUSE_TIMERS == 0 )
 	#error configUSE_TIMERS must be set to 1 to make the xTimerPendFunctionCall() function available.
 #endif
@@ -98,6 +102,13 @@ configUSE_TIMERS is set to 1 in FreeRTOSConfig.h. */
 #if ( configUSE_TIMERS == 1 )
 
 /* Misc definitions. */
+#if ( configUSE_TIMER_WHEEL == 1 )
+	/* The wheel has no overflow list, so an expiry time is compared with the
+	time now across the tick count wrapping. */
+	#define tmrTIME_REACHED( xTime, xTimeNow )	( ( int32_t ) ( ( TickType_t ) ( ( xTimeNow ) - ( xTime ) ) ) >= 0 )
+#else
+	#define tmrTIME_REACHED( xTime, xTimeNow )	( ( xTime ) <= ( xTimeNow ) )
+#endif
 #define tmrNO_DELAY		( TickType_t ) 0U
 
 /* The definition of the timers themselves. */
@@ -157,13 +168,23 @@ typedef struct tmrTimerQueueMessage
 /*lint -e956 A manual analysis and inspection has been used to determine which
 static variables must be declared volatile. */
 
-/* The list in which active timers are stored.  Timers are referenced in expire
-time order, with the nearest expiry time at the front of the list.  Only the
-timer service task is allowed to access these lists. */
-PRIVILEGED_DATA static List_t xActiveTimerList1;
-PRIVILEGED_DATA static List_t xActiveTimerList2;
-PRIVILEGED_DATA static List_t *pxCurrentTimerList;
-PRIVILEGED_DATA static List_t *pxOverflowTimerList;
+#if ( configUSE_TIMER_WHEEL == 1 )
+
+	/* The timing wheel in which active timers are stored, see timer_wheel.h.
+	Only the timer service task is allowed to access it. */
+	PRIVILEGED_DATA static TimerWheel_t xTimerWheel;
+
+#else
+
+	/* The list in which active timers are stored.  Timers are referenced in
+	expire time order, with the nearest expiry time at the front of the list.
+	Only the timer service task is allowed to access these lists. */
+	PRIVILEGED_DATA static List_t xActiveTimerList1;
+	PRIVILEGED_DATA static List_t xActiveTimerList2;
+	PRIVILEGED_DATA static List_t *pxCurrentTimerList;
+	PRIVILEGED_DATA static List_t *pxOverflowTimerList;
+
+#endif
 
 /* A queue that is used to send commands to the timer service task. */
 PRIVILEGED_DATA static QueueHandle_t xTimerQueue = NULL;
@@ -199,21 +220,28 @@ static void	prvProcessReceivedCommands( void ) PRIVILEGED_FUNCTION;
 
 /*
  * Insert the timer into either xActiveTimerList1, or xActiveTimerList2,
- * depending on if the expire time causes a timer counter overflow.
+ * depending on if the expire time causes a timer counter overflow.  With
+ * configUSE_TIMER_WHEEL it goes into the wheel instead.
  */
 static BaseType_t prvInsertTimerInActiveList( Timer_t * const pxTimer, const TickType_t xNextExpiryTime, const TickType_t xTimeNow, const TickType_t xCommandTime ) PRIVILEGED_FUNCTION;
 
 /*
  * An active timer has reached its expire time.  Reload the timer if it is an
- * auto reload timer, then call its callback.
+ * auto reload timer, then call its callback.  With configUSE_TIMER_WHEEL
+ * xNextExpireTime can be a cascade of the wheel rather than an expiry, in
+ * which case no timer may be due yet.
  */
-static void prvProcessExpiredTimer( const TickType_t xNextExpireTime, const TickType_t xTimeNow ) PRIVILEGED_FUNCTION;
+static void prvProcessExpiredTimer( TickType_t xNextExpireTime, const TickType_t xTimeNow ) PRIVILEGED_FUNCTION;
 
-/*
- * The tick count has overflowed.  Switch the timer lists after ensuring the
- * current timer list does not still reference some timers.
- */
-static void prvSwitchTimerLists( void ) PRIVILEGED_FUNCTION;
+#if ( configUSE_TIMER_WHEEL == 0 )
+
+	/*
+	 * The tick count has overflowed.  Switch the timer lists after ensuring the
+	 * current timer list does not still reference some timers.
+	 */
+	static void prvSwitchTimerLists( void ) PRIVILEGED_FUNCTION;
+
+#endif
 
 /*
  * Obtain the current tick count, setting *pxTimerListsWereSwitched to pdTRUE
@@ -375,14 +403,34 @@ Timer_t *pxTimer = ( Timer_t * ) xTimer;
 }
 /*-----------------------------------------------------------*/
 
-static void prvProcessExpiredTimer( const TickType_t xNextExpireTime, const TickType_t xTimeNow )
+static void prvProcessExpiredTimer( TickType_t xNextExpireTime, const TickType_t xTimeNow )
 {
 BaseType_t xResult;
-Timer_t * const pxTimer = ( Timer_t * ) listGET_OWNER_OF_HEAD_ENTRY( pxCurrentTimerList );
+Timer_t *pxTimer;
+
+	#if ( configUSE_TIMER_WHEEL == 1 )
+	{
+	ListItem_t *pxItem;
 
-	/* Remove the timer from the list of active timers.  A check has already
-	been performed to ensure the list is not empty. */
-	( void ) uxListRemove( &( pxTimer->xTimerListItem ) );
+		/* Advance the wheel and remove the first timer that has expired, if
+		the wake up was not just for a cascade.  The timer's own expiry time is
+		the reference for reloading it. */
+		pxItem = pxTimerWheelNextExpired( &xTimerWheel, xTimeNow );
+		if( pxItem == NULL )
+		{
+			return;
+		}
+		pxTimer = ( Timer_t * ) listGET_LIST_ITEM_OWNER( pxItem );
+		xNextExpireTime = listGET_LIST_ITEM_VALUE( pxItem );
+	}
+	#else
+	{
+		/* Remove the timer from the list of active timers.  A check has
+		already been performed to ensure the list is not empty. */
+		pxTimer = ( Timer_t * ) listGET_OWNER_OF_HEAD_ENTRY( pxCurrentTimerList );
+		( void ) uxListRemove( &( pxTimer->xTimerListItem ) );
+	}
+	#endif /* configUSE_TIMER_WHEEL */
 	traceTIMER_EXPIRED( pxTimer );
 
 	/* If the timer is an auto reload timer then calculate the next
@@ -455,7 +503,7 @@ BaseType_t xTimerListsWereSwitched;
 		if( xTimerListsWereSwitched == pdFALSE )
 		{
 			/* The tick count has not overflowed, has the timer expired? */
-			if( ( xListWasEmpty == pdFALSE ) && ( xNextExpireTime <= xTimeNow ) )
+			if( ( xListWasEmpty == pdFALSE ) && tmrTIME_REACHED( xNextExpireTime, xTimeNow ) )
 			{
 				( void ) xTaskResumeAll();
 				prvProcessExpiredTimer( xNextExpireTime, xTimeNow );
@@ -503,16 +551,26 @@ TickType_t xNextExpireTime;
 	this task to unblock when the tick count overflows, at which point the
 	timer lists will be switched and the next expiry time can be
 	re-assessed.  */
-	*pxListWasEmpty = listLIST_IS_EMPTY( pxCurrentTimerList );
-	if( *pxListWasEmpty == pdFALSE )
+	#if ( configUSE_TIMER_WHEEL == 1 )
 	{
-		xNextExpireTime = listGET_ITEM_VALUE_OF_HEAD_ENTRY( pxCurrentTimerList );
+		/* The wheel gives the expiry time when it is close, and otherwise the
+		time of the cascade that brings the nearest timers closer. */
+		xNextExpireTime = xTimerWheelNextExpireTime( &xTimerWheel, pxListWasEmpty );
 	}
-	else
+	#else
 	{
-		/* Ensure the task unblocks when the tick count rolls over. */
-		xNextExpireTime = ( TickType_t ) 0U;
+		*pxListWasEmpty = listLIST_IS_EMPTY( pxCurrentTimerList );
+		if( *pxListWasEmpty == pdFALSE )
+		{
+			xNextExpireTime = listGET_ITEM_VALUE_OF_HEAD_ENTRY( pxCurrentTimerList );
+		}
+		else
+		{
+			/* Ensure the task unblocks when the tick count rolls over. */
+			xNextExpireTime = ( TickType_t ) 0U;
+		}
 	}
+	#endif /* configUSE_TIMER_WHEEL */
 
 	return xNextExpireTime;
 }
@@ -525,17 +583,28 @@ PRIVILEGED_DATA static TickType_t xLastTime = ( TickType_t ) 0U; /*lint !e956 Va
 
 	xTimeNow = xTaskGetTickCount();
 
-	if( xTimeNow < xLastTime )
-	{
-		prvSwitchTimerLists();
-		*pxTimerListsWereSwitched = pdTRUE;
-	}
-	else
+	#if ( configUSE_TIMER_WHEEL == 1 )
 	{
+		/* The wheel works across the tick count overflowing, there are no
+		lists to switch. */
+		( void ) xLastTime;
 		*pxTimerListsWereSwitched = pdFALSE;
 	}
+	#else
+	{
+		if( xTimeNow < xLastTime )
+		{
+			prvSwitchTimerLists();
+			*pxTimerListsWereSwitched = pdTRUE;
+		}
+		else
+		{
+			*pxTimerListsWereSwitched = pdFALSE;
+		}
 
-	xLastTime = xTimeNow;
+		xLastTime = xTimeNow;
+	}
+	#endif /* configUSE_TIMER_WHEEL */
 
 	return xTimeNow;
 }
@@ -548,35 +617,53 @@ BaseType_t xProcessTimerNow = pdFALSE;
 	listSET_LIST_ITEM_VALUE( &( pxTimer->xTimerListItem ), xNextExpiryTime );
 	listSET_LIST_ITEM_OWNER( &( pxTimer->xTimerListItem ), pxTimer );
 
-	if( xNextExpiryTime <= xTimeNow )
+	#if ( configUSE_TIMER_WHEEL == 1 )
 	{
-		/* Has the expiry time elapsed between the command to start/reset a
-		timer was issued, and the time the command was processed? */
+		/* xNextExpiryTime is xCommandTime plus the period, so the timer has
+		expired if at least the period has passed since the command was
+		issued, whether or not the tick count overflowed in between. */
 		if( ( xTimeNow - xCommandTime ) >= pxTimer->xTimerPeriodInTicks )
 		{
-			/* The time between a command being issued and the command being
-			processed actually exceeds the timers period.  */
 			xProcessTimerNow = pdTRUE;
 		}
 		else
 		{
-			vListInsert( pxOverflowTimerList, &( pxTimer->xTimerListItem ) );
+			vTimerWheelInsert( &xTimerWheel, &( pxTimer->xTimerListItem ), xTimeNow );
 		}
 	}
-	else
+	#else
 	{
-		if( ( xTimeNow < xCommandTime ) && ( xNextExpiryTime >= xCommandTime ) )
+		if( xNextExpiryTime <= xTimeNow )
 		{
-			/* If, since the command was issued, the tick count has overflowed
-			but the expiry time has not, then the timer must have already passed
-			its expiry time and should be processed immediately. */
-			xProcessTimerNow = pdTRUE;
+			/* Has the expiry time elapsed between the command to start/reset a
+			timer was issued, and the time the command was processed? */
+			if( ( xTimeNow - xCommandTime ) >= pxTimer->xTimerPeriodInTicks )
+			{
+				/* The time between a command being issued and the command being
+				processed actually exceeds the timers period.  */
+				xProcessTimerNow = pdTRUE;
+			}
+			else
+			{
+				vListInsert( pxOverflowTimerList, &( pxTimer->xTimerListItem ) );
+			}
 		}
 		else
 		{
-			vListInsert( pxCurrentTimerList, &( pxTimer->xTimerListItem ) );
+			if( ( xTimeNow < xCommandTime ) && ( xNextExpiryTime >= xCommandTime ) )
+			{
+				/* If, since the command was issued, the tick count has overflowed
+				but the expiry time has not, then the timer must have already passed
+				its expiry time and should be processed immediately. */
+				xProcessTimerNow = pdTRUE;
+			}
+			else
+			{
+				vListInsert( pxCurrentTimerList, &( pxTimer->xTimerListItem ) );
+			}
 		}
 	}
+	#endif /* configUSE_TIMER_WHEEL */
 
 	return xProcessTimerNow;
 }
@@ -624,7 +711,15 @@ TickType_t xTimeNow;
 			if( listIS_CONTAINED_WITHIN( NULL, &( pxTimer->xTimerListItem ) ) == pdFALSE )
 			{
 				/* The timer is in a list, remove it. */
-				( void ) uxListRemove( &( pxTimer->xTimerListItem ) );
+				#if ( configUSE_TIMER_WHEEL == 1 )
+				{
+					vTimerWheelRemove( &xTimerWheel, &( pxTimer->xTimerListItem ) );
+				}
+				#else
+				{
+					( void ) uxListRemove( &( pxTimer->xTimerListItem ) );
+				}
+				#endif /* configUSE_TIMER_WHEEL */
 			}
 			else
 			{
@@ -708,6 +803,8 @@ TickType_t xTimeNow;
 }
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_TIMER_WHEEL == 0 )
+
 static void prvSwitchTimerLists( void )
 {
 TickType_t xNextExpireTime, xReloadTime;
@@ -765,6 +862,8 @@ BaseType_t xResult;
 	pxCurrentTimerList = pxOverflowTimerList;
 	pxOverflowTimerList = pxTemp;
 }
+
+#endif /* configUSE_TIMER_WHEEL */
 /*-----------------------------------------------------------*/
 
 static void prvCheckForValidListAndQueue( void )
@@ -776,10 +875,18 @@ static void prvCheckForValidListAndQueue( void )
 	{
 		if( xTimerQueue == NULL )
 		{
-			vListInitialise( &xActiveTimerList1 );
-			vListInitialise( &xActiveTimerList2 );
-			pxCurrentTimerList = &xActiveTimerList1;
-			pxOverflowTimerList = &xActiveTimerList2;
+			#if ( configUSE_TIMER_WHEEL == 1 )
+			{
+				vTimerWheelInitialise( &xTimerWheel, xTaskGetTickCount() );
+			}
+			#else
+			{
+				vListInitialise( &xActiveTimerList1 );
+				vListInitialise( &xActiveTimerList2 );
+				pxCurrentTimerList = &xActiveTimerList1;
+				pxOverflowTimerList = &xActiveTimerList2;
+			}
+			#endif /* configUSE_TIMER_WHEEL */
 			xTimerQueue = xQueueCreate( ( UBaseType_t ) configTIMER_QUEUE_LENGTH, sizeof( DaemonTaskMessage_t ) );
 			configASSERT( xTimerQueue );
 
@@ -11,17 +11,43 @@
 #include "FreeRTOS/task.h"
 #include "FreeRTOS/queue.h"
 #include "FreeRTOS/semphr.h"
-#include "FreeRTOS/timers.h"
+
+// Build profile: HEADLESS set compiles out the VGA display with its plot history and the Tab key, and
+// shows frequency, state and the last shed time on the seven segment display instead. Can also be
+// set from the Makefile, APP_CFLAGS_DEFINED_SYMBOLS := -DHEADLESS=1
+#ifndef HEADLESS
+#define HEADLESS 0
+#endif
 
 #include <altera_avalon_pio_regs.h>
+#if !HEADLESS
 #include <altera_up_avalon_video_pixel_buffer_dma.h>
 #include <altera_up_avalon_video_character_buffer_with_dma.h>
+#endif
 #include "altera_up_avalon_ps2.h"
-#include "altera_up_ps2_keyboard.h"
+#include "altera_up_avalon_ps2_regs.h"
 #include "sys/alt_irq.h"
 
+#include "telemetry.h"
+#include "log.h"
+#include "irq_storm.h"
+#include "deadline.h"
+#include "history.h"
+#include "shed_journal.h"
+#include "boot_profile.h"
+#include "roc_estimator.h"
+#include "freq_channel.h"
+#include "load_fsm.h"
+#include "lcd.h"
+#include "thresholds.h"
+#include "jtag_uart.h"
+#include "command.h"
+#include "usleep.h"
+#include "profiler.h"
+
 // Forward declarations
 int initOSDataStructs(void);
+int initProtectionTasks(void);
 int initCreateTasks(void);
 
 // Definitions for frequency plot
@@ -36,31 +62,44 @@ int initCreateTasks(void);
 #define ROCPLT_ROC_RES 0.5		//number of pixels per Hz/s (y axis scale)
 
 #define MIN_FREQ 45.0 //minimum frequency to draw
+#define FREQ_THRESHOLD 50 //Hz, thresholds at power up, moved with the keyboard
+#define ROC_THRESHOLD 10 //Hz/s
+#define VGA_UPDATE_PERIOD 0 //ticks VGA_Task sleeps between redraws, 0 redraws continuously and the idle task never runs
+#define STATUS_UPDATE_PERIOD 100 //ticks Status_Task sleeps between checks of the seven segment display, HEADLESS only
+#define SIM_CHANNELS 0 //channels fed by Sim_Analyser_Task on top of the real analysers, to load the calculation task
+#define SIM_SAMPLE_PERIOD 20 //ticks between samples of a simulated channel, 50 Hz
 
 // Definition of Task Stacks
 #define   TASK_STACKSIZE       2048
 
 // Definition of Task Priorities
 #define VGA_TASK_PRIORITY 				(tskIDLE_PRIORITY+1)
+#define STATUS_TASK_PRIORITY 			(tskIDLE_PRIORITY+1)
 #define CALCULATION_TASK_PRIORITY 		(tskIDLE_PRIORITY+4)
 #define FSM_TASK_PRIORITY 				(tskIDLE_PRIORITY+3)
 #define KEYBOARD_UPDATE_TASK_PRIORITY 	(tskIDLE_PRIORITY+2)
+#define COMMAND_TASK_PRIORITY 			(tskIDLE_PRIORITY+2)
+#define LOG_TASK_PRIORITY 				(tskIDLE_PRIORITY+1)
+#define IRQ_STORM_TASK_PRIORITY 		(tskIDLE_PRIORITY+2)
+#define PROFILE_TASK_PRIORITY 			(tskIDLE_PRIORITY+1)
+#define JOURNAL_TASK_PRIORITY 			(tskIDLE_PRIORITY+1)
+#define SIM_ANALYSER_TASK_PRIORITY 		(tskIDLE_PRIORITY+5)
+#define INIT_TASK_PRIORITY 				(tskIDLE_PRIORITY+1)
 
 // Definition of Queue Sizes
-#define HW_DATA_QUEUE_SIZE 	100
-#define KB_DATA_QUEUE_SIZE 	10
+#define HW_DATA_QUEUE_SIZE 	(100 + SIM_CHANNELS) // room for a sample from every simulated channel at once
+#define KB_DATA_QUEUE_SIZE 	32 // raw scancode bytes, an extended key press and release is 5 bytes
 
 // Definition of system parameters
 #define SAMPLING_FREQ 16000.0
-#define NO_OF_LOADS 5
-#define TIMER_PERIOD (500 / portTICK_RATE_MS)
+#define NO_OF_LOADS LOAD_FSM_LOADS
+#define TIMER_PERIOD_MS 500
 
-// Macro to check if bit is set
-#define CHECK_BIT(var,pos) ((var) & (1<<(pos)))
+// Interrupt dispatch order when several IRQs are pending, highest priority first
+const alt_u8 irq_priority[] = {FREQUENCY_ANALYSER_IRQ, TIMER1MS_IRQ, PUSH_BUTTON_IRQ, PS2_IRQ, UART_IRQ, JTAG_UART_IRQ, TIMER1US_IRQ};
+const unsigned int irq_priority_count = sizeof(irq_priority) / sizeof(irq_priority[0]);
 
 // Definition of enums and structs
-typedef enum {NORMAL_OPERATION, LOAD_MGMT_MONITOR_STABLE, LOAD_MGMT_MONITOR_UNSTABLE, MAINTENANCE_MODE} state;
-
 typedef struct{
     unsigned int x1;
     unsigned int y1;
@@ -70,32 +109,46 @@ typedef struct{
 
 typedef enum { false, true } bool;
 
+typedef struct {
+	unsigned int base;
+	unsigned int irq;
+} analyser;
+
+// A sample from an analyser ISR or Sim_Analyser_Task, for the channel's pipeline
+typedef struct {
+	unsigned int channel;
+	double freq;
+} channel_sample;
+
+// Frequency analysers, channel i is fed by analysers[i] and the simulated channels come after them.
+// Channel 0 is the one displayed and reported, the system is only stable while every channel is
+const analyser analysers[] = {{FREQUENCY_ANALYSER_BASE, FREQUENCY_ANALYSER_IRQ}};
+#define REAL_CHANNELS (sizeof(analysers) / sizeof(analysers[0]))
+#define FREQ_CHANNELS (REAL_CHANNELS + SIM_CHANNELS)
+
 // Definition of RTOS Handles
-SemaphoreHandle_t freq_roc_sem; // mutex to protect freq and roc global arrays - written to in RoC_Calculation task, read in VGA task
-SemaphoreHandle_t thresholds_sem; // mutex to protect threshold global vars - written in kb update task, read in vga task & roc calculation task
+SemaphoreHandle_t freq_roc_sem; // mutex to protect the channels - written to in RoC_Calculation task, read in VGA task
 SemaphoreHandle_t shed_sem; // mutex to protect shedding variables - written in roc calculation task, read in vga task, written and read to in fsm task
 
-QueueHandle_t HW_dataQ; // contains frequency values from analyser
-QueueHandle_t kb_dataQ; // stores keystrokes
+QueueHandle_t HW_dataQ; // contains channel_samples from the analysers
+QueueHandle_t kb_dataQ; // stores raw scancode bytes from the PS/2 FIFO, decoded in the kb update task
 
-TimerHandle_t fsm_timer;
 
 // Global variables
 
 // Related to frequency and RoC values
-int freq_idx = 99; // used for configuring HW_dataQ with f values and displaying
-double freq[100];
-double roc[100];
-
-// Related to system thresholds and states
-double freq_threshold = 50; 
-double roc_threshold = 10;
+freq_channel channels[FREQ_CHANNELS]; // one pipeline per analyser, updated by the RoC task
+#if !HEADLESS
+history freq_history; // per second/minute/hour aggregates of freq and roc, also under freq_roc_sem
+volatile unsigned int plot_scale = 0; // 0 plots the raw samples, 1 + history_tier_id plots that tier's buckets
+const char *plot_scale_names[HISTORY_TIERS + 1] = {"last 100 samples", "last 100 s      ", "last 100 min    ", "last 100 h      "};
+#endif
+
+// Related to system thresholds and states, the thresholds themselves are published by thresholds.c
 bool system_stable = true; // system_stable is manipulated when thresholds are good/bad
-state system_state = NORMAL_OPERATION; // note: not the same as system_stable, system_state describes current mode of operation
+load_fsm relay_fsm; // note: its state is not the same as system_stable, it describes current mode of operation
 state prev_state;
-static bool load_states[NO_OF_LOADS];
-static bool sw_load_states[NO_OF_LOADS];
-bool timer_expired_flag = false; // high when 500ms timer expires, does not need a sem since data R/W on here is atomic and done by one task
+volatile unsigned int remote_load_mask = 0xff; // loads the remote side allows on, ANDed with the switches
 
 // Related to timing mechanisms for shedding
 
@@ -107,30 +160,53 @@ unsigned int max_shed_time = 0;
 float avg_shed_time = 0;
 bool array_filled = 0;
 unsigned int shed_count = 0;
+double shed_trigger_freq = 0; // freq and roc of the last unstable sample, journalled with the shed
+double shed_trigger_roc = 0;
+
+// ISR execution time, in ulPortGetTimestamp() counts (portTIMESTAMP_HZ)
+volatile unsigned int ps2_isr_time_last = 0;
+volatile unsigned int ps2_isr_time_max = 0;
 
 
 
 
-// ISR for capturing freq data from analyser
-void freq_relay() {
-	unsigned int adc_samples = IORD(FREQUENCY_ANALYSER_BASE, 0);	// number of ADC samples
-	double new_freq = SAMPLING_FREQ/(double)adc_samples;
+// ISR for capturing freq data from analyser, context is its entry in analysers
+void freq_relay(void* context, alt_u32 id) {
+	const analyser *a = context;
+	channel_sample sample;
+	unsigned int adc_samples = IORD(a->base, 0);	// number of ADC samples
+	BaseType_t higher_prio_woken = pdFALSE;
+	sample.channel = a - analysers;
+	sample.freq = SAMPLING_FREQ/(double)adc_samples;
+	boot_mark(BOOT_FIRST_SAMPLE);
+	if (sample.channel == 0) {
+		telemetry_sample(adc_samples); // the telemetry records carry no channel
+	}
 	// ROC calculation done in separate Calculation task to minimise ISR time
-	xQueueSendToBackFromISR(HW_dataQ, &new_freq, NULL);
+	xQueueSendToBackFromISR(HW_dataQ, &sample, &higher_prio_woken);
+	portEND_SWITCHING_ISR(higher_prio_woken); // run the calculation task as soon as the ISR exits, not at the next tick
 	return;
 }
 
 // ISR for keyboard input
+// only drains raw bytes from the PS/2 FIFO, scancode decoding is done in Keyboard_Update_Task
 void ps2_isr (void* context, alt_u32 id)
 {
-	char ascii;
-	int status = 0;
-	unsigned char key = 0;
-	KB_CODE_TYPE decode_mode;
-	status = decode_scancode (context, &decode_mode , &key , &ascii) ;
-	if ( status == 0 ) //success
-	{
-		xQueueSendFromISR(kb_dataQ, &key, pdFALSE);
+	unsigned int start = ulPortGetTimestamp();
+	unsigned int data = IORD_ALT_UP_PS2_PORT_DATA_REG(PS2_BASE); // reading pops the FIFO
+	unsigned char byte;
+	BaseType_t higher_prio_woken = pdFALSE;
+
+	while (data & ALT_UP_PS2_PORT_DATA_REG_RVALID_MSK) {
+		byte = data & ALT_UP_PS2_PORT_DATA_REG_DATA_MSK;
+		xQueueSendFromISR(kb_dataQ, &byte, &higher_prio_woken);
+		data = IORD_ALT_UP_PS2_PORT_DATA_REG(PS2_BASE);
+	}
+	portEND_SWITCHING_ISR(higher_prio_woken);
+
+	ps2_isr_time_last = ulPortGetTimestamp() - start;
+	if (ps2_isr_time_last > ps2_isr_time_max) {
+		ps2_isr_time_max = ps2_isr_time_last;
 	}
 }
 
@@ -138,13 +214,13 @@ void ps2_isr (void* context, alt_u32 id)
 void button_irq(void* context, alt_u32 id)
 {
 	if (IORD_ALTERA_AVALON_PIO_EDGE_CAP(PUSH_BUTTON_BASE) == 4) {
-		if (system_state != MAINTENANCE_MODE) {
-			prev_state = system_state; // save previous state
-			system_state = MAINTENANCE_MODE;
+		if (relay_fsm.state != MAINTENANCE_MODE) {
+			prev_state = relay_fsm.state; // save previous state
+			relay_fsm.state = MAINTENANCE_MODE;
 
 		}
 		else {
-			system_state = prev_state;
+			relay_fsm.state = prev_state;
 		}
 	}
    //clears the edge capture register
@@ -152,62 +228,169 @@ void button_irq(void* context, alt_u32 id)
   return;
 }
 
+// LCD top row, the thresholds only move in whole steps
+void lcd_show_thresholds(const thresholds *t) {
+	char line[LCD_COLS + 1];
+	snprintf(line, sizeof(line), "F<%d RoC>%d", (int)t->freq, (int)t->roc);
+	lcd_line(0, line);
+}
+
 void Keyboard_Update_Task(void *pvParameters) {
 	unsigned char key;
+	bool break_code = false; // set after 0xF0, the next byte is a key release
+	unsigned int reported_isr_time_max = 0;
+	thresholds t;
+
+	thresholds_read(&t);
+	lcd_show_thresholds(&t);
 	while(1) {
 		xQueueReceive(kb_dataQ, &key, portMAX_DELAY);
-		xSemaphoreTake(thresholds_sem, portMAX_DELAY);
 
-		// adjust thresholds according to keycode
-		// 0.5 because every time you press a key it goes twice
+		if (ps2_isr_time_max != reported_isr_time_max) {
+			reported_isr_time_max = ps2_isr_time_max;
+			LOG("ps2_isr worst case %u cycles (last %u)\n", reported_isr_time_max, ps2_isr_time_last);
+		}
+
+		// decode scancodes: skip the 0xE0 extended prefix, and drop break codes so one key press is one step
+		if (key == 0xE0) {
+			continue;
+		}
+		if (key == 0xF0) {
+			break_code = true;
+			continue;
+		}
+		if (break_code == true) {
+			break_code = false;
+			continue;
+		}
+
+#if !HEADLESS
+		if (key == 0x0d) { // tab, next plot time scale
+			plot_scale = (plot_scale + 1) % (HISTORY_TIERS + 1);
+			continue;
+		}
+#endif
+
+		// adjust thresholds according to make code, from the published ones as Command_Task may have set them
+		thresholds_read(&t);
 		if (key == 0x75) { // up arrow
-			freq_threshold += 0.5;
+			t.freq += 1;
 		}
 		else if (key == 0x72) { // down arrow
-			freq_threshold -= 0.5;
+			t.freq -= 1;
 		}
 		else if (key == 0x7d) { // pg up
-			roc_threshold += 0.5;
+			t.roc += 1;
 		}
 		else if (key == 0x7a) { // pg down
-			roc_threshold -= 0.5;
+			t.roc -= 1;
+		}
+		else {
+			continue;
 		}
-		xSemaphoreGive(thresholds_sem);
+		thresholds_publish(t.freq, t.roc);
+		lcd_show_thresholds(&t);
 	}
 }
 
 // ROC Calculation Task
+// One engine for every channel: takes the samples of all analysers in arrival order and runs each through its channel
 void ROC_Calculation_Task(void *pvParameters) {
+	unsigned int received, detect_time, detect_time_max = 0; // ulPortGetTimestamp() counts from a sample to its stability decision
+	unsigned int unstable_channels = 0; // channels whose last sample was unstable
+	channel_sample sample;
+	freq_channel *c;
+	double roc;
+	int was_stable;
+	thresholds t;
+
 	while(1) {
-		xQueueReceive(HW_dataQ, freq+freq_idx, portMAX_DELAY); // pops new f value from back of q to freq array
+		xQueueReceive(HW_dataQ, &sample, portMAX_DELAY);
+		received = ulPortGetTimestamp();
+		c = &channels[sample.channel];
+		thresholds_read(&t); // never waits for the keyboard or display tasks
 		xSemaphoreTake(freq_roc_sem, portMAX_DELAY);
 
-		// calculate frequency ROC based on example code
-		if(freq_idx == 0) { // roc needs two points, account for edge case
-			roc[0] = (freq[0]-freq[99]) * 2.0 * freq[0] * freq[99] / (freq[0]+freq[99]);
-		} else {
-			roc[freq_idx] = (freq[freq_idx]-freq[freq_idx-1]) * 2.0 * freq[freq_idx]* freq[freq_idx-1] / (freq[freq_idx]+freq[freq_idx-1]);
-		}
-
-		if (roc[freq_idx] > 100.0){
-			roc[freq_idx] = 100.0;
+		was_stable = c->stable;
+		freq_channel_update(c, sample.freq, t.freq, t.roc); // ROC_METHOD, see roc_estimator.h
+		roc = freq_channel_roc(c, FREQ_CHANNEL_SAMPLES - 1);
+#if !HEADLESS
+		if (sample.channel == 0) {
+			history_add(&freq_history, xTaskGetTickCount() * portTICK_PERIOD_MS, sample.freq, roc);
 		}
+#endif
 		xSemaphoreGive(freq_roc_sem);
 
 		// also update whether system is stable or not, done here since it's got both freq and roc
-		xSemaphoreTake(thresholds_sem, portMAX_DELAY);
-		if (((freq[freq_idx] < freq_threshold) || (fabs(roc[freq_idx]) >= roc_threshold)) && (system_state != MAINTENANCE_MODE)) {
+		if (c->stable != was_stable) {
+			if (c->stable) {
+				unstable_channels--;
+			}
+			else {
+				unstable_channels++;
+			}
+		}
+		if (!c->stable && (relay_fsm.state != MAINTENANCE_MODE)) {
 			xSemaphoreTake(shed_sem, portMAX_DELAY);
 			time_before_shed = xTaskGetTickCountFromISR(); // instability will first be detected here, so get t=0 from here 
+			shed_trigger_freq = c->trigger_freq;
+			shed_trigger_roc = c->trigger_roc;
 			xSemaphoreGive(shed_sem);
 			system_stable = false;
 		}
-		else {
+		else if ((unstable_channels == 0) || (relay_fsm.state == MAINTENANCE_MODE)) {
 			system_stable = true;
 		}
-		xSemaphoreGive(thresholds_sem);
-		freq_idx = (++freq_idx) % 100; // point to the next data (oldest) to be overwritten
+		// otherwise another channel is still unstable, it stays unstable until that channel's next sample
+		detect_time = ulPortGetTimestamp() - received;
+		if (detect_time > detect_time_max) {
+			detect_time_max = detect_time;
+			LOG("detection worst case %u timestamp counts\n", detect_time_max);
+		}
+		boot_mark(BOOT_PROTECTION);
+		if (sample.channel == 0) {
+			telemetry_roc(sample.freq, roc, system_stable);
+		}
+	}
+}
+
+#if SIM_CHANNELS
+// Feeds every simulated channel a steady 50 Hz sample each SIM_SAMPLE_PERIOD, so they cost the
+// calculation task as much as real analysers without ever triggering a shed
+void Sim_Analyser_Task(void *pvParameters) {
+	channel_sample sample;
+	unsigned int i;
+
+	sample.freq = SAMPLING_FREQ / 320.0;
+	while (1) {
+		vTaskDelay(SIM_SAMPLE_PERIOD);
+		for (i = REAL_CHANNELS; i < FREQ_CHANNELS; i++) {
+			sample.channel = i;
+			xQueueSendToBack(HW_dataQ, &sample, 0);
+		}
+	}
+}
+#endif
+
+// Running minimum, maximum and average of shed_time_measurements. Call with shed_sem held
+void calc_shed_stats() {
+	int i;
+
+	// calculate running minimum and maximum
+	for (i = 0; i < 5; i++) {
+		if (shed_time_measurements[i] < min_shed_time && shed_time_measurements[i] != 0) {
+			min_shed_time = shed_time_measurements[i];
+		}
+		if (shed_time_measurements[i] > max_shed_time) {
+			max_shed_time = shed_time_measurements[i];
+		}
+	}
+	// calculate average
+	unsigned int sum = 0;
+	for (i = 0; i < 5; i++) {
+		sum += shed_time_measurements[i];
 	}
+	avg_shed_time = (float)sum/(float)shed_count;
 }
 
 void update_shed_stats() {
@@ -245,38 +428,152 @@ void update_shed_stats() {
 		}
 		shed_time_measurements[4] = shed_time;
 	}
-	// calculate running minimum and maximum
-	for (i = 0; i < 5; i++) {
-		if (shed_time_measurements[i] < min_shed_time && shed_time_measurements[i] != 0) {
-			min_shed_time = shed_time_measurements[i];
-		}
-		if (shed_time_measurements[i] > max_shed_time) {
-			max_shed_time = shed_time_measurements[i];
+	shed_journal_event(SHED_JOURNAL_INITIAL_SHED, 0, shed_time, shed_trigger_freq, shed_trigger_roc);
+	calc_shed_stats();
+	xSemaphoreGive(shed_sem);
+}
+
+// Shed times from before the last reset, from the flash journal. Call with shed_sem held once the
+// scheduler runs. Sheds since this boot take precedence
+void restore_shed_stats() {
+	unsigned int recent[5];
+	unsigned int n;
+	unsigned int i;
+
+	if (shed_count != 0) {
+		return;
+	}
+	n = shed_journal_recent(recent, 5);
+	if (n == 0) {
+		return;
+	}
+	for (i = 0; i < n; i++) {
+		shed_time_measurements[i] = recent[n - 1 - i]; // oldest first, as update_shed_stats keeps them
+	}
+	shed_count = n;
+	array_filled = (n == 5);
+	shed_time = recent[0];
+	min_shed_time = recent[0];
+	calc_shed_stats();
+}
+
+// Once a second, report the tick interrupts taken, fewer than configTICK_RATE_HZ when tickless idle suppresses them
+void report_stats(unsigned int uptime) {
+	static unsigned int reported_at = 0;
+	static uint32_t reported_ticks = 0;
+	static unsigned int reported_slept = 0, reported_spun = 0;
+	if (uptime != reported_at) {
+		uint32_t ticks = ulPortTickInterrupts();
+		unsigned int slept, spun;
+		reported_at = uptime;
+		LOG("tick interrupts: %u in the last second\n", ticks - reported_ticks);
+		reported_ticks = ticks;
+		// CPU usleep() gave back to other tasks (slept) against what it still busy waited (spun)
+		usleep_stats(&slept, &spun);
+		if (slept != reported_slept || spun != reported_spun) {
+			LOG("usleep: %u us slept, %u us spun in the last second\n", slept - reported_slept, spun - reported_spun);
+			reported_slept = slept;
+			reported_spun = spun;
 		}
+#if configMEASURE_TASK_SELECTION
+		// and the time spent picking the next task in vTaskSwitchContext
+		uint32_t sel_max, sel_total, sel_count;
+		vPortGetTaskSelectionTime(&sel_max, &sel_total, &sel_count);
+		LOG("task selection: %u switches, worst %u, total %u timestamp counts\n", sel_count, sel_max, sel_total);
+#endif
 	}
-	// calculate average
-	unsigned int sum = 0;
-	for (i = 0; i < 5; i++) {
-		sum += shed_time_measurements[i];
+}
+
+#if HEADLESS
+// Status_Task
+// Value as BCD, one digit per nibble, saturating at all nines
+unsigned int to_bcd(unsigned int value, unsigned int digits) {
+	unsigned int bcd = 0, i;
+	for (i = 0; i < digits; i++) {
+		bcd |= (value % 10) << (4 * i);
+		value /= 10;
 	}
-	avg_shed_time = (float)sum/(float)shed_count;
-	xSemaphoreGive(shed_sem);
+	return value ? ((1u << (4 * digits)) - 1) / 15 * 9 : bcd; // 0x1111 * 9 for four digits
 }
 
+// Headless stand-in for VGA_Task. HEX7-HEX4 show the frequency in 0.01 Hz, HEX3 the system state
+// and HEX2-HEX0 the last initial shed time in ms. The display is only written when that changes
+void Status_Task(void *pvParameters) {
+	unsigned int shown = ~0u, word, centi_hz, last_shed;
+	double f;
+
+	while (1) {
+		xSemaphoreTake(freq_roc_sem, portMAX_DELAY);
+		f = freq_channel_freq(&channels[0], FREQ_CHANNEL_SAMPLES - 1); // newest sample
+		xSemaphoreGive(freq_roc_sem);
+		xSemaphoreTake(shed_sem, portMAX_DELAY);
+		last_shed = shed_time;
+		xSemaphoreGive(shed_sem);
+
+		centi_hz = f > 0 ? (unsigned int)(f * 100.0 + 0.5) : 0;
+		word = (to_bcd(centi_hz, 4) << 16) | (relay_fsm.state << 12) | to_bcd(last_shed, 3);
+		if (word != shown) {
+			IOWR(SEVEN_SEG_BASE, 0, word);
+			if (shown == ~0u) {
+				boot_mark(BOOT_DISPLAY);
+			}
+			shown = word;
+		}
+		report_stats(xTaskGetTickCount()/1000);
+		vTaskDelay(STATUS_UPDATE_PERIOD);
+	}
+}
+#else
 // VGA_Task
+// Plot point j (0 the oldest) at the selected time scale: a raw sample or a bucket mean. Call with freq_roc_sem held
+bool plot_point(unsigned int scale, unsigned int j, double *f, double *r) {
+	const history_bucket *b;
+	if (scale == 0) {
+		*f = freq_channel_freq(&channels[0], j);
+		*r = freq_channel_roc(&channels[0], j);
+		return true;
+	}
+	b = history_point(&freq_history, (history_tier_id)(scale - 1), j);
+	if (b == NULL) {
+		return false; // no samples in that period
+	}
+	*f = history_mean(&b->freq, b);
+	*r = history_mean(&b->roc, b);
+	return true;
+}
+
+// Bucket min to max as a grey bar behind the mean line. Call with freq_roc_sem held
+void draw_range_bar(alt_up_pixel_buffer_dma_dev *pixel_buf, unsigned int scale, unsigned int j) {
+	const int grey = (0x180 << 20) + (0x180 << 10) + 0x180;
+	const history_bucket *b = history_point(&freq_history, (history_tier_id)(scale - 1), j);
+	int x, y_top, y_bottom;
+	if (b == NULL || b->freq.max <= MIN_FREQ) {
+		return;
+	}
+	x = FREQPLT_ORI_X + FREQPLT_GRID_SIZE_X * j;
+	y_top = (int)(FREQPLT_ORI_Y - FREQPLT_FREQ_RES * (b->freq.max - MIN_FREQ));
+	y_bottom = (int)(FREQPLT_ORI_Y - FREQPLT_FREQ_RES * ((b->freq.min > MIN_FREQ ? b->freq.min : MIN_FREQ) - MIN_FREQ));
+	alt_up_pixel_buffer_dma_draw_vline(pixel_buf, x, y_top > 0 ? y_top : 0, y_bottom, grey, 0);
+
+	x = ROCPLT_ORI_X + ROCPLT_GRID_SIZE_X * j;
+	y_top = (int)(ROCPLT_ORI_Y - ROCPLT_ROC_RES * b->roc.max);
+	y_bottom = (int)(ROCPLT_ORI_Y - ROCPLT_ROC_RES * b->roc.min);
+	alt_up_pixel_buffer_dma_draw_vline(pixel_buf, x, y_top > 201 ? y_top : 201, y_bottom < 299 ? y_bottom : 299, grey, 0);
+}
+
 void VGA_Task(void *pvParameters){
 	//initialize VGA controllers
 	alt_up_pixel_buffer_dma_dev *pixel_buf;
 	pixel_buf = alt_up_pixel_buffer_dma_open_dev(VIDEO_PIXEL_BUFFER_DMA_NAME);
 	if(pixel_buf == NULL){
-		printf("can't find pixel buffer device\n");
+		LOG("can't find pixel buffer device\n");
 	}
 	alt_up_pixel_buffer_dma_clear_screen(pixel_buf, 0);
 
 	alt_up_char_buffer_dev *char_buf;
 	char_buf = alt_up_char_buffer_open_dev("/dev/video_character_buffer_with_dma");
 	if(char_buf == NULL){
-		printf("can't find char buffer device\n");
+		LOG("can't find char buffer device\n");
 	}
 	alt_up_char_buffer_clear(char_buf);
 
@@ -298,30 +595,31 @@ void VGA_Task(void *pvParameters){
 	alt_up_char_buffer_string(char_buf, "0", 10, 32);
 	alt_up_char_buffer_string(char_buf, "-30", 9, 34);
 	alt_up_char_buffer_string(char_buf, "-60", 9, 36);
+	boot_mark(BOOT_DISPLAY);
 
 	int j = 0;
 	Line line_freq, line_roc;
 	char vga_info_buf[50];
+	thresholds t;
 	while(1) {
 
 		// print out thresholds
-		xSemaphoreTake(thresholds_sem, portMAX_DELAY);
-		sprintf(vga_info_buf, "Frequency threshold: %2.1f", freq_threshold);
+		thresholds_read(&t);
+		sprintf(vga_info_buf, "Frequency threshold: %2.1f", t.freq);
 		alt_up_char_buffer_string(char_buf, vga_info_buf, 4, 40);
-		sprintf(vga_info_buf, "ROC threshold: %2.1f ", roc_threshold);
+		sprintf(vga_info_buf, "ROC threshold: %2.1f ", t.roc);
 		alt_up_char_buffer_string(char_buf, vga_info_buf, 4, 42);
-		xSemaphoreGive(thresholds_sem);
 		// print system state
-		if (system_state == NORMAL_OPERATION) {
+		if (relay_fsm.state == NORMAL_OPERATION) {
 			alt_up_char_buffer_string(char_buf, "System state: Normal operation           ", 4, 44);
 		}
-		else if (system_state == LOAD_MGMT_MONITOR_UNSTABLE) {
+		else if (relay_fsm.state == LOAD_MGMT_MONITOR_UNSTABLE) {
 			alt_up_char_buffer_string(char_buf, "System state: Load mgmt, monitor unstable", 4, 44);
 		}
-		else if (system_state == LOAD_MGMT_MONITOR_STABLE) {
+		else if (relay_fsm.state == LOAD_MGMT_MONITOR_STABLE) {
 			alt_up_char_buffer_string(char_buf, "System state: Load mgmt, monitor stable  ", 4, 44);
 		}
-		else if (system_state == MAINTENANCE_MODE) {
+		else if (relay_fsm.state == MAINTENANCE_MODE) {
 			alt_up_char_buffer_string(char_buf, "System state: Maintenance mode           ", 4, 44);
 		}
 		if (system_stable == true) {
@@ -348,26 +646,34 @@ void VGA_Task(void *pvParameters){
 		// System active time
 		sprintf(vga_info_buf, "System uptime: %d m %d s    ", uptime/60, uptime%60);
 		alt_up_char_buffer_string(char_buf, vga_info_buf, 4, 58);
+		report_stats(uptime);
+
+		sprintf(vga_info_buf, "Time scale (Tab): %s", plot_scale_names[plot_scale]);
+		alt_up_char_buffer_string(char_buf, vga_info_buf, 4, 38);
 
 		//clear old graph to draw new graph
 		alt_up_pixel_buffer_dma_draw_box(pixel_buf, 101, 0, 639, 199, 0, 0);
 		alt_up_pixel_buffer_dma_draw_box(pixel_buf, 101, 201, 639, 299, 0, 0);
 		xSemaphoreTake(freq_roc_sem, portMAX_DELAY);
-		for(j=0;j<99;++j){ //i here points to the oldest data, j loops through all the data to be drawn on VGA
-			if (((int)(freq[(freq_idx+j)%100]) > MIN_FREQ) && ((int)(freq[(freq_idx+j+1)%100]) > MIN_FREQ)){
+		for(j=0;j<99;++j){ //j loops through all the data to be drawn on VGA, 0 is the oldest
+			double f1, r1, f2, r2;
+			if (plot_scale != 0) {
+				draw_range_bar(pixel_buf, plot_scale, j);
+			}
+			if (plot_point(plot_scale, j, &f1, &r1) && plot_point(plot_scale, j + 1, &f2, &r2) && ((int)f1 > MIN_FREQ) && ((int)f2 > MIN_FREQ)){
 				//Frequency plot
 				line_freq.x1 = FREQPLT_ORI_X + FREQPLT_GRID_SIZE_X * j;
-				line_freq.y1 = (int)(FREQPLT_ORI_Y - FREQPLT_FREQ_RES * (freq[(freq_idx+j)%100] - MIN_FREQ));
+				line_freq.y1 = (int)(FREQPLT_ORI_Y - FREQPLT_FREQ_RES * (f1 - MIN_FREQ));
 
 				line_freq.x2 = FREQPLT_ORI_X + FREQPLT_GRID_SIZE_X * (j + 1);
-				line_freq.y2 = (int)(FREQPLT_ORI_Y - FREQPLT_FREQ_RES * (freq[(freq_idx+j+1)%100] - MIN_FREQ));
+				line_freq.y2 = (int)(FREQPLT_ORI_Y - FREQPLT_FREQ_RES * (f2 - MIN_FREQ));
 
 				//Frequency RoC plot
 				line_roc.x1 = ROCPLT_ORI_X + ROCPLT_GRID_SIZE_X * j;
-				line_roc.y1 = (int)(ROCPLT_ORI_Y - ROCPLT_ROC_RES * roc[(freq_idx+j)%100]);
+				line_roc.y1 = (int)(ROCPLT_ORI_Y - ROCPLT_ROC_RES * r1);
 
 				line_roc.x2 = ROCPLT_ORI_X + ROCPLT_GRID_SIZE_X * (j + 1);
-				line_roc.y2 = (int)(ROCPLT_ORI_Y - ROCPLT_ROC_RES * roc[(freq_idx+j+1)%100]);
+				line_roc.y2 = (int)(ROCPLT_ORI_Y - ROCPLT_ROC_RES * r2);
 
 				//Draw
 				alt_up_pixel_buffer_dma_draw_line(pixel_buf, line_freq.x1, line_freq.y1, line_freq.x2, line_freq.y2, 0x3ff << 0, 0);
@@ -375,9 +681,12 @@ void VGA_Task(void *pvParameters){
 			}
 		}
 		xSemaphoreGive(freq_roc_sem);
-		// vTaskDelay(15);
+#if VGA_UPDATE_PERIOD
+		vTaskDelay(VGA_UPDATE_PERIOD);
+#endif
 	}
 }
+#endif
 
 
 
@@ -392,185 +701,213 @@ void VGA_Task(void *pvParameters){
  * goes back on.
  */
 
-// Manages operation of switches
-// i.e. in Normal Operation or Maintenance Mode, loads can be switched on/off freely
-// However under Load Management Mode, switches can only turn off loads
-void update_loads_from_switches() {
-	unsigned long switch_cfg = IORD_ALTERA_AVALON_PIO_DATA(SLIDE_SWITCH_BASE);
-	unsigned int i;
-	if ((system_state == NORMAL_OPERATION) || (system_state == MAINTENANCE_MODE)) { // can turn on or off loads w/ switches freely
-		// load state (red LEDs) reflects whatever the switch config is
-		for (i = 0; i < NO_OF_LOADS; i++) {
-			if (CHECK_BIT(switch_cfg, i)) { // if bit is set
-				load_states[i] = 1;
-				sw_load_states[i] = 1;
-			}
-			else {
-				load_states[i] = 0;
-				sw_load_states[i] = 0;
-			}
-		}
-	}
-	else if ((system_state == LOAD_MGMT_MONITOR_UNSTABLE) || (LOAD_MGMT_MONITOR_STABLE)) { // can only turn off loads
-		for (i = 0; i < NO_OF_LOADS; i++) {
-			if (!(CHECK_BIT(switch_cfg, i))) { // if bit is not set
-				load_states[i] = 0; // turn off the load
-				sw_load_states[i] = 0;
-			}
-		}
-	}
-}
-
-/* Load Management Task Helper Functions
+/* Load Management Task Helper Functions, the state machine itself is in load_fsm.c
  * update_leds_from_fsm: updates leds based on current state in FSM_task, different to in maintenance since green leds stuff (may refactor into one function later)
- * shed_load: shed a single load from the network, starting from lowest prio (lowest led no)
- * reconnect_load: reconnect a single load to network, starting from highest prio (highest led no)
- * check_if_all_loads_connected: used to go back into NORMAL_OPERATION state if all loads are connected back
- * reset_timer: resets the timer expiry flag and the actual timer handle
- * timer_expiry_callback: runs when timer expires, sets expiry flag to high
+ * reset_timer: restarts the 500ms deadline, its expiry wakes the FSM task straight away
  */
 
 void update_leds_from_fsm() {
 	unsigned long red_led = 0, green_led = 0, bit = 1; // for pio call, ending result of 0 is off and 1 is on
 	unsigned int i;
 
-	update_loads_from_switches();
-
 	for (i = 0; i < NO_OF_LOADS; i++) {
-		red_led |= (load_states[i] == true && sw_load_states[i] == true) ? bit : 0;
-		green_led |= (load_states[i] == false && sw_load_states[i] == true) ? bit : 0; // green leds turn on when relay switches off loads AND switch is high
+		red_led |= (relay_fsm.load_on[i] && relay_fsm.switch_on[i]) ? bit : 0;
+		green_led |= (!relay_fsm.load_on[i] && relay_fsm.switch_on[i]) ? bit : 0; // green leds turn on when relay switches off loads AND switch is high
 		bit = bit << 1; // shift left to do logic on next led
 	}
+#if HEADLESS
+	green_led |= system_stable == false ? 1 << 8 : 0; // LEDG8 stands in for the VGA stability readout
+#endif
 	IOWR_ALTERA_AVALON_PIO_DATA(RED_LEDS_BASE, red_led);
 	IOWR_ALTERA_AVALON_PIO_DATA(GREEN_LEDS_BASE, green_led);
 }
 
-void shed_load() {
-	unsigned int i;
-	for (i = 0; i < NO_OF_LOADS; i++) {
-		if (load_states[i] == true) {
-			load_states[i] = false;
-			break;
-		}
-	}
-	update_leds_from_fsm();
+void reset_timer() {
+	deadline_arm(TIMER_PERIOD_MS);
 }
 
-void reconnect_load() {
-	unsigned int i;
-	for (i = NO_OF_LOADS - 1; i >= 0; i--) {
-		if (load_states[i] == false && sw_load_states[i] == true) { // only turn back on the load if it is actually switched on
-			load_states[i] = true;
-			break;
-		}
-	}
-	update_leds_from_fsm();
-}
+// Load Management Task
 
-bool check_if_all_loads_connected() {
-	unsigned int i;
-	for (i = 0; i < NO_OF_LOADS; i++) {
-		if (load_states[i] == false && sw_load_states[i] == true) { // do not check if load is connected if it's not actually switched on
-			return false;
+void Load_Management_Task(void *pvParameters) {
+	// LCD bottom row, written here without blocking the FSM
+	static const char *lcd_state_names[] = {"Normal", "Shed, stable", "Shed, unstable", "Maintenance"};
+	state reported_state = relay_fsm.state;
+	unsigned int reported_deadline_late = 0;
+	unsigned int switches;
+	load_fsm_actions act;
+
+	lcd_line(1, lcd_state_names[relay_fsm.state]);
+	while(1) {
+		// report transitions here so ones made by the button ISR are caught too
+		if (relay_fsm.state != reported_state) {
+			telemetry_state(reported_state, relay_fsm.state);
+			lcd_line(1, lcd_state_names[relay_fsm.state]);
+			reported_state = relay_fsm.state;
+		}
+		switches = IORD_ALTERA_AVALON_PIO_DATA(SLIDE_SWITCH_BASE) & remote_load_mask; // a load the remote side turned off acts as switched off
+		load_fsm_step(&relay_fsm, system_stable, deadline_expired(), switches, &act);
+		if (act.shed >= 0) {
+			telemetry_load(TLM_LOAD_SHED, act.shed, xTaskGetTickCount() - time_before_shed);
+			shed_journal_event(SHED_JOURNAL_LOAD_SHED, act.shed, xTaskGetTickCount() - time_before_shed, shed_trigger_freq, shed_trigger_roc);
+		}
+		if (act.initial_shed) {
+			update_shed_stats(); // t1 here since load has been shed here
+		}
+		if (act.arm_deadline) {
+			reset_timer();
+		}
+		if (act.reconnected >= 0) {
+			telemetry_load(TLM_LOAD_RECONNECT, act.reconnected, 0);
+			shed_journal_event(SHED_JOURNAL_LOAD_RECONNECT, act.reconnected, 0, shed_trigger_freq, shed_trigger_roc);
+		}
+		update_leds_from_fsm();
+		if (deadline_worst_late() != reported_deadline_late) {
+			reported_deadline_late = deadline_worst_late();
+			LOG("fsm deadline worst case %u counts late\n", reported_deadline_late);
 		}
+		ulTaskNotifyTake(pdTRUE, 5); // blocked for up to 5ms so other low prio tasks can run, the deadline ISR wakes it early
 	}
-	return true;
-}
-
-void reset_timer() {
-	timer_expired_flag = false;
-	//10 ticks that fsm_task is held in blocked state to wait for successful send to timer command q. incr if more timers added to system
-	xTimerReset(fsm_timer, 10);
-}
-
-void timer_expiry_callback(xTimerHandle xTimer) {
-	timer_expired_flag = true;
 }
 
-// Load Management Task
 
-void Load_Management_Task(void *pvParameters) {
+// Command_Task
+// Answers one request from the remote side, see command.h
+void handle_command(const cmd_parser *p) {
+	unsigned char data[CMD_MAX_RESPONSE];
+	unsigned int len = 0, i, connected = 0, shed = 0;
+	int status = CMD_OK;
+	thresholds t;
+	double f, r;
 
-	while(1) {
-		switch(system_state)
-		{
-			case MAINTENANCE_MODE:
-				update_leds_from_fsm();
+	switch (p->type) {
+		case CMD_GET_STATUS:
+			if (p->len != 0) {
+				status = CMD_BAD_REQUEST;
 				break;
-			case NORMAL_OPERATION:
-				// check if things are still normal
-				if (system_stable != true) {
-					shed_load();
-					update_shed_stats(); // t1 here since load has been shed here 
-					reset_timer();
-					system_state = LOAD_MGMT_MONITOR_UNSTABLE;
-				}
-				else {
-					update_leds_from_fsm();
-					system_state = NORMAL_OPERATION;
-				}
+			}
+			thresholds_read(&t);
+			xSemaphoreTake(freq_roc_sem, portMAX_DELAY);
+			f = freq_channel_freq(&channels[0], FREQ_CHANNEL_SAMPLES - 1); // newest sample
+			r = freq_channel_roc(&channels[0], FREQ_CHANNEL_SAMPLES - 1);
+			xSemaphoreGive(freq_roc_sem);
+			for (i = 0; i < NO_OF_LOADS; i++) {
+				connected |= relay_fsm.load_on[i] ? 1 << i : 0;
+				shed |= (!relay_fsm.load_on[i] && relay_fsm.switch_on[i]) ? 1 << i : 0;
+			}
+			data[CMD_STATUS_STATE] = relay_fsm.state;
+			data[CMD_STATUS_STABLE] = system_stable;
+			data[CMD_STATUS_CONNECTED] = connected;
+			data[CMD_STATUS_SHED] = shed;
+			data[CMD_STATUS_REMOTE_MASK] = remote_load_mask;
+			cmd_put_f32(data + CMD_STATUS_FREQ, f);
+			cmd_put_f32(data + CMD_STATUS_ROC, r);
+			cmd_put_f32(data + CMD_STATUS_FREQ_THRESHOLD, t.freq);
+			cmd_put_f32(data + CMD_STATUS_ROC_THRESHOLD, t.roc);
+			xSemaphoreTake(shed_sem, portMAX_DELAY);
+			cmd_put_u16(data + CMD_STATUS_SHED_TIME, shed_time > 0xffff ? 0xffff : shed_time);
+			cmd_put_u16(data + CMD_STATUS_MIN_SHED, min_shed_time > 0xffff ? 0xffff : min_shed_time);
+			cmd_put_u16(data + CMD_STATUS_MAX_SHED, max_shed_time > 0xffff ? 0xffff : max_shed_time);
+			cmd_put_f32(data + CMD_STATUS_AVG_SHED, avg_shed_time);
+			cmd_put_u32(data + CMD_STATUS_SHED_COUNT, shed_count);
+			xSemaphoreGive(shed_sem);
+			len = CMD_STATUS_SIZE;
+			break;
+		case CMD_SET_THRESHOLDS:
+			if (p->len != 8) {
+				status = CMD_BAD_REQUEST;
 				break;
-			case LOAD_MGMT_MONITOR_UNSTABLE:
-				if (timer_expired_flag == true) {
-					reset_timer();
-					shed_load();
-				}
-				else if (system_stable == false) {
-					system_state = LOAD_MGMT_MONITOR_UNSTABLE;
-				}
-				else {
-					reset_timer(); // check if it is a fluke or not, move to monitor stable state
-					system_state = LOAD_MGMT_MONITOR_STABLE;
-				}
+			}
+			f = cmd_get_f32(p->payload);
+			r = cmd_get_f32(p->payload + 4);
+			if (!(f > MIN_FREQ && f < 60.0 && r > 0.0 && r < 100.0)) { // also turns away NaN
+				status = CMD_BAD_VALUE;
+				break;
+			}
+			thresholds_publish(f, r);
+			thresholds_read(&t);
+			lcd_show_thresholds(&t);
+			break;
+		case CMD_SET_LOAD_MASK:
+			if (p->len != 1) {
+				status = CMD_BAD_REQUEST;
 				break;
+			}
+			remote_load_mask = p->payload[0];
+			break;
+		default:
+			status = CMD_BAD_REQUEST;
+			break;
+	}
+	telemetry_response(p->type, p->seq, status, data, len);
+}
 
-			case LOAD_MGMT_MONITOR_STABLE:
-				if (timer_expired_flag == true) {
-					reset_timer();
-					if (check_if_all_loads_connected()) {
-						system_state = NORMAL_OPERATION; // everything back to normal
-					}
-					else {
-						reconnect_load();
-						system_state = LOAD_MGMT_MONITOR_STABLE;
-					}
-				}
-				else if (system_stable == false) {
-					reset_timer();
-					system_state = LOAD_MGMT_MONITOR_UNSTABLE;
+// Sleeps until the UART ISR has received bytes, then answers every complete request among them
+void Command_Task(void *pvParameters) {
+	unsigned char buf[32];
+	unsigned int n, i;
+	cmd_parser parser;
+
+	cmd_parser_init(&parser);
+	telemetry_rx_attach(xTaskGetCurrentTaskHandle());
+	while (1) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		while ((n = telemetry_receive(buf, sizeof(buf))) > 0) {
+			for (i = 0; i < n; i++) {
+				if (cmd_parser_feed(&parser, buf[i])) {
+					handle_command(&parser);
 				}
-				else {
-					system_state = LOAD_MGMT_MONITOR_STABLE;
-				}
-				break;
+			}
 		}
-		vTaskDelay(5); // place into blocked state for 5ms so other low prio tasks can run
 	}
 }
 
+// Tasks frequency protection needs, the analyser ISR feeds them
+int initProtectionTasks(void) {
+	xTaskCreate(ROC_Calculation_Task, "Calculation_Task", configMINIMAL_STACK_SIZE, NULL, CALCULATION_TASK_PRIORITY, NULL);
+#if SIM_CHANNELS
+	xTaskCreate(Sim_Analyser_Task, "Sim_Analyser_Task", configMINIMAL_STACK_SIZE, NULL, SIM_ANALYSER_TASK_PRIORITY, NULL);
+#endif
+	TaskHandle_t fsm_task;
+	xTaskCreate(Load_Management_Task, "FSM_Task", configMINIMAL_STACK_SIZE, NULL, FSM_TASK_PRIORITY, &fsm_task);
+	deadline_init(fsm_task);
+	return 0;
+}
 
 int initCreateTasks(void) {
+#if HEADLESS
+	xTaskCreate(Status_Task, "Status_Task", configMINIMAL_STACK_SIZE, NULL, STATUS_TASK_PRIORITY, NULL);
+#else
 	xTaskCreate(VGA_Task, "VGA_Task", configMINIMAL_STACK_SIZE, NULL, VGA_TASK_PRIORITY, NULL);
-	xTaskCreate(ROC_Calculation_Task, "Calculation_Task", configMINIMAL_STACK_SIZE, NULL, CALCULATION_TASK_PRIORITY, NULL);
-	xTaskCreate(Load_Management_Task, "FSM_Task", configMINIMAL_STACK_SIZE, NULL, FSM_TASK_PRIORITY, NULL);
+#endif
 	xTaskCreate(Keyboard_Update_Task, "Keyboard_Update_Task", configMINIMAL_STACK_SIZE, NULL, KEYBOARD_UPDATE_TASK_PRIORITY, NULL);
+	xTaskCreate(Command_Task, "Command_Task", configMINIMAL_STACK_SIZE, NULL, COMMAND_TASK_PRIORITY, NULL);
+	xTaskCreate(Log_Drain_Task, "Log_Drain_Task", configMINIMAL_STACK_SIZE, NULL, LOG_TASK_PRIORITY, NULL);
+	xTaskCreate(Journal_Task, "Journal_Task", configMINIMAL_STACK_SIZE, NULL, JOURNAL_TASK_PRIORITY, NULL);
+#if IRQ_STORM_TEST
+	xTaskCreate(Irq_Storm_Task, "Irq_Storm_Task", configMINIMAL_STACK_SIZE, NULL, IRQ_STORM_TASK_PRIORITY, NULL);
+#endif
+#if PROFILER
+	xTaskCreate(Profile_Task, "Profile_Task", configMINIMAL_STACK_SIZE, NULL, PROFILE_TASK_PRIORITY, NULL);
+#endif
 	return 0;
 }
 
 int initOSDataStructs(void)
 {
-	HW_dataQ = xQueueCreate(HW_DATA_QUEUE_SIZE, sizeof(double));
+	HW_dataQ = xQueueCreate(HW_DATA_QUEUE_SIZE, sizeof(channel_sample));
 	kb_dataQ = xQueueCreate(KB_DATA_QUEUE_SIZE, sizeof(unsigned char));
 	freq_roc_sem = xSemaphoreCreateMutex();
-	thresholds_sem = xSemaphoreCreateMutex();
+	thresholds_init(FREQ_THRESHOLD, ROC_THRESHOLD);
 	shed_sem = xSemaphoreCreateMutex();
-	fsm_timer = xTimerCreate("fsm_timer", TIMER_PERIOD, pdFALSE, (void*)0, timer_expiry_callback); // create 500ms timer with autoreload, callback sets timer expiry flag high
-
-	xTimerStart(fsm_timer, 0);
+#if !HEADLESS
+	history_init(&freq_history);
+#endif
 	unsigned int i;
-	for (i = 0; i < NO_OF_LOADS; i++) {
-		load_states[i] = true; // turn all LEDs on initially because all loads are on
+	for (i = 0; i < FREQ_CHANNELS; i++) {
+		freq_channel_init(&channels[i], ROC_METHOD, ROC_WINDOW, ROC_IIR_ALPHA);
 	}
+	lcd_init();
+	load_fsm_init(&relay_fsm); // turn all LEDs on initially because all loads are on
 
 	return 0;
 }
@@ -578,32 +915,77 @@ int initOSDataStructs(void)
 // Initialisations for keyboard/ISR
 int ps2_init(void) {
 	alt_up_ps2_dev * ps2_device = alt_up_ps2_open_dev(PS2_NAME);
+	alt_irq_context ctx;
 
 	if(ps2_device == NULL){
-		printf("can't find PS/2 device\n");
+		LOG("can't find PS/2 device\n");
 		return 1;
 	}
 
 	alt_up_ps2_clear_fifo (ps2_device) ;
 
+	// the port's alt_irq_register leaves interrupts off, put them back as they were: on when
+	// Init_Task runs this, still off before the scheduler starts
+	ctx = alt_irq_disable_all();
 	alt_irq_register(PS2_IRQ, ps2_device, ps2_isr);
+	alt_irq_enable_all(ctx);
 	// register the PS/2 interrupt
 	IOWR_8DIRECT(PS2_BASE,4,1);
+	return 0;
 }
 
 void button_init(void) {
+	alt_irq_context ctx;
+
 	IOWR_ALTERA_AVALON_PIO_IRQ_MASK(PUSH_BUTTON_BASE, 0x7); // enable interrupt for 1 button
 	IOWR_ALTERA_AVALON_PIO_EDGE_CAP(PUSH_BUTTON_BASE, 0x7); //write 1 to edge capture to clear pending interrupts
+	ctx = alt_irq_disable_all(); // as in ps2_init
 	alt_irq_register(PUSH_BUTTON_IRQ, 0, button_irq);  //register ISR for push button interrupt request
+	alt_irq_enable_all(ctx);
+}
+
+// Brings up everything else once protection is running, with BOOT_PROTECTION_FIRST set
+void Init_Task(void *pvParameters) {
+	unsigned int waited;
+
+	for (waited = 0; !boot_reached(BOOT_PROTECTION) && waited < BOOT_PROTECTION_WAIT_MS; waited += portTICK_PERIOD_MS) {
+		vTaskDelay(1);
+	}
+	ps2_init();
+	button_init();
+	boot_mark(BOOT_KEYBOARD);
+	shed_journal_init();
+	xSemaphoreTake(shed_sem, portMAX_DELAY);
+	restore_shed_stats();
+	xSemaphoreGive(shed_sem);
+	initCreateTasks();
+	vTaskDelete(NULL);
 }
 
 int main(int argc, char* argv[], char* envp[])
 {
-	alt_irq_register(FREQUENCY_ANALYSER_IRQ, 0, freq_relay);
+	unsigned int i;
+
+	boot_mark(BOOT_MAIN);
+	alt_irq_set_priority(irq_priority, irq_priority_count);
+	telemetry_init();
+	jtag_uart_init(); // takes the JTAG UART from the HAL driver, for Log_Drain_Task
+	initOSDataStructs(); // before the analyser ISR, which sends to HW_dataQ
+	for (i = 0; i < REAL_CHANNELS; i++) {
+		alt_irq_register(analysers[i].irq, (void *)&analysers[i], freq_relay);
+	}
+	initProtectionTasks();
+#if BOOT_PROTECTION_FIRST
+	xTaskCreate(Init_Task, "Init_Task", configMINIMAL_STACK_SIZE, NULL, INIT_TASK_PRIORITY, NULL);
+#else
 	ps2_init();
 	button_init();
-	initOSDataStructs();
+	boot_mark(BOOT_KEYBOARD);
+	shed_journal_init();
+	restore_shed_stats();
 	initCreateTasks();
+#endif
+	boot_mark(BOOT_SCHEDULER);
 	vTaskStartScheduler();
 	for (;;);
 
@@ -0,0 +1,36 @@
+#include <math.h>
+#include <string.h>
+
+#include "freq_channel.h"
+
+void freq_channel_init(freq_channel *c, int method, unsigned int window, double alpha)
+{
+	memset(c, 0, sizeof(*c));
+	roc_init(&c->roc_est, method, window, alpha);
+	c->stable = 1;
+}
+
+int freq_channel_update(freq_channel *c, double freq, double freq_threshold, double roc_threshold)
+{
+	double roc = roc_update(&c->roc_est, freq);
+
+	c->freq[c->idx] = freq;
+	c->roc[c->idx] = roc;
+	c->idx = (c->idx + 1) % FREQ_CHANNEL_SAMPLES;
+	c->stable = !((freq < freq_threshold) || (fabs(roc) >= roc_threshold));
+	if (!c->stable) {
+		c->trigger_freq = freq;
+		c->trigger_roc = roc;
+	}
+	return c->stable;
+}
+
+double freq_channel_freq(const freq_channel *c, unsigned int j)
+{
+	return c->freq[(c->idx + j) % FREQ_CHANNEL_SAMPLES];
+}
+
+double freq_channel_roc(const freq_channel *c, unsigned int j)
+{
+	return c->roc[(c->idx + j) % FREQ_CHANNEL_SAMPLES];
+}
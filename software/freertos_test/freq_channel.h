@@ -0,0 +1,42 @@
+#ifndef FREQ_CHANNEL_H
+#define FREQ_CHANNEL_H
+
+/*
+ * Frequency pipeline for one analyser (one feeder): the raw freq/roc sample ring, the RoC
+ * estimator and the stability decision, everything ROC_Calculation_Task used to keep in globals.
+ *
+ * The relay runs one freq_channel per analyser, real or simulated, from a single engine task: the
+ * analyser ISRs tag each sample with its channel and queue it, and the task updates that channel
+ * and combines the stability of all of them. Channels share nothing, so the per-sample cost is the
+ * same whatever the number of channels, and a channel costs its state and no task stack.
+ *
+ * Pure C with no RTOS calls, callers provide the locking (freq_roc_sem in freertos_test.c).
+ * software/host_tools/channel_bench.c measures how many channels a CPU budget sustains.
+ */
+
+#include "roc_estimator.h"
+
+#define FREQ_CHANNEL_SAMPLES 100 // raw samples kept per channel, one per VGA plot point
+
+typedef struct {
+	double freq[FREQ_CHANNEL_SAMPLES];
+	double roc[FREQ_CHANNEL_SAMPLES];
+	unsigned int idx; // slot the next sample is written to, the oldest
+	roc_estimator roc_est;
+	int stable; // whether the last sample was within the thresholds, 1 before the first
+	double trigger_freq; // freq and roc of the last sample that was not
+	double trigger_roc;
+} freq_channel;
+
+// RoC estimator settings as for roc_init()
+void freq_channel_init(freq_channel *c, int method, unsigned int window, double alpha);
+
+// Takes the next frequency sample in Hz and returns whether it is stable: at or above freq_threshold
+// and with a RoC magnitude below roc_threshold
+int freq_channel_update(freq_channel *c, double freq, double freq_threshold, double roc_threshold);
+
+// Sample j of the ring, 0 the oldest and FREQ_CHANNEL_SAMPLES - 1 the newest
+double freq_channel_freq(const freq_channel *c, unsigned int j);
+double freq_channel_roc(const freq_channel *c, unsigned int j);
+
+#endif /* FREQ_CHANNEL_H */
@@ -0,0 +1,101 @@
+#include <string.h>
+
+#include "history.h"
+
+static const unsigned int tier_period_ms[HISTORY_TIERS] = {1000, 60 * 1000, 60 * 60 * 1000};
+
+static void bucket_clear(history_bucket *b)
+{
+	memset(b, 0, sizeof(*b));
+}
+
+static void stat_add(history_stat *s, unsigned int count, double value)
+{
+	if (count == 0 || value < s->min) {
+		s->min = value;
+	}
+	if (count == 0 || value > s->max) {
+		s->max = value;
+	}
+	s->sum += value;
+}
+
+static void tier_push(history_tier *t, const history_bucket *b)
+{
+	t->ring[t->head] = *b;
+	t->head = (t->head + 1) % HISTORY_POINTS;
+	if (t->closed < HISTORY_POINTS) {
+		t->closed++;
+	}
+}
+
+// Closes the open bucket, and the empty ones after it, once now_ms is past its period
+static void tier_advance(history_tier *t, unsigned int now_ms)
+{
+	unsigned int elapsed = now_ms - t->open_start_ms;
+	unsigned int periods, empty;
+	history_bucket none;
+
+	if (elapsed < t->period_ms) {
+		return;
+	}
+	periods = elapsed / t->period_ms;
+	tier_push(t, &t->open);
+	bucket_clear(&none);
+	// a gap longer than the whole tier only needs HISTORY_POINTS empty buckets
+	for (empty = periods - 1 < HISTORY_POINTS ? periods - 1 : HISTORY_POINTS; empty > 0; empty--) {
+		tier_push(t, &none);
+	}
+	bucket_clear(&t->open);
+	t->open_start_ms += periods * t->period_ms;
+}
+
+void history_init(history *h)
+{
+	unsigned int i;
+	memset(h, 0, sizeof(*h));
+	for (i = 0; i < HISTORY_TIERS; i++) {
+		h->tier[i].period_ms = tier_period_ms[i];
+	}
+}
+
+void history_add(history *h, unsigned int now_ms, double freq, double roc)
+{
+	unsigned int i;
+
+	for (i = 0; i < HISTORY_TIERS; i++) {
+		history_tier *t = &h->tier[i];
+		if (!h->started) {
+			t->open_start_ms = now_ms;
+		}
+		tier_advance(t, now_ms);
+		stat_add(&t->open.freq, t->open.count, freq);
+		stat_add(&t->open.roc, t->open.count, roc);
+		t->open.count++;
+	}
+	h->started = 1;
+}
+
+const history_bucket *history_point(const history *h, history_tier_id tier, unsigned int i)
+{
+	const history_tier *t = &h->tier[tier];
+	const history_bucket *b;
+	unsigned int age = HISTORY_POINTS - 1 - i; // 0 is the open bucket
+
+	if (i >= HISTORY_POINTS || tier >= HISTORY_TIERS) {
+		return NULL;
+	}
+	if (age == 0) {
+		b = &t->open;
+	} else if (age <= t->closed) {
+		b = &t->ring[(t->head + HISTORY_POINTS - age) % HISTORY_POINTS];
+	} else {
+		return NULL;
+	}
+	return b->count ? b : NULL;
+}
+
+double history_mean(const history_stat *stat, const history_bucket *bucket)
+{
+	return stat->sum / bucket->count;
+}
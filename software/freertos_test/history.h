@@ -0,0 +1,56 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/*
+ * Multi-resolution frequency and RoC history.
+ *
+ * The raw tier is the sample ring of the displayed channel (freq_channel.h, the last 100 samples,
+ * about two seconds). On top of it, history_add() keeps per-second, per-minute and per-hour buckets of
+ * min/max/mean/count for both values, HISTORY_POINTS buckets per tier, so the VGA plot can show
+ * the last 100 s, 100 min or 100 h without going back to the samples. Each sample updates the
+ * open bucket of every tier: O(1) per sample, and all memory is in the history struct.
+ *
+ * Pure C with no RTOS calls, callers provide the locking (freq_roc_sem in freertos_test.c).
+ */
+
+#define HISTORY_POINTS 100 // buckets kept per tier, one per plot point
+
+typedef enum {HISTORY_SECONDS, HISTORY_MINUTES, HISTORY_HOURS, HISTORY_TIERS} history_tier_id;
+
+typedef struct {
+	float min;
+	float max;
+	double sum; // double, an hour at 50 samples/s is 180000 samples
+} history_stat;
+
+typedef struct {
+	history_stat freq;
+	history_stat roc;
+	unsigned int count; // 0 for a period with no samples
+} history_bucket;
+
+typedef struct {
+	history_bucket ring[HISTORY_POINTS]; // closed buckets, oldest overwritten first
+	history_bucket open; // bucket currently being filled
+	unsigned int head; // next ring slot to be written
+	unsigned int closed; // number of closed buckets, up to HISTORY_POINTS
+	unsigned int period_ms;
+	unsigned int open_start_ms; // start time of the open bucket
+} history_tier;
+
+typedef struct {
+	history_tier tier[HISTORY_TIERS];
+	int started;
+} history;
+
+void history_init(history *h);
+
+// Adds one sample taken at now_ms (any free running millisecond count, wrap safe)
+void history_add(history *h, unsigned int now_ms, double freq, double roc);
+
+// Bucket i of a tier, 0 the oldest and HISTORY_POINTS - 1 the open one. NULL if it holds no samples
+const history_bucket *history_point(const history *h, history_tier_id tier, unsigned int i);
+
+double history_mean(const history_stat *stat, const history_bucket *bucket);
+
+#endif /* HISTORY_H */
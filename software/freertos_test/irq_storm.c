@@ -0,0 +1,77 @@
+#include "system.h"
+#include "alt_types.h"
+#include "sys/alt_irq.h"
+#include "altera_avalon_timer_regs.h"
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "irq_storm.h"
+#include "log.h"
+#include "deadline.h"
+
+#if IRQ_STORM_TEST && DEADLINE_HW_TIMER
+#error "IRQ_STORM_TEST drives TIMER1US, set DEADLINE_HW_TIMER to 0 in deadline.h"
+#endif
+
+extern const alt_u8 irq_priority[];
+extern const unsigned int irq_priority_count;
+
+#define STORM_WORK_COUNTS ((unsigned int)(IRQ_STORM_ISR_WORK_US * (portTIMESTAMP_HZ / 1000000)))
+
+// Stands in for a slow, low priority driver ISR
+static void storm_isr(void* context, alt_u32 id)
+{
+	unsigned int start = ulPortGetTimestamp();
+	IOWR_ALTERA_AVALON_TIMER_STATUS(TIMER1US_BASE, 0);
+	while (ulPortGetTimestamp() - start < STORM_WORK_COUNTS);
+}
+
+static void storm_start(void)
+{
+	unsigned int period = IRQ_STORM_PERIOD_US * (TIMER1US_FREQ / 1000000) - 1;
+	alt_irq_context ctx;
+
+	IOWR_ALTERA_AVALON_TIMER_CONTROL(TIMER1US_BASE, ALTERA_AVALON_TIMER_CONTROL_STOP_MSK);
+	IOWR_ALTERA_AVALON_TIMER_PERIODL(TIMER1US_BASE, period & 0xFFFF);
+	IOWR_ALTERA_AVALON_TIMER_PERIODH(TIMER1US_BASE, period >> 16);
+	IOWR_ALTERA_AVALON_TIMER_STATUS(TIMER1US_BASE, 0);
+	// called from Irq_Storm_Task, where the port's alt_irq_register would leave interrupts off
+	ctx = alt_irq_disable_all();
+	alt_irq_register(TIMER1US_IRQ, NULL, storm_isr);
+	alt_irq_enable_all(ctx);
+	IOWR_ALTERA_AVALON_TIMER_CONTROL(TIMER1US_BASE, ALTERA_AVALON_TIMER_CONTROL_CONT_MSK | ALTERA_AVALON_TIMER_CONTROL_START_MSK | ALTERA_AVALON_TIMER_CONTROL_ITO_MSK);
+}
+
+static alt_u32 storm_timestamp(void)
+{
+	return ulPortGetTimestamp();
+}
+
+static void reset_dispatch_stats(void)
+{
+	unsigned int i;
+	alt_irq_context ctx = alt_irq_disable_all();
+	for (i = 0; i < ALT_NIRQ; i++) {
+		alt_irq_dispatch_max[i] = 0;
+	}
+	alt_irq_enable_all(ctx);
+}
+
+void Irq_Storm_Task(void *pvParameters)
+{
+	int prioritised = 0;
+
+	alt_irq_dispatch_timestamp = storm_timestamp;
+	storm_start();
+
+	while(1) {
+		alt_irq_set_priority(irq_priority, prioritised ? irq_priority_count : 0);
+		reset_dispatch_stats();
+		vTaskDelay(IRQ_STORM_PHASE_MS / portTICK_PERIOD_MS);
+		LOG("irq storm, %s order: analyser waited up to %u, tick up to %u (counts of 10ns)\n",
+			prioritised ? "priority" : "numeric",
+			alt_irq_dispatch_max[FREQUENCY_ANALYSER_IRQ], alt_irq_dispatch_max[TIMER1MS_IRQ]);
+		prioritised = !prioritised;
+	}
+}
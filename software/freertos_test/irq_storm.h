@@ -0,0 +1,24 @@
+#ifndef IRQ_STORM_H
+#define IRQ_STORM_H
+
+/*
+ * Synthetic interrupt storm for measuring worst-case IRQ dispatch latency.
+ *
+ * When IRQ_STORM_TEST is 1, Irq_Storm_Task drives TIMER1US at a high rate with a handler that
+ * burns IRQ_STORM_ISR_WORK_US per interrupt, so the analyser and tick interrupts regularly
+ * arrive while other IRQs are pending. Every IRQ_STORM_PHASE_MS it alternates between the
+ * default numeric dispatch order and the application priority order, and logs the worst wait
+ * seen by the analyser and tick IRQs (alt_irq_dispatch_max) in each phase.
+ *
+ * TIMER1US is not available to anything else while the storm test is built in, so the FSM
+ * deadline has to fall back to its software timer (DEADLINE_HW_TIMER 0 in deadline.h).
+ */
+
+#define IRQ_STORM_TEST 0
+#define IRQ_STORM_PERIOD_US 25
+#define IRQ_STORM_ISR_WORK_US 10
+#define IRQ_STORM_PHASE_MS 5000
+
+void Irq_Storm_Task(void *pvParameters);
+
+#endif /* IRQ_STORM_H */
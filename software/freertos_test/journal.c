@@ -0,0 +1,216 @@
+#include <string.h>
+
+#include "journal.h"
+
+#define JOURNAL_MAGIC 0x4c4e4a53 // "SJNL"
+
+typedef struct {
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t erases;
+	uint32_t check; // ~(seq ^ erases), a header torn by a power cut fails it
+} journal_header;
+
+// CRC-16/CCITT, bitwise: 14 bytes per record is not worth a table
+static uint16_t crc16(const uint8_t *p, unsigned int len)
+{
+	uint16_t crc = 0xffff;
+	unsigned int i;
+
+	while (len--) {
+		crc ^= (uint16_t)(*p++) << 8;
+		for (i = 0; i < 8; i++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+static unsigned int slot_offset(const journal *j, unsigned int sector, unsigned int slot)
+{
+	return sector * j->flash->sector_size + slot * JOURNAL_SLOT_SIZE;
+}
+
+static int read_slot(const journal *j, unsigned int sector, unsigned int slot, uint8_t *dst)
+{
+	return j->flash->read(j->flash->ctx, slot_offset(j, sector, slot), dst, JOURNAL_SLOT_SIZE);
+}
+
+static int slot_erased(const uint8_t *slot)
+{
+	unsigned int i;
+	for (i = 0; i < JOURNAL_SLOT_SIZE; i++) {
+		if (slot[i] != 0xff) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int record_valid(const uint8_t *slot)
+{
+	uint16_t crc = crc16(slot, JOURNAL_DATA_SIZE);
+	return !slot_erased(slot) && slot[JOURNAL_DATA_SIZE] == (crc & 0xff) && slot[JOURNAL_DATA_SIZE + 1] == (crc >> 8);
+}
+
+// Non-zero if the sector has a valid header, copied to h
+static int read_header(const journal *j, unsigned int sector, journal_header *h)
+{
+	if (j->flash->read(j->flash->ctx, slot_offset(j, sector, 0), h, sizeof(*h)) != 0) {
+		return 0;
+	}
+	return h->magic == JOURNAL_MAGIC && h->check == ~(h->seq ^ h->erases);
+}
+
+// Erases the sector after the head and starts filling it
+static int rotate(journal *j)
+{
+	unsigned int next = (j->head + 1) % j->flash->sectors;
+	journal_header h;
+	uint32_t erases = 1;
+
+	// a sector that lost its header to a power cut restarts its count
+	if (read_header(j, next, &h)) {
+		erases = h.erases + 1;
+	}
+	j->head = next;
+	j->seq++;
+	j->erases = erases;
+	j->next_slot = j->slots; // unusable until the header is in
+
+	if (j->flash->erase(j->flash->ctx, slot_offset(j, next, 0)) != 0) {
+		return 1;
+	}
+	h.magic = JOURNAL_MAGIC;
+	h.seq = j->seq;
+	h.erases = erases;
+	h.check = ~(h.seq ^ h.erases);
+	if (j->flash->program(j->flash->ctx, slot_offset(j, next, 0), &h, sizeof(h)) != 0) {
+		return 1;
+	}
+	j->next_slot = 1;
+	return 0;
+}
+
+int journal_open(journal *j, const journal_flash *flash)
+{
+	unsigned int i, lo, hi;
+	uint8_t slot[JOURNAL_SLOT_SIZE];
+	journal_header h;
+	int found = 0;
+
+	memset(j, 0, sizeof(*j));
+	j->flash = flash;
+	if (flash->sectors < 2 || flash->sector_size % JOURNAL_SLOT_SIZE != 0 || flash->sector_size < 2 * JOURNAL_SLOT_SIZE) {
+		return 1;
+	}
+	j->slots = flash->sector_size / JOURNAL_SLOT_SIZE;
+
+	// newest sector, sequence numbers compared wrap safe
+	for (i = 0; i < flash->sectors; i++) {
+		if (read_header(j, i, &h) && (!found || (int32_t)(h.seq - j->seq) > 0)) {
+			j->head = i;
+			j->seq = h.seq;
+			j->erases = h.erases;
+			found = 1;
+		}
+	}
+	if (!found) {
+		// empty or foreign flash: the first flush rotates into sector 0
+		j->head = flash->sectors - 1;
+		j->next_slot = j->slots;
+		return 0;
+	}
+
+	// first erased slot of the head sector, the written slots are contiguous from slot 1
+	lo = 1;
+	hi = j->slots;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (read_slot(j, j->head, mid, slot) == 0 && slot_erased(slot)) {
+			hi = mid;
+		}
+		else {
+			lo = mid + 1;
+		}
+	}
+	j->next_slot = lo;
+	return 0;
+}
+
+int journal_flush(journal *j)
+{
+	unsigned int done = 0, n;
+	int status = 0;
+
+	while (done < j->batched) {
+		if (j->next_slot == j->slots && rotate(j) != 0) {
+			// the batch is dropped rather than retried against a failing sector
+			j->lost += j->batched - done;
+			status = 1;
+			break;
+		}
+		n = j->slots - j->next_slot;
+		if (n > j->batched - done) {
+			n = j->batched - done;
+		}
+		if (j->flash->program(j->flash->ctx, slot_offset(j, j->head, j->next_slot), j->batch[done], n * JOURNAL_SLOT_SIZE) != 0) {
+			j->lost += n;
+			status = 1;
+		}
+		// slots are used up even by a failed program, they may be partly written
+		j->next_slot += n;
+		done += n;
+	}
+	j->batched = 0;
+	return status;
+}
+
+int journal_append(journal *j, const void *data)
+{
+	uint8_t *slot = j->batch[j->batched];
+	uint16_t crc;
+
+	memcpy(slot, data, JOURNAL_DATA_SIZE);
+	crc = crc16(slot, JOURNAL_DATA_SIZE);
+	slot[JOURNAL_DATA_SIZE] = crc & 0xff;
+	slot[JOURNAL_DATA_SIZE + 1] = crc >> 8;
+	if (++j->batched == JOURNAL_BATCH) {
+		return journal_flush(j);
+	}
+	return 0;
+}
+
+unsigned int journal_walk(const journal *j, int (*fn)(void *ctx, const void *data), void *ctx)
+{
+	unsigned int visited = 0, sector = j->head, top = j->next_slot, n, slot_no;
+	uint32_t seq = j->seq;
+	uint8_t slot[JOURNAL_SLOT_SIZE];
+	journal_header h;
+
+	for (n = j->batched; n > 0; n--) {
+		visited++;
+		if (fn(ctx, j->batch[n - 1])) {
+			return visited;
+		}
+	}
+	// back through the ring while the sequence numbers follow on
+	for (n = 0; n < j->flash->sectors; n++) {
+		if (!read_header(j, sector, &h) || h.seq != seq) {
+			break;
+		}
+		for (slot_no = top; slot_no > 1; slot_no--) {
+			if (read_slot(j, sector, slot_no - 1, slot) != 0 || !record_valid(slot)) {
+				continue;
+			}
+			visited++;
+			if (fn(ctx, slot)) {
+				return visited;
+			}
+		}
+		sector = (sector + j->flash->sectors - 1) % j->flash->sectors;
+		seq--;
+		top = j->slots;
+	}
+	return visited;
+}
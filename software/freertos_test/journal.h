@@ -0,0 +1,69 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/*
+ * Append-only record journal for NOR flash.
+ *
+ * The journal owns a run of equal sized erase sectors and fills them in turn as a ring. Flash is
+ * divided into 16 byte slots: the first slot of a sector is its header (magic, sequence number,
+ * erase count), every other slot holds one record of JOURNAL_DATA_SIZE bytes and its CRC-16.
+ * Slots are only ever programmed in order, so the written part of a sector is contiguous.
+ *
+ *  - Batching: journal_append() only copies the record into RAM. Records are programmed
+ *    JOURNAL_BATCH at a time, or earlier by journal_flush(), as one contiguous write. A flush
+ *    never reprograms a slot, so a partial batch costs no more flash than a full one.
+ *  - Erases: a sector is erased once per trip round the ring, just before it is reused, which
+ *    drops the oldest sector of records. Every sector sees the same number of erases (the
+ *    count is kept in its header), and an erase is spread over a whole sector of records.
+ *  - Recovery: journal_open() reads the sector headers to find the newest sector and binary
+ *    searches it for the first erased slot: sectors + log2(slots) reads, not a scan. A slot
+ *    torn by a power cut reads as written, and its bad CRC hides it from journal_walk().
+ *
+ * The flash is reached only through journal_flash, so the journal runs unchanged on a RAM
+ * stand-in (software/host_tools/journal_bench.c). Pure C with no RTOS calls, the caller
+ * serialises access and keeps the slow program and erase calls out of time critical tasks.
+ */
+
+#include <stdint.h>
+
+#define JOURNAL_SLOT_SIZE 16
+#define JOURNAL_DATA_SIZE 14 // record bytes, the rest of the slot is the CRC
+#define JOURNAL_BATCH 16 // records held in RAM before they are programmed
+
+typedef struct {
+	// All return 0 on success. Offsets are from the start of the journal's flash
+	int (*read)(void *ctx, unsigned int offset, void *dst, unsigned int len);
+	int (*program)(void *ctx, unsigned int offset, const void *src, unsigned int len); // only into erased bytes
+	int (*erase)(void *ctx, unsigned int offset); // the whole sector starting at offset
+	void *ctx;
+	unsigned int sector_size; // a multiple of JOURNAL_SLOT_SIZE
+	unsigned int sectors; // at least 2
+} journal_flash;
+
+typedef struct {
+	const journal_flash *flash;
+	unsigned int slots; // slots per sector, including the header
+	unsigned int head; // sector being filled
+	unsigned int next_slot; // first erased slot in it, slots once it is full
+	uint32_t seq; // sequence number of the head sector, 0 before the first is written
+	uint32_t erases; // erase count of the head sector
+	uint8_t batch[JOURNAL_BATCH][JOURNAL_SLOT_SIZE]; // records not yet programmed, CRC included
+	unsigned int batched;
+	unsigned int lost; // records dropped by failed program or erase calls
+} journal;
+
+// Finds the end of the journal already in flash. Returns non-zero if the flash geometry is unusable
+int journal_open(journal *j, const journal_flash *flash);
+
+// Adds a record of JOURNAL_DATA_SIZE bytes, programming the batch once it is full. Returns
+// non-zero if a program or erase failed, the records involved are counted in lost
+int journal_append(journal *j, const void *data);
+
+// Programs the records held in RAM
+int journal_flush(journal *j);
+
+// Calls fn on each record, newest first and including the ones still in RAM, until fn returns
+// non-zero or the records run out. Returns the number of records passed to fn
+unsigned int journal_walk(const journal *j, int (*fn)(void *ctx, const void *data), void *ctx);
+
+#endif /* JOURNAL_H */
@@ -0,0 +1,112 @@
+#include "system.h"
+#include "alt_types.h"
+#include "sys/alt_irq.h"
+#include "altera_avalon_jtag_uart_regs.h"
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+#include "FreeRTOS/semphr.h"
+
+#include "jtag_uart.h"
+
+static SemaphoreHandle_t write_lock; // held for the whole of a write
+static SemaphoreHandle_t tx_done; // given by the ISR once the last fragment is in the FIFO
+
+// The write in progress, owned by the writer until it enables the write interrupt, then by the ISR
+static const jtag_uart_iovec * volatile tx_iov;
+static volatile unsigned int tx_count; // fragments left, starting at tx_iov
+static volatile unsigned int tx_offset; // bytes of tx_iov[0] already sent
+static volatile unsigned int tx_sent;
+
+// Copies as much as fits into the FIFO, non-zero once every fragment is in
+static int fill_fifo(void)
+{
+	unsigned int space = (IORD_ALTERA_AVALON_JTAG_UART_CONTROL(JTAG_UART_BASE) & ALTERA_AVALON_JTAG_UART_CONTROL_WSPACE_MSK) >> ALTERA_AVALON_JTAG_UART_CONTROL_WSPACE_OFST;
+	const alt_u8 *p;
+	unsigned int n;
+
+	while (tx_count > 0 && space > 0) {
+		p = (const alt_u8 *)tx_iov->base + tx_offset;
+		n = tx_iov->len - tx_offset;
+		if (n > space) {
+			n = space;
+		}
+		space -= n;
+		tx_offset += n;
+		tx_sent += n;
+		while (n--) {
+			IOWR_ALTERA_AVALON_JTAG_UART_DATA(JTAG_UART_BASE, *p++);
+		}
+		if (tx_offset == tx_iov->len) {
+			tx_iov++;
+			tx_count--;
+			tx_offset = 0;
+		}
+	}
+	// skip empty fragments, a write that ends with one is complete
+	while (tx_count > 0 && tx_iov->len == 0) {
+		tx_iov++;
+		tx_count--;
+	}
+	return tx_count == 0;
+}
+
+// Only enabled while a writer is waiting, WI is raised once the FIFO has emptied to the write threshold
+static void jtag_uart_isr(void* context, alt_u32 id)
+{
+	BaseType_t higher_prio_woken = pdFALSE;
+
+	if (fill_fifo()) {
+		IOWR_ALTERA_AVALON_JTAG_UART_CONTROL(JTAG_UART_BASE, 0);
+		xSemaphoreGiveFromISR(tx_done, &higher_prio_woken);
+	}
+	portEND_SWITCHING_ISR(higher_prio_woken);
+}
+
+void jtag_uart_init(void)
+{
+	write_lock = xSemaphoreCreateMutex();
+	tx_done = xSemaphoreCreateBinary();
+	IOWR_ALTERA_AVALON_JTAG_UART_CONTROL(JTAG_UART_BASE, 0);
+	alt_irq_register(JTAG_UART_IRQ, NULL, jtag_uart_isr);
+}
+
+unsigned int jtag_uart_writev(const jtag_uart_iovec *iov, unsigned int count, TickType_t timeout)
+{
+	alt_irq_context ctx;
+	TimeOut_t timeout_state;
+	unsigned int sent;
+
+	vTaskSetTimeOutState(&timeout_state);
+	if (xSemaphoreTake(write_lock, timeout) != pdTRUE) {
+		return 0;
+	}
+	tx_iov = iov;
+	tx_count = count;
+	tx_offset = 0;
+	tx_sent = 0;
+	// the interrupt is off, so nothing else touches the FIFO
+	if (!fill_fifo()) {
+		IOWR_ALTERA_AVALON_JTAG_UART_CONTROL(JTAG_UART_BASE, ALTERA_AVALON_JTAG_UART_CONTROL_WE_MSK);
+		// wait only for what is left after waiting for the lock
+		if (xTaskCheckForTimeOut(&timeout_state, &timeout) != pdFALSE) {
+			timeout = 0;
+		}
+		if (xSemaphoreTake(tx_done, timeout) != pdTRUE) {
+			ctx = alt_irq_disable_all();
+			IOWR_ALTERA_AVALON_JTAG_UART_CONTROL(JTAG_UART_BASE, 0);
+			tx_count = 0;
+			alt_irq_enable_all(ctx);
+			xSemaphoreTake(tx_done, 0); // in case the ISR finished after the timeout
+		}
+	}
+	sent = tx_sent;
+	xSemaphoreGive(write_lock);
+	return sent;
+}
+
+unsigned int jtag_uart_write(const void *buf, unsigned int len, TickType_t timeout)
+{
+	jtag_uart_iovec iov = {buf, len};
+	return jtag_uart_writev(&iov, 1, timeout);
+}
@@ -0,0 +1,34 @@
+#ifndef JTAG_UART_H
+#define JTAG_UART_H
+
+/*
+ * Blocking JTAG UART output for FreeRTOS tasks (JTAG_UART_BASE), TX only.
+ *
+ * The HAL driver's write lock is a no-op under this port, and when its 2 KB buffer is full a
+ * writer spins until the interrupt has made room. Here writers are serialised by a mutex and the
+ * data is not copied: a write fills the hardware FIFO straight from the caller's fragments, and
+ * if they don't all fit it enables the write interrupt and sleeps on a semaphore. The ISR refills
+ * the FIFO from the same fragments each time it drops below JTAG_UART_WRITE_THRESHOLD and gives
+ * the semaphore when the last byte is in, so a blocked writer uses no CPU.
+ *
+ * jtag_uart_init() takes the interrupt over from the HAL driver, so stdout and stderr must not be
+ * used after it (the application logs with LOG() instead).
+ */
+
+#include "FreeRTOS/FreeRTOS.h"
+
+typedef struct {
+	const void *base;
+	unsigned int len;
+} jtag_uart_iovec;
+
+void jtag_uart_init(void);
+
+// Sends the fragments in order, waiting up to timeout ticks for the host to take them. Returns the
+// bytes sent, all of them unless the timeout ran out. Tasks only, the fragments must stay valid
+// until it returns
+unsigned int jtag_uart_writev(const jtag_uart_iovec *iov, unsigned int count, TickType_t timeout);
+
+unsigned int jtag_uart_write(const void *buf, unsigned int len, TickType_t timeout);
+
+#endif /* JTAG_UART_H */
@@ -0,0 +1,125 @@
+#include <string.h>
+#include "system.h"
+#include "alt_types.h"
+#include "sys/alt_irq.h"
+#include "altera_avalon_lcd_16207_regs.h"
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+#include "FreeRTOS/timers.h"
+
+#include "lcd.h"
+#include "log.h"
+
+#define LCD_CELLS (LCD_ROWS * LCD_COLS)
+#define LCD_QUEUE_MASK (LCD_CELLS - 1)
+#define LCD_CMD_SET_ADDRESS 0x80 // set the DDRAM address, bits 6:0
+#define LCD_ROW_ADDRESS 0x40 // DDRAM address of the second row
+
+typedef char lcd_cells_power_of_two[(LCD_CELLS & LCD_QUEUE_MASK) == 0 ? 1 : -1];
+
+static char wanted[LCD_CELLS]; // written by the tasks
+static char shown[LCD_CELLS]; // sent to the controller
+static alt_u8 queued[LCD_CELLS]; // set while the cell is in the queue
+static alt_u8 queue[LCD_CELLS];
+static unsigned int queue_head = 0; // only moved by writers
+static unsigned int queue_tail = 0; // only moved by the drain timer
+static unsigned int address = ~0u; // the controller's DDRAM address, unknown until set
+static unsigned int busy_ticks = 0;
+static volatile int running = 0; // the drain timer is armed, or its callback is running
+static volatile int broken = 0;
+static TimerHandle_t lcd_timer;
+
+// Runs in the timer task: one command or one data byte, then re-arms itself while cells are waiting
+static void lcd_drain(TimerHandle_t timer)
+{
+	unsigned int cell, cell_address;
+	alt_irq_context ctx;
+	char c;
+
+	if (IORD_ALTERA_AVALON_LCD_16207_STATUS(CHARACTER_LCD_BASE) & ALTERA_AVALON_LCD_16207_STATUS_BUSY_MSK) {
+		if (++busy_ticks < LCD_BUSY_TIMEOUT && xTimerStart(timer, 0) == pdPASS) {
+			return;
+		}
+		broken = 1;
+		running = 0;
+		LOG("lcd: controller busy for %u ticks, output stopped\n", busy_ticks);
+		return;
+	}
+	busy_ticks = 0;
+
+	ctx = alt_irq_disable_all();
+	// cells written back to what the panel already shows cost nothing
+	while (queue_tail != queue_head && shown[queue[queue_tail & LCD_QUEUE_MASK]] == wanted[queue[queue_tail & LCD_QUEUE_MASK]]) {
+		queued[queue[queue_tail & LCD_QUEUE_MASK]] = 0;
+		queue_tail++;
+	}
+	if (queue_tail == queue_head) {
+		running = 0; // the next writer arms the timer again
+		alt_irq_enable_all(ctx);
+		return;
+	}
+	cell = queue[queue_tail & LCD_QUEUE_MASK];
+	cell_address = (cell / LCD_COLS) * LCD_ROW_ADDRESS + cell % LCD_COLS;
+	if (cell_address != address) {
+		IOWR_ALTERA_AVALON_LCD_16207_COMMAND(CHARACTER_LCD_BASE, LCD_CMD_SET_ADDRESS | cell_address);
+		address = cell_address;
+	}
+	else {
+		// the controller moves on to the next address, so the rest of a row needs no commands
+		c = wanted[cell];
+		IOWR_ALTERA_AVALON_LCD_16207_DATA(CHARACTER_LCD_BASE, c);
+		shown[cell] = c;
+		queued[cell] = 0;
+		queue_tail++;
+		address++;
+	}
+	alt_irq_enable_all(ctx);
+
+	if (xTimerStart(timer, 0) != pdPASS) {
+		running = 0;
+	}
+}
+
+void lcd_init(void)
+{
+	memset(wanted, ' ', sizeof(wanted));
+	memset(shown, ' ', sizeof(shown));
+	lcd_timer = xTimerCreate("lcd", LCD_PERIOD, pdFALSE, NULL, lcd_drain);
+}
+
+void lcd_put(unsigned int row, unsigned int col, char c)
+{
+	unsigned int cell = row * LCD_COLS + col;
+	alt_irq_context ctx;
+	int start;
+
+	if (row >= LCD_ROWS || col >= LCD_COLS) {
+		return;
+	}
+	ctx = alt_irq_disable_all();
+	wanted[cell] = c;
+	if (!queued[cell] && shown[cell] != c) {
+		queued[cell] = 1;
+		queue[queue_head++ & LCD_QUEUE_MASK] = cell;
+	}
+	start = !running && !broken && queue_head != queue_tail;
+	if (start) {
+		running = 1;
+	}
+	alt_irq_enable_all(ctx);
+
+	// a full timer command queue leaves the cell queued, the next write tries again
+	if (start && xTimerStart(lcd_timer, 0) != pdPASS) {
+		running = 0;
+	}
+}
+
+void lcd_line(unsigned int row, const char *s)
+{
+	unsigned int col;
+
+	for (col = 0; col < LCD_COLS; col++) {
+		lcd_put(row, col, *s ? *s++ : ' ');
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef LCD_H
+#define LCD_H
+
+/*
+ * Non-blocking output to the 16x2 character LCD (CHARACTER_LCD_BASE).
+ *
+ * The HAL driver (altera_avalon_lcd_16207.c) polls the controller's BUSY flag and sleeps 100 us
+ * for every command and data byte, and repaints in the caller's context. Here writers only update
+ * a shadow of the screen and queue the cells that changed, in constant time per cell. A FreeRTOS
+ * one-shot timer drains the queue one controller access per LCD_PERIOD ticks, so the controller
+ * is never busy when it is written, and is only armed while cells are waiting. Each cell is
+ * queued at most once, so the queue cannot overflow: a cell rewritten before it was sent is sent
+ * once with its latest character.
+ *
+ * The HAL driver still initialises the panel in alt_sys_init, don't also write to
+ * /dev/character_lcd.
+ */
+
+#define LCD_ROWS 2
+#define LCD_COLS 16
+#define LCD_PERIOD 1 // ticks between controller accesses, a write needs 40 us plus the 100 us the HAL waits
+#define LCD_BUSY_TIMEOUT 50 // ticks BUSY may stay set before the panel is taken to be missing
+
+// Creates the drain timer, call before the scheduler starts. The panel is taken to be clear
+void lcd_init(void);
+
+// Safe to call from tasks, not from ISRs. Out of range cells are ignored
+void lcd_put(unsigned int row, unsigned int col, char c);
+
+// Writes s from the start of the row and blanks the rest of it
+void lcd_line(unsigned int row, const char *s);
+
+#endif /* LCD_H */
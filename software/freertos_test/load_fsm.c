@@ -0,0 +1,121 @@
+#include "load_fsm.h"
+
+void load_fsm_init(load_fsm *f)
+{
+	int i;
+
+	f->state = NORMAL_OPERATION;
+	for (i = 0; i < LOAD_FSM_LOADS; i++) {
+		f->load_on[i] = 1;
+		f->switch_on[i] = 0;
+	}
+}
+
+// Loads follow their switches outside load management, during it switches can only turn loads off
+static void apply_switches(load_fsm *f, unsigned int switches)
+{
+	int i;
+
+	for (i = 0; i < LOAD_FSM_LOADS; i++) {
+		int on = (switches >> i) & 1;
+		if ((f->state == NORMAL_OPERATION) || (f->state == MAINTENANCE_MODE) || !on) {
+			f->load_on[i] = on;
+			f->switch_on[i] = on;
+		}
+	}
+}
+
+// Lowest numbered connected load first
+static int shed(load_fsm *f, unsigned int switches)
+{
+	int i, shed = -1;
+
+	for (i = 0; i < LOAD_FSM_LOADS; i++) {
+		if (f->load_on[i]) {
+			f->load_on[i] = 0;
+			shed = i;
+			break;
+		}
+	}
+	apply_switches(f, switches);
+	return shed;
+}
+
+// Highest numbered load first, only if it is switched on
+static int reconnect(load_fsm *f, unsigned int switches)
+{
+	int i, reconnected = -1;
+
+	for (i = LOAD_FSM_LOADS - 1; i >= 0; i--) {
+		if (!f->load_on[i] && f->switch_on[i]) {
+			f->load_on[i] = 1;
+			reconnected = i;
+			break;
+		}
+	}
+	apply_switches(f, switches);
+	return reconnected;
+}
+
+int load_fsm_all_connected(const load_fsm *f)
+{
+	int i;
+
+	for (i = 0; i < LOAD_FSM_LOADS; i++) {
+		if (!f->load_on[i] && f->switch_on[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void load_fsm_step(load_fsm *f, int stable, int deadline_expired, unsigned int switches, load_fsm_actions *a)
+{
+	a->shed = -1;
+	a->reconnected = -1;
+	a->initial_shed = 0;
+	a->arm_deadline = 0;
+
+	switch (f->state) {
+		case MAINTENANCE_MODE:
+			apply_switches(f, switches);
+			break;
+		case NORMAL_OPERATION:
+			if (!stable) {
+				// into load management first, or the switches would turn the shed load straight back on
+				f->state = LOAD_MGMT_MONITOR_UNSTABLE;
+				a->shed = shed(f, switches);
+				a->initial_shed = 1;
+				a->arm_deadline = 1;
+			}
+			else {
+				apply_switches(f, switches);
+			}
+			break;
+		case LOAD_MGMT_MONITOR_UNSTABLE:
+			if (deadline_expired) {
+				a->arm_deadline = 1;
+				a->shed = shed(f, switches);
+			}
+			else if (stable) {
+				a->arm_deadline = 1; // check it is not a fluke, one deadline period stable
+				f->state = LOAD_MGMT_MONITOR_STABLE;
+			}
+			break;
+		case LOAD_MGMT_MONITOR_STABLE:
+			if (deadline_expired) {
+				a->arm_deadline = 1;
+				if (load_fsm_all_connected(f)) {
+					f->state = NORMAL_OPERATION;
+				}
+				else {
+					a->reconnected = reconnect(f, switches);
+				}
+			}
+			else if (!stable) {
+				a->arm_deadline = 1;
+				f->state = LOAD_MGMT_MONITOR_UNSTABLE;
+			}
+			break;
+	}
+}
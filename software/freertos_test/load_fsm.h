@@ -0,0 +1,45 @@
+#ifndef LOAD_FSM_H
+#define LOAD_FSM_H
+
+/*
+ * Load management state machine run by Load_Management_Task.
+ *
+ * The first unstable sample sheds a load and starts the deadline. While the system stays unstable
+ * another load is shed each time the deadline expires; once it has been stable for a whole deadline
+ * period a load is reconnected instead, one per period, until all are back and the relay returns
+ * to normal operation. Loads are shed from load 0 up and reconnected from the highest down, and a
+ * load whose switch is off is never reconnected. Outside load management the switches turn loads
+ * on and off freely, during it they can only turn them off.
+ *
+ * Each step takes what the task samples (stability, deadline, switches) and reports what it did;
+ * the task does the I/O, telemetry, journal and deadline timer. Pure C with no RTOS calls, so
+ * software/host_tools/threshold_sweep.c replays recorded disturbances through the same code.
+ */
+
+#define LOAD_FSM_LOADS 5
+
+typedef enum {NORMAL_OPERATION, LOAD_MGMT_MONITOR_STABLE, LOAD_MGMT_MONITOR_UNSTABLE, MAINTENANCE_MODE} state;
+
+typedef struct {
+	state state; // the button ISR also moves it in and out of MAINTENANCE_MODE
+	int load_on[LOAD_FSM_LOADS]; // connected by the relay
+	int switch_on[LOAD_FSM_LOADS]; // wanted on by its switch, as of the last look at the switches
+} load_fsm;
+
+typedef struct {
+	int shed; // load shed by the step, -1 for none
+	int reconnected; // load reconnected by the step, -1 for none
+	int initial_shed; // the step left normal operation, the shed time runs from the detection
+	int arm_deadline; // restart the deadline
+} load_fsm_actions;
+
+// Normal operation with every load connected
+void load_fsm_init(load_fsm *f);
+
+// One pass of the task. switches has bit i set while switch i is on
+void load_fsm_step(load_fsm *f, int stable, int deadline_expired, unsigned int switches, load_fsm_actions *a);
+
+// Whether every load whose switch is on is connected
+int load_fsm_all_connected(const load_fsm *f);
+
+#endif /* LOAD_FSM_H */
@@ -0,0 +1,184 @@
+#include <stdarg.h>
+#include <string.h>
+#include "system.h"
+#include "alt_types.h"
+#include "sys/alt_irq.h"
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "log.h"
+#include "jtag_uart.h"
+
+#define LOG_RING_MASK (LOG_RING_WORDS - 1)
+#define LOG_HDR_COMMITTED 0x80000000 // set last, the drain task stops at the first record without it
+#define LOG_HDR_WORDS(hdr) ((hdr) & 0xff)
+#define LOG_FIXED_WORDS 3 // header, fmt id, tick
+
+static volatile alt_u32 log_ring[LOG_RING_WORDS];
+static volatile unsigned int log_head = 0; // only moved by producers, with interrupts held
+static volatile unsigned int log_tail = 0; // only moved by the drain task
+static volatile unsigned int log_drops = 0;
+static volatile unsigned int log_truncations = 0; // records that lost arguments past LOG_MAX_ARG_WORDS
+
+static int is_spec_char(char c)
+{
+	return (c != '\0') && (strchr("-+ #0123456789.*hlLjzt", c) != NULL);
+}
+
+void log_write(const char *fmt, ...)
+{
+	alt_u32 args[LOG_MAX_ARG_WORDS];
+	unsigned int nargs = 0;
+	unsigned int words, start, i;
+	alt_irq_context ctx;
+	const char *p;
+	int truncated = 0;
+	va_list ap;
+
+	// pull the raw arguments off the stack, the only work done here is walking the format string
+	va_start(ap, fmt);
+	for (p = fmt; *p != '\0'; p++) {
+		int longs = 0;
+		if (*p != '%') {
+			continue;
+		}
+		p++;
+		if (*p == '%') {
+			continue;
+		}
+		for (; is_spec_char(*p); p++) {
+			if (*p == '*') {
+				if (nargs == LOG_MAX_ARG_WORDS) {
+					truncated = 1;
+					break;
+				}
+				args[nargs++] = va_arg(ap, int);
+			}
+			longs += (*p == 'l');
+		}
+		if (truncated || *p == '\0') {
+			break;
+		}
+		if (strchr("feEgGaA", *p) != NULL || longs >= 2) {
+			alt_u32 pair[2];
+			if (strchr("feEgGaA", *p) != NULL) {
+				double d = va_arg(ap, double);
+				memcpy(pair, &d, sizeof(d));
+			} else {
+				long long ll = va_arg(ap, long long);
+				memcpy(pair, &ll, sizeof(ll));
+			}
+			if (nargs + 2 > LOG_MAX_ARG_WORDS) {
+				truncated = 1;
+				break;
+			}
+			args[nargs++] = pair[0];
+			args[nargs++] = pair[1];
+		} else {
+			if (nargs + 1 > LOG_MAX_ARG_WORDS) {
+				truncated = 1;
+				break;
+			}
+			args[nargs++] = va_arg(ap, unsigned int);
+		}
+	}
+	va_end(ap);
+
+	// reserve the record; interrupts are held only while the head index moves
+	words = LOG_FIXED_WORDS + nargs;
+	ctx = alt_irq_disable_all();
+	if (LOG_RING_WORDS - (log_head - log_tail) < words) {
+		log_drops++;
+		alt_irq_enable_all(ctx);
+		return;
+	}
+	start = log_head;
+	log_head = start + words;
+	// an uncommitted header, so the drain task never takes a stale argument word left at start
+	// by an earlier, differently sized record for this record's header
+	log_ring[start & LOG_RING_MASK] = words;
+	log_truncations += truncated;
+	alt_irq_enable_all(ctx);
+
+	log_ring[(start + 1) & LOG_RING_MASK] = (alt_u32)fmt;
+	log_ring[(start + 2) & LOG_RING_MASK] = xTaskGetTickCountFromISR();
+	for (i = 0; i < nargs; i++) {
+		log_ring[(start + LOG_FIXED_WORDS + i) & LOG_RING_MASK] = args[i];
+	}
+	log_ring[start & LOG_RING_MASK] = LOG_HDR_COMMITTED | words;
+}
+
+unsigned int log_dropped(void)
+{
+	return log_drops;
+}
+
+unsigned int log_truncated(void)
+{
+	return log_truncations;
+}
+
+char *log_put_hex(char *out, unsigned int v)
+{
+	static const char digits[] = "0123456789abcdef";
+	int shift;
+	*out++ = ' ';
+	for (shift = 28; shift >= 0; shift -= 4) {
+		*out++ = digits[(v >> shift) & 0xf];
+	}
+	return out;
+}
+
+// Pops the next committed record and renders it as a "#L ..." line, returns the line length or 0
+static int log_next_line(char *line)
+{
+	char *out = line;
+	unsigned int tail = log_tail;
+	unsigned int words, i;
+	alt_u32 hdr;
+
+	if (tail == log_head) {
+		return 0;
+	}
+	hdr = log_ring[tail & LOG_RING_MASK];
+	if (!(hdr & LOG_HDR_COMMITTED)) {
+		return 0; // producer preempted between reserve and commit, pick it up next time
+	}
+	words = LOG_HDR_WORDS(hdr);
+	*out++ = '#';
+	*out++ = 'L';
+	for (i = 1; i < words; i++) {
+		out = log_put_hex(out, log_ring[(tail + i) & LOG_RING_MASK]);
+	}
+	*out++ = '\n';
+	log_ring[tail & LOG_RING_MASK] = 0;
+	log_tail = tail + words;
+	return out - line;
+}
+
+// Low priority task which streams the log ring to the JTAG UART, sleeping in jtag_uart_write()
+// while the host is not draining it
+void Log_Drain_Task(void *pvParameters)
+{
+	char line[4 + 9 * (LOG_FIXED_WORDS + LOG_MAX_ARG_WORDS)];
+	int len;
+	unsigned int reported_drops = 0, reported_truncations = 0;
+
+	while(1) {
+		len = log_next_line(line);
+		if (len == 0 && (log_drops != reported_drops || log_truncations != reported_truncations)) {
+			reported_drops = log_drops;
+			reported_truncations = log_truncations;
+			line[0] = '#';
+			line[1] = 'D';
+			len = log_put_hex(log_put_hex(line + 2, reported_drops), reported_truncations) - line;
+			line[len++] = '\n';
+		}
+		if (len == 0) {
+			vTaskDelay(LOG_DRAIN_PERIOD);
+			continue;
+		}
+		jtag_uart_write(line, len, portMAX_DELAY);
+	}
+}
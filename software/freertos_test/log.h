@@ -0,0 +1,40 @@
+#ifndef LOG_H
+#define LOG_H
+
+/*
+ * Deferred logging for real-time tasks.
+ *
+ * LOG() takes a printf style format but never formats anything on the target: it stores the
+ * address of the format string (its ID, kept in .rodata.log_fmt) and the raw argument words in
+ * a ring. Log_Drain_Task later streams the records to the JTAG UART as text lines of hex words
+ *   #L <fmt id> <tick> <arg words>...
+ * and software/host_tools/log_expand.py re-expands them with the strings from the ELF.
+ *
+ * Supported conversions: d i u x X o c p (one word), f e g E G a and ll (two words), and s when the
+ * string lives in the ELF image (string literals, const tables). Producers never block: records
+ * that do not fit in the ring are dropped and counted, as are records whose arguments go past
+ * LOG_MAX_ARG_WORDS, which keep the arguments that fit.
+ */
+
+#define LOG_RING_WORDS 1024 // must be a power of two
+#define LOG_MAX_ARG_WORDS 8
+#define LOG_DRAIN_PERIOD 10 // ticks the drain task sleeps when the ring is empty
+
+#define LOG(fmt, ...) do { \
+	static const char log_fmt[] __attribute__((section(".rodata.log_fmt"))) = fmt; \
+	log_write(log_fmt, ##__VA_ARGS__); \
+} while (0)
+
+// Safe to call from tasks, ISRs and before the scheduler starts. Use LOG() instead of calling this directly
+void log_write(const char *fmt, ...);
+
+unsigned int log_dropped(void);
+
+unsigned int log_truncated(void);
+
+// Writes a space and v as 8 hex digits, the word format of the "#" lines, returns the end
+char *log_put_hex(char *out, unsigned int v);
+
+void Log_Drain_Task(void *pvParameters);
+
+#endif /* LOG_H */
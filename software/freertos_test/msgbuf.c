@@ -0,0 +1,136 @@
+#include "msgbuf.h"
+
+#ifndef MSGBUF_HOST
+	#include "sys/alt_irq.h"
+#endif
+
+#define compiler_barrier() __asm__ __volatile__("" ::: "memory")
+
+// Header: space in the low half, committed length in the high half
+#define HDR(space, len) ((alt_u32)(space) | ((alt_u32)(len) << 16))
+#define HDR_SPACE(hdr) ((hdr) & 0xffff)
+#define HDR_LEN(hdr) ((hdr) >> 16)
+#define LEN_UNCOMMITTED 0xffff
+
+#define AT(mb, pos) ((volatile alt_u32 *)&(mb)->storage[((pos) & ((mb)->size - 1)) / 4])
+
+void msgbuf_init(msgbuf *mb, void *storage, unsigned int size)
+{
+	mb->storage = storage;
+	mb->size = size;
+	mb->head = 0;
+	mb->tail = 0;
+	mb->drops = 0;
+	mb->reader = NULL;
+}
+
+void *msgbuf_reserve(msgbuf *mb, unsigned int len)
+{
+	unsigned int space = MSGBUF_SPACE(len);
+	unsigned int head, pad;
+	alt_irq_context ctx;
+
+	if (space > mb->size) {
+		return NULL;
+	}
+	ctx = alt_irq_disable_all();
+	head = mb->head;
+	pad = mb->size - (head & (mb->size - 1));
+	if (pad >= space) {
+		pad = 0;
+	}
+	if (mb->size - (head - mb->tail) < pad + space) {
+		mb->drops++;
+		alt_irq_enable_all(ctx);
+		return NULL;
+	}
+	if (pad > 0) {
+		*AT(mb, head) = HDR(pad, 0); // committed and empty, the consumer skips it
+		head += pad;
+	}
+	*AT(mb, head) = HDR(space, LEN_UNCOMMITTED);
+	mb->head = head + space;
+	alt_irq_enable_all(ctx);
+	return (void *)(AT(mb, head) + 1);
+}
+
+static void publish(void *record, unsigned int len)
+{
+	volatile alt_u32 *hdr = (volatile alt_u32 *)record - 1;
+
+	compiler_barrier(); // the data is written before the header says so
+	*hdr = HDR(HDR_SPACE(*hdr), len);
+	compiler_barrier();
+}
+
+void msgbuf_commit(msgbuf *mb, void *record, unsigned int len)
+{
+	TaskHandle_t reader;
+
+	publish(record, len);
+	reader = mb->reader;
+	if (reader != NULL) {
+		xTaskNotifyGive(reader);
+	}
+}
+
+void msgbuf_commit_from_isr(msgbuf *mb, void *record, unsigned int len, BaseType_t *higher_prio_woken)
+{
+	TaskHandle_t reader;
+
+	publish(record, len);
+	reader = mb->reader;
+	if (reader != NULL) {
+		vTaskNotifyGiveFromISR(reader, higher_prio_woken);
+	}
+}
+
+// The oldest committed record with data, skipping padding and discarded records
+static const void *next_record(msgbuf *mb, unsigned int *len)
+{
+	unsigned int tail = mb->tail;
+	alt_u32 hdr;
+
+	while (tail != mb->head) {
+		hdr = *AT(mb, tail);
+		if (HDR_LEN(hdr) == LEN_UNCOMMITTED) {
+			break;
+		}
+		if (HDR_LEN(hdr) != 0) {
+			*len = HDR_LEN(hdr);
+			return (const void *)(AT(mb, tail) + 1);
+		}
+		tail += HDR_SPACE(hdr);
+		mb->tail = tail;
+	}
+	return NULL;
+}
+
+const void *msgbuf_peek(msgbuf *mb, unsigned int *len, TickType_t timeout)
+{
+	const void *record = next_record(mb, len);
+	TimeOut_t timeout_state;
+
+	if (record != NULL || timeout == 0) {
+		return record;
+	}
+	vTaskSetTimeOutState(&timeout_state);
+	mb->reader = xTaskGetCurrentTaskHandle();
+	// a commit after the reader is set notifies it, so nothing is missed between check and wait
+	while ((record = next_record(mb, len)) == NULL && xTaskCheckForTimeOut(&timeout_state, &timeout) == pdFALSE) {
+		ulTaskNotifyTake(pdTRUE, timeout);
+	}
+	mb->reader = NULL;
+	return record;
+}
+
+void msgbuf_release(msgbuf *mb)
+{
+	unsigned int tail = mb->tail;
+	mb->tail = tail + HDR_SPACE(*AT(mb, tail));
+}
+
+unsigned int msgbuf_dropped(const msgbuf *mb)
+{
+	return mb->drops;
+}
@@ -0,0 +1,69 @@
+#ifndef MSGBUF_H
+#define MSGBUF_H
+
+/*
+ * Message buffer for variable length records, built in place.
+ *
+ * A queue copies every item into its storage and out again, and all items are the same size, so
+ * variable length records have to be padded to the largest or built in one buffer and copied into
+ * another. Here a producer reserves space for a record in the buffer's storage, writes it there and
+ * commits it; the consumer peeks at the oldest record where it lies and releases it when done.
+ * Nothing is copied by the buffer.
+ *
+ * Each record is a 32-bit header (reserved space and committed length) and the data, padded to a
+ * multiple of 4 bytes. Records never wrap: one that does not fit before the end of the storage is
+ * placed at the start, behind a padding record covering the rest.
+ *
+ * Any number of tasks and ISRs may produce: interrupts are only held while a reservation moves the
+ * head, and the record is written and committed without them. There is one consumer task. Records
+ * are consumed in reservation order, so a producer preempted between reserve and commit holds up
+ * the records reserved after it until it commits. Producers never block; reservations that don't
+ * fit are refused and counted. The consumer can block in msgbuf_peek(), it is woken with a task
+ * notification, so it must not use its notification value for anything else.
+ *
+ * Defining MSGBUF_HOST replaces the kernel and Altera headers with msgbuf_host.h, so the same code
+ * runs in the host benchmark (software/host_tools/msgbuf_bench.c).
+ */
+
+#ifdef MSGBUF_HOST
+	#include "msgbuf_host.h"
+#else
+	#include "alt_types.h"
+	#include "FreeRTOS/FreeRTOS.h"
+	#include "FreeRTOS/task.h"
+#endif
+
+#define MSGBUF_MAX_SIZE 32768 // storage bytes, so a record's space fits in 16 bits of its header
+#define MSGBUF_SPACE(len) ((((len) + 3) & ~3u) + 4) // bytes a record of len data bytes takes
+
+typedef struct {
+	alt_u32 *storage;
+	unsigned int size; // bytes, a power of two
+	volatile unsigned int head; // bytes ever reserved, moved by producers with interrupts held
+	volatile unsigned int tail; // bytes ever released, moved by the consumer
+	volatile unsigned int drops;
+	TaskHandle_t volatile reader; // the consumer, while it waits in msgbuf_peek()
+} msgbuf;
+
+// storage must be 4 byte aligned, size a power of two up to MSGBUF_MAX_SIZE
+void msgbuf_init(msgbuf *mb, void *storage, unsigned int size);
+
+// Space for len bytes of data, or NULL if it doesn't fit now (counted) or ever. Tasks and ISRs,
+// never blocks. Every reservation must be committed
+void *msgbuf_reserve(msgbuf *mb, unsigned int len);
+
+// Publishes a reserved record with the first len bytes written, up to the reserved length. A
+// record committed with length 0 is discarded without the consumer seeing it
+void msgbuf_commit(msgbuf *mb, void *record, unsigned int len);
+void msgbuf_commit_from_isr(msgbuf *mb, void *record, unsigned int len, BaseType_t *higher_prio_woken);
+
+// The oldest committed record and its length, waiting up to timeout ticks for one. NULL if the
+// time ran out. The record stays in the buffer, and peek returns it again, until it is released
+const void *msgbuf_peek(msgbuf *mb, unsigned int *len, TickType_t timeout);
+
+// Frees the record the last msgbuf_peek() returned
+void msgbuf_release(msgbuf *mb);
+
+unsigned int msgbuf_dropped(const msgbuf *mb);
+
+#endif /* MSGBUF_H */
@@ -0,0 +1,138 @@
+#include "system.h"
+#include "alt_types.h"
+#include "sys/alt_irq.h"
+#include "altera_avalon_timer_regs.h"
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "profiler.h"
+#include "jtag_uart.h"
+#include "log.h"
+#include "deadline.h"
+#include "irq_storm.h"
+
+#if PROFILER && (DEADLINE_HW_TIMER || IRQ_STORM_TEST)
+#error "PROFILER drives TIMER1US, set DEADLINE_HW_TIMER to 0 in deadline.h and turn IRQ_STORM_TEST off"
+#endif
+
+#define PROFILER_RING_MASK (PROFILER_RING_SAMPLES - 1)
+#define PROFILER_BATCH 16 // samples rendered per JTAG UART write
+
+// Word offsets in the context save_context in port_asm.S pushes, pxTopOfStack points at it
+#define FRAME_RA 0
+#define FRAME_EA 18 // already wound back to the interrupted instruction
+
+extern void * volatile pxCurrentTCB;
+
+typedef struct {
+	alt_u32 task;
+	alt_u32 pc;
+	alt_u32 ra;
+} profiler_sample;
+
+static volatile profiler_sample ring[PROFILER_RING_SAMPLES];
+static volatile unsigned int head = 0; // only moved by the ISR
+static volatile unsigned int tail = 0; // only moved by Profile_Task
+static volatile unsigned int drops = 0;
+
+static void profiler_isr(void* context, alt_u32 id)
+{
+	void *task = pxCurrentTCB;
+	alt_u32 *frame = *(alt_u32 **)task;
+	volatile profiler_sample *s;
+
+	IOWR_ALTERA_AVALON_TIMER_STATUS(TIMER1US_BASE, 0);
+	if (head - tail == PROFILER_RING_SAMPLES) {
+		drops++;
+		return;
+	}
+	s = &ring[head & PROFILER_RING_MASK];
+	s->task = (alt_u32)task;
+	s->pc = frame[FRAME_EA];
+	s->ra = frame[FRAME_RA];
+	head++;
+}
+
+static void profiler_start(void)
+{
+	unsigned int period = PROFILER_PERIOD_US * (TIMER1US_FREQ / 1000000) - 1;
+	alt_irq_context ctx;
+
+	IOWR_ALTERA_AVALON_TIMER_CONTROL(TIMER1US_BASE, ALTERA_AVALON_TIMER_CONTROL_STOP_MSK);
+	IOWR_ALTERA_AVALON_TIMER_PERIODL(TIMER1US_BASE, period & 0xFFFF);
+	IOWR_ALTERA_AVALON_TIMER_PERIODH(TIMER1US_BASE, period >> 16);
+	IOWR_ALTERA_AVALON_TIMER_STATUS(TIMER1US_BASE, 0);
+	// called from Profile_Task, where the port's alt_irq_register would leave interrupts off
+	ctx = alt_irq_disable_all();
+	alt_irq_register(TIMER1US_IRQ, NULL, profiler_isr);
+	alt_irq_enable_all(ctx);
+	IOWR_ALTERA_AVALON_TIMER_CONTROL(TIMER1US_BASE, ALTERA_AVALON_TIMER_CONTROL_CONT_MSK | ALTERA_AVALON_TIMER_CONTROL_START_MSK | ALTERA_AVALON_TIMER_CONTROL_ITO_MSK);
+}
+
+// Renders a "#T" line the first time a task is seen, returns the end of the buffer
+static char *put_task_name(char *out, alt_u32 task)
+{
+	static alt_u32 named[PROFILER_MAX_TASKS];
+	static unsigned int count = 0;
+	const char *name;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (named[i] == task) {
+			return out;
+		}
+	}
+	if (count < PROFILER_MAX_TASKS) {
+		named[count++] = task;
+	}
+	*out++ = '#';
+	*out++ = 'T';
+	out = log_put_hex(out, task);
+	*out++ = ' ';
+	for (name = pcTaskGetTaskName((TaskHandle_t)task), i = 0; name[i] != '\0' && i < configMAX_TASK_NAME_LEN; i++) {
+		*out++ = name[i];
+	}
+	*out++ = '\n';
+	return out;
+}
+
+void Profile_Task(void *pvParameters)
+{
+	// each sample can bring a name line with it, static to keep it off the task stack
+	static char buf[PROFILER_BATCH * (2 + 9 * 3 + 1 + 2 + 9 + 1 + configMAX_TASK_NAME_LEN + 1)];
+	unsigned int reported_drops = 0;
+	unsigned int n;
+	alt_u32 task, pc, ra;
+	char *out;
+
+	profiler_start();
+	while(1) {
+		out = buf;
+		for (n = 0; n < PROFILER_BATCH && tail != head; n++) {
+			task = ring[tail & PROFILER_RING_MASK].task;
+			pc = ring[tail & PROFILER_RING_MASK].pc;
+			ra = ring[tail & PROFILER_RING_MASK].ra;
+			tail++;
+			out = put_task_name(out, task);
+			*out++ = '#';
+			*out++ = 'P';
+			out = log_put_hex(out, task);
+			out = log_put_hex(out, pc);
+			out = log_put_hex(out, ra);
+			*out++ = '\n';
+		}
+		if (n == 0 && drops != reported_drops) {
+			reported_drops = drops;
+			*out++ = '#';
+			*out++ = 'Q';
+			out = log_put_hex(out, reported_drops);
+			*out++ = '\n';
+		}
+		if (out == buf) {
+			vTaskDelay(PROFILER_DRAIN_PERIOD);
+			continue;
+		}
+		jtag_uart_write(buf, out - buf, portMAX_DELAY);
+	}
+}
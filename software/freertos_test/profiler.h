@@ -0,0 +1,35 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/*
+ * Task-aware statistical profiler on TIMER1US.
+ *
+ * With PROFILER set, TIMER1US interrupts every PROFILER_PERIOD_US and its ISR records the running
+ * task and the PC and return address (ra) it was interrupted at, read from the context the
+ * exception entry saved on the task's stack. The period is prime so the samples don't lock step
+ * with the 1 ms tick and the tasks it releases. Profile_Task streams the samples to the JTAG UART
+ * next to the log, as text lines of hex words
+ *   #P <task> <pc> <ra>    a sample, task is the TCB address
+ *   #T <task> <name>       sent the first time a task is seen
+ *   #Q <count>             samples dropped so far because the ring was full
+ * and software/host_tools/profile_fold.py resolves them against the ELF symbols into per-task
+ * folded stacks for flamegraph.pl.
+ *
+ * ra is the caller only until the interrupted function makes a call of its own, so the host drops
+ * it when it points back into the same function. Code run with interrupts held is never sampled;
+ * its time is charged to wherever interrupts are enabled again. Interrupt handlers show up under
+ * the task they interrupted.
+ *
+ * TIMER1US is not available to anything else while the profiler is built in (see deadline.h).
+ */
+
+#define PROFILER 0
+#define PROFILER_PERIOD_US 997
+#define PROFILER_RING_SAMPLES 256 // must be a power of two
+#define PROFILER_MAX_TASKS 16 // tasks whose names are remembered as sent
+#define PROFILER_DRAIN_PERIOD 20 // ticks Profile_Task sleeps when the ring is empty
+
+// Starts sampling and streams the samples, never returns
+void Profile_Task(void *pvParameters);
+
+#endif /* PROFILER_H */
@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "roc_estimator.h"
+
+void roc_init(roc_estimator *e, int method, unsigned int window, double alpha)
+{
+	memset(e, 0, sizeof(*e));
+	e->method = method;
+	e->window = window < 2 ? 2 : window > ROC_WINDOW_MAX ? ROC_WINDOW_MAX : window;
+	e->alpha = alpha < 0.0 ? 0.0 : alpha > 1.0 ? 1.0 : alpha;
+}
+
+static double clamp(double roc)
+{
+	if (roc > ROC_CLAMP) {
+		return ROC_CLAMP;
+	}
+	if (roc < -ROC_CLAMP) {
+		return -ROC_CLAMP;
+	}
+	return roc;
+}
+
+// Same arithmetic as the original RoC task, so results match it bit for bit
+static double two_point(double f, double prev)
+{
+	return (f - prev) * 2.0 * f * prev / (f + prev);
+}
+
+static double least_squares(roc_estimator *e, double f)
+{
+	double p = 1.0 / f;
+	double n, x_sum, x2_sum;
+	unsigned int i;
+
+	if (e->count == e->window) {
+		// drop the oldest (x = 0) and move the rest down one
+		e->f_sum -= e->f[e->head];
+		e->period_sum -= e->period[e->head];
+		e->xf_sum -= e->f_sum;
+		e->count--;
+	}
+	e->xf_sum += e->count * f;
+	e->f_sum += f;
+	e->period_sum += p;
+	e->f[e->head] = f;
+	e->period[e->head] = p;
+	e->head = (e->head + 1) % e->window;
+	e->count++;
+	if (e->head == 0) {
+		// the ring is full with the oldest at 0: sum it afresh, or the rounding errors of xf_sum
+		// (which integrates those of f_sum) grow without bound, to several Hz/s after a week
+		e->f_sum = e->xf_sum = e->period_sum = 0.0;
+		for (i = 0; i < e->window; i++) {
+			e->f_sum += e->f[i];
+			e->xf_sum += i * e->f[i];
+			e->period_sum += e->period[i];
+		}
+	}
+	if (e->count < 2) {
+		return 0.0;
+	}
+
+	// slope in Hz per sample, over the mean period in s per sample
+	n = e->count;
+	x_sum = n * (n - 1) / 2;
+	x2_sum = (n - 1) * n * (2 * n - 1) / 6;
+	return (n * e->xf_sum - x_sum * e->f_sum) * n / ((n * x2_sum - x_sum * x_sum) * e->period_sum);
+}
+
+double roc_update(roc_estimator *e, double freq)
+{
+	double roc;
+
+	switch (e->method) {
+		case ROC_LEAST_SQUARES:
+			roc = clamp(least_squares(e, freq));
+			break;
+		case ROC_IIR:
+			// the first sample has no predecessor, the filter starts from 0
+			if (e->prev != 0.0) {
+				e->iir += (1.0 - e->alpha) * (two_point(freq, e->prev) - e->iir);
+			}
+			roc = clamp(e->iir);
+			break;
+		default:
+			roc = two_point(freq, e->prev);
+			if (roc > 100.0) {
+				roc = 100.0;
+			}
+			break;
+	}
+	e->prev = freq;
+	return roc;
+}
@@ -0,0 +1,57 @@
+#ifndef ROC_ESTIMATOR_H
+#define ROC_ESTIMATOR_H
+
+/*
+ * Streaming rate of change of frequency estimators, one update per analyser sample.
+ *
+ * ROC_TWO_POINT    - the original estimate from the last two samples: their frequency difference
+ *                    over the mean of their periods, clamped at +100 Hz/s only. One count of
+ *                    jitter in the analyser's 16 kHz period count moves it by about 8 Hz/s.
+ * ROC_LEAST_SQUARES - least squares slope of the last `window` samples against sample number,
+ *                    over the mean period of the window. The running sums of f, x*f and the
+ *                    periods are updated in O(1) per sample, whatever the window, and
+ *                    summed afresh once per window so their rounding errors cannot build up.
+ * ROC_IIR          - the two-point estimate through a first order low-pass filter,
+ *                    y += (1 - alpha) * (x - y).
+ * The filtered methods are clamped to +-ROC_CLAMP.
+ *
+ * Pure C with no RTOS calls. software/host_tools/roc_bench.c compares the methods on recorded or
+ * synthetic traces.
+ */
+
+#define ROC_TWO_POINT 0
+#define ROC_LEAST_SQUARES 1
+#define ROC_IIR 2
+
+// Method used by ROC_Calculation_Task. ROC_LEAST_SQUARES all but stops false trips on jitter but
+// detects about 50 ms later, before time_before_shed is taken, so the shed times shown and sent
+// do not include that delay
+#define ROC_METHOD ROC_TWO_POINT
+#define ROC_WINDOW 6 // samples, least squares only
+#define ROC_IIR_ALPHA 0.6 // IIR only, closer to 1 filters more
+
+#define ROC_WINDOW_MAX 32
+#define ROC_CLAMP 100.0
+
+typedef struct {
+	int method;
+	unsigned int window;
+	double alpha;
+	double prev; // last frequency, 0 before the first sample
+	double f[ROC_WINDOW_MAX]; // least squares ring, oldest at head once full
+	double period[ROC_WINDOW_MAX];
+	unsigned int head;
+	unsigned int count;
+	double f_sum;
+	double xf_sum; // x is 0 for the oldest sample in the window
+	double period_sum;
+	double iir;
+} roc_estimator;
+
+// window is clamped to 2..ROC_WINDOW_MAX, alpha to 0..1
+void roc_init(roc_estimator *e, int method, unsigned int window, double alpha);
+
+// Takes the next frequency sample in Hz and returns the RoC estimate in Hz/s
+double roc_update(roc_estimator *e, double freq);
+
+#endif /* ROC_ESTIMATOR_H */
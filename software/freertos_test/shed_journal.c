@@ -0,0 +1,209 @@
+#include <string.h>
+#include "system.h"
+#include "alt_types.h"
+#include "sys/alt_irq.h"
+#include "sys/alt_flash.h"
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "journal.h"
+#include "shed_journal.h"
+#include "log.h"
+
+#define SHED_JOURNAL_RING_MASK (SHED_JOURNAL_RING_SIZE - 1)
+
+typedef char shed_record_fits_slot[sizeof(shed_record) == JOURNAL_DATA_SIZE ? 1 : -1];
+
+static alt_flash_fd *flash_fd = NULL;
+static journal_flash flash;
+static journal shed_log;
+static int enabled = 0;
+static alt_u16 boot = 0;
+
+static shed_record ring[SHED_JOURNAL_RING_SIZE];
+static volatile unsigned int ring_head = 0; // only moved by producers
+static volatile unsigned int ring_tail = 0; // only moved by Journal_Task
+static volatile unsigned int dropped = 0;
+
+// CFI flash backend, all offsets are within the journal region
+static int cfi_read(void *ctx, unsigned int offset, void *dst, unsigned int len)
+{
+	return alt_read_flash(flash_fd, SHED_JOURNAL_OFFSET + offset, dst, len);
+}
+
+// Programs without erasing: the CFI driver's write_block goes straight to alt_flash_program_block
+static int cfi_program(void *ctx, unsigned int offset, const void *src, unsigned int len)
+{
+	unsigned int sector = offset - offset % flash.sector_size;
+	return alt_write_flash_block(flash_fd, SHED_JOURNAL_OFFSET + sector, SHED_JOURNAL_OFFSET + offset, src, len);
+}
+
+static int cfi_erase(void *ctx, unsigned int offset)
+{
+	return alt_erase_flash_block(flash_fd, SHED_JOURNAL_OFFSET + offset, flash.sector_size);
+}
+
+// The journal needs SHED_JOURNAL_SECTORS equal blocks, so the region must sit inside one flash region
+static int find_geometry(void)
+{
+	flash_region *regions;
+	int count, i;
+
+	if (alt_get_flash_info(flash_fd, &regions, &count) != 0) {
+		return 1;
+	}
+	for (i = 0; i < count; i++) {
+		unsigned int start = regions[i].offset;
+		unsigned int end = start + regions[i].region_size;
+		unsigned int size = regions[i].block_size * SHED_JOURNAL_SECTORS;
+		if (SHED_JOURNAL_OFFSET >= start && SHED_JOURNAL_OFFSET + size <= end && (SHED_JOURNAL_OFFSET - start) % regions[i].block_size == 0) {
+			flash.sector_size = regions[i].block_size;
+			flash.sectors = SHED_JOURNAL_SECTORS;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int find_boot(void *ctx, const void *data)
+{
+	shed_record r;
+	memcpy(&r, data, sizeof(r));
+	*(alt_u16 *)ctx = r.boot;
+	return 1;
+}
+
+int shed_journal_init(void)
+{
+	shed_record r;
+
+	flash_fd = alt_flash_open_dev(FLASH_CONTROLLER_NAME);
+	if (flash_fd == NULL) {
+		LOG("shed journal: can't open %s\n", FLASH_CONTROLLER_NAME);
+		return 1;
+	}
+	if (find_geometry() != 0) {
+		LOG("shed journal: no uniform blocks at flash offset 0x%x\n", SHED_JOURNAL_OFFSET);
+		return 1;
+	}
+	flash.read = cfi_read;
+	flash.program = cfi_program;
+	flash.erase = cfi_erase;
+	if (journal_open(&shed_log, &flash) != 0) {
+		LOG("shed journal: unusable geometry, %u byte sectors\n", flash.sector_size);
+		return 1;
+	}
+
+	boot = 0;
+	journal_walk(&shed_log, find_boot, &boot);
+	boot++;
+	enabled = 1;
+	LOG("shed journal: boot %u, sector %u slot %u, %u erases\n", boot, shed_log.head, shed_log.next_slot, shed_log.erases);
+
+	memset(&r, 0, sizeof(r));
+	r.boot = boot;
+	r.event = SHED_JOURNAL_BOOT;
+	journal_append(&shed_log, &r);
+	return 0;
+}
+
+typedef struct {
+	unsigned int *shed_times;
+	unsigned int n;
+	unsigned int found;
+	unsigned int scanned;
+} recent_scan;
+
+static int find_recent(void *ctx, const void *data)
+{
+	recent_scan *scan = ctx;
+	shed_record r;
+
+	memcpy(&r, data, sizeof(r));
+	if (r.event == SHED_JOURNAL_INITIAL_SHED && r.boot != boot) {
+		scan->shed_times[scan->found++] = r.shed_time;
+	}
+	return scan->found == scan->n || ++scan->scanned == SHED_JOURNAL_RESTORE_SCAN;
+}
+
+unsigned int shed_journal_recent(unsigned int *shed_times, unsigned int n)
+{
+	recent_scan scan = {shed_times, n, 0, 0};
+
+	if (!enabled || n == 0) {
+		return 0;
+	}
+	journal_walk(&shed_log, find_recent, &scan);
+	return scan.found;
+}
+
+static alt_u16 fixed_point(double value, double max)
+{
+	if (value > max) {
+		value = max;
+	}
+	if (value < -max) {
+		value = -max;
+	}
+	return (alt_u16)(int)(value * 100.0 + (value < 0 ? -0.5 : 0.5));
+}
+
+void shed_journal_event(int event, int load, unsigned int shed_time, double freq, double roc)
+{
+	shed_record *r;
+	alt_irq_context ctx;
+
+	if (!enabled) {
+		return;
+	}
+	ctx = alt_irq_disable_all();
+	if (ring_head - ring_tail == SHED_JOURNAL_RING_SIZE) {
+		dropped++;
+		alt_irq_enable_all(ctx);
+		return;
+	}
+	r = &ring[ring_head & SHED_JOURNAL_RING_MASK];
+	r->tick = xTaskGetTickCountFromISR();
+	r->boot = boot;
+	r->shed_time = shed_time > 0xffff ? 0xffff : shed_time;
+	r->freq = fixed_point(freq, 655.0);
+	r->roc = fixed_point(roc, 327.0);
+	r->event = event;
+	r->load = load;
+	ring_head++;
+	alt_irq_enable_all(ctx);
+}
+
+unsigned int shed_journal_dropped(void)
+{
+	return dropped;
+}
+
+// Low priority: a sector erase can keep it busy for a second
+void Journal_Task(void *pvParameters)
+{
+	TickType_t first_pending = 0;
+	unsigned int lost = 0;
+
+	while (1) {
+		vTaskDelay(SHED_JOURNAL_POLL_MS / portTICK_PERIOD_MS);
+		if (!enabled) {
+			continue;
+		}
+		while (ring_tail != ring_head) {
+			if (shed_log.batched == 0) {
+				first_pending = xTaskGetTickCount();
+			}
+			journal_append(&shed_log, &ring[ring_tail & SHED_JOURNAL_RING_MASK]);
+			ring_tail++;
+		}
+		if (shed_log.batched > 0 && (xTaskGetTickCount() - first_pending) * portTICK_PERIOD_MS >= SHED_JOURNAL_FLUSH_MS) {
+			journal_flush(&shed_log);
+		}
+		if (shed_log.lost != lost) {
+			lost = shed_log.lost;
+			LOG("shed journal: %u records lost to flash errors\n", lost);
+		}
+	}
+}
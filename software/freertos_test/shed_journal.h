@@ -0,0 +1,56 @@
+#ifndef SHED_JOURNAL_H
+#define SHED_JOURNAL_H
+
+/*
+ * Shed events kept across power cycles in the CFI flash (FLASH_CONTROLLER_BASE).
+ *
+ * Producers copy a shed_record into a small ring without blocking. Journal_Task moves them into the
+ * flash journal (journal.c), whose program and erase calls take milliseconds to a second, and
+ * flushes a partial batch once the oldest record in it has waited SHED_JOURNAL_FLUSH_MS. The
+ * journal keeps the last SHED_JOURNAL_SECTORS - 1 sectors of records, about 28000 events.
+ *
+ * shed_journal_init() runs before Journal_Task is created: it finds the end of the journal, numbers
+ * this power cycle and can then hand back the recent shed times so the statistics survive a reset.
+ * Events from before it are not journalled.
+ */
+
+#include "alt_types.h"
+
+#define SHED_JOURNAL_OFFSET 0x700000 // clear of the configuration image, below the top boot sectors
+#define SHED_JOURNAL_SECTORS 8
+#define SHED_JOURNAL_RING_SIZE 16 // must be a power of two
+#define SHED_JOURNAL_POLL_MS 100 // Journal_Task period
+#define SHED_JOURNAL_FLUSH_MS 1000 // worst case records are lost to a power cut
+#define SHED_JOURNAL_RESTORE_SCAN 4096 // records looked at for recent shed times at boot
+
+// shed_record events
+#define SHED_JOURNAL_BOOT 			0 // power cycle started, load 0
+#define SHED_JOURNAL_INITIAL_SHED 	1 // first load shed on instability, shed_time is valid
+#define SHED_JOURNAL_LOAD_SHED 		2
+#define SHED_JOURNAL_LOAD_RECONNECT 3
+
+typedef struct {
+	alt_u32 tick; // since this power cycle started
+	alt_u16 boot; // power cycle number, counted by the journal
+	alt_u16 shed_time; // ms
+	alt_u16 freq; // trigger frequency, 0.01 Hz
+	alt_16 roc; // trigger RoC, 0.01 Hz/s
+	alt_u8 event;
+	alt_u8 load;
+} __attribute__((packed)) shed_record;
+
+// Non-zero if the flash could not be used, the journal then stays disabled
+int shed_journal_init(void);
+
+// Newest first, up to n shed times of initial sheds from earlier power cycles. Returns how many.
+// Call before Journal_Task is created, it does not expect the journal to be read under it
+unsigned int shed_journal_recent(unsigned int *shed_times, unsigned int n);
+
+// Safe to call from tasks and ISRs, never blocks. freq and roc are the values that triggered the shed
+void shed_journal_event(int event, int load, unsigned int shed_time, double freq, double roc);
+
+unsigned int shed_journal_dropped(void);
+
+void Journal_Task(void *pvParameters);
+
+#endif /* SHED_JOURNAL_H */
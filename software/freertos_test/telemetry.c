@@ -0,0 +1,212 @@
+#include <string.h>
+#include "system.h"
+#include "alt_types.h"
+#include "sys/alt_irq.h"
+#include "altera_avalon_uart_regs.h"
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "telemetry.h"
+#include "command.h"
+
+#define TLM_RING_MASK (TLM_TX_RING_SIZE - 1)
+#define TLM_RX_RING_MASK (TLM_RX_RING_SIZE - 1)
+
+static alt_u8 tx_ring[TLM_TX_RING_SIZE];
+static volatile unsigned int tx_head = 0; // next free byte, only moved by producers
+static volatile unsigned int tx_tail = 0; // next byte to send, only moved by the TX ISR
+static unsigned short tx_seq = 0;
+static volatile unsigned int tx_dropped = 0;
+
+static alt_u8 rx_ring[TLM_RX_RING_SIZE];
+static volatile unsigned int rx_head = 0; // only moved by the ISR
+static volatile unsigned int rx_tail = 0; // only moved by the attached task
+static volatile unsigned int rx_dropped = 0;
+static TaskHandle_t rx_task = NULL;
+static alt_u32 rx_control = 0; // RRDY once a task is attached, kept in CONTROL alongside TRDY
+
+// Feeds the UART one byte per TRDY and masks TRDY once the TX ring runs dry. Empties the receiver
+// into the RX ring and wakes the attached task once for however many bytes came in
+static void telemetry_uart_isr(void* context, alt_u32 id)
+{
+	BaseType_t higher_prio_woken = pdFALSE;
+	alt_u32 status = IORD_ALTERA_AVALON_UART_STATUS(UART_BASE);
+	unsigned int received = rx_head;
+
+	while (status & ALTERA_AVALON_UART_STATUS_RRDY_MSK) {
+		alt_u8 byte = IORD_ALTERA_AVALON_UART_RXDATA(UART_BASE);
+		if (rx_head - rx_tail < TLM_RX_RING_SIZE) {
+			rx_ring[rx_head++ & TLM_RX_RING_MASK] = byte;
+		}
+		else {
+			rx_dropped++;
+		}
+		status = IORD_ALTERA_AVALON_UART_STATUS(UART_BASE);
+	}
+	if (status & ALTERA_AVALON_UART_STATUS_ROE_MSK) {
+		rx_dropped++;
+		IOWR_ALTERA_AVALON_UART_STATUS(UART_BASE, 0);
+	}
+
+	while ((IORD_ALTERA_AVALON_UART_STATUS(UART_BASE) & ALTERA_AVALON_UART_STATUS_TRDY_MSK) && (tx_tail != tx_head)) {
+		IOWR_ALTERA_AVALON_UART_TXDATA(UART_BASE, tx_ring[tx_tail & TLM_RING_MASK]);
+		tx_tail++;
+	}
+	if (tx_tail == tx_head) {
+		IOWR_ALTERA_AVALON_UART_CONTROL(UART_BASE, rx_control);
+	}
+
+	if (rx_head != received && rx_task != NULL) {
+		vTaskNotifyGiveFromISR(rx_task, &higher_prio_woken);
+	}
+	portEND_SWITCHING_ISR(higher_prio_woken);
+}
+
+// Frames a record into the ring. Interrupts are held only for the copy of one record
+static void telemetry_put(alt_u8 type, const alt_u8 *payload, alt_u8 len)
+{
+	alt_u8 header[TLM_HEADER_SIZE];
+	alt_u8 sum;
+	unsigned int i, head;
+	alt_irq_context ctx = alt_irq_disable_all();
+	unsigned int tick = xTaskGetTickCountFromISR();
+	unsigned short seq = tx_seq++;
+
+	if (TLM_TX_RING_SIZE - (tx_head - tx_tail) < TLM_HEADER_SIZE + len + 1) {
+		tx_dropped++; // the seq number is still consumed so the host sees the gap
+		alt_irq_enable_all(ctx);
+		return;
+	}
+
+	header[0] = TLM_SYNC;
+	header[1] = type;
+	header[2] = len;
+	header[3] = seq & 0xff;
+	header[4] = seq >> 8;
+	header[5] = tick & 0xff;
+	header[6] = (tick >> 8) & 0xff;
+	header[7] = (tick >> 16) & 0xff;
+	header[8] = tick >> 24;
+
+	head = tx_head;
+	sum = 0;
+	for (i = 0; i < TLM_HEADER_SIZE; i++) {
+		tx_ring[head++ & TLM_RING_MASK] = header[i];
+		sum += (i > 0) ? header[i] : 0;
+	}
+	for (i = 0; i < len; i++) {
+		tx_ring[head++ & TLM_RING_MASK] = payload[i];
+		sum += payload[i];
+	}
+	tx_ring[head++ & TLM_RING_MASK] = (alt_u8)(-sum);
+	tx_head = head;
+
+	// (re)arm the TX interrupt, the ISR masks it again once everything is sent
+	IOWR_ALTERA_AVALON_UART_CONTROL(UART_BASE, ALTERA_AVALON_UART_CONTROL_TRDY_MSK | rx_control);
+	alt_irq_enable_all(ctx);
+}
+
+static void put_u16(alt_u8 *buf, unsigned int v)
+{
+	buf[0] = v & 0xff;
+	buf[1] = (v >> 8) & 0xff;
+}
+
+static void put_u32(alt_u8 *buf, unsigned int v)
+{
+	put_u16(buf, v);
+	put_u16(buf + 2, v >> 16);
+}
+
+static void put_f32(alt_u8 *buf, double v)
+{
+	float f = (float)v;
+	unsigned int bits;
+	memcpy(&bits, &f, sizeof(bits));
+	put_u32(buf, bits);
+}
+
+void telemetry_init(void)
+{
+	IOWR_ALTERA_AVALON_UART_CONTROL(UART_BASE, 0);
+	IOWR_ALTERA_AVALON_UART_STATUS(UART_BASE, 0); // clear any error flags
+	alt_irq_register(UART_IRQ, NULL, telemetry_uart_isr);
+}
+
+void telemetry_sample(unsigned int adc_samples)
+{
+	alt_u8 payload[4];
+	put_u32(payload, adc_samples);
+	telemetry_put(TLM_SAMPLE, payload, sizeof(payload));
+}
+
+void telemetry_roc(double freq, double roc, int stable)
+{
+	alt_u8 payload[9];
+	put_f32(payload, freq);
+	put_f32(payload + 4, roc);
+	payload[8] = stable ? 1 : 0;
+	telemetry_put(TLM_ROC, payload, sizeof(payload));
+}
+
+void telemetry_state(int prev_state, int new_state)
+{
+	alt_u8 payload[2];
+	payload[0] = prev_state;
+	payload[1] = new_state;
+	telemetry_put(TLM_STATE, payload, sizeof(payload));
+}
+
+void telemetry_load(int event, int load, unsigned int shed_time)
+{
+	alt_u8 payload[4];
+	payload[0] = event;
+	payload[1] = load;
+	put_u16(payload + 2, shed_time > 0xffff ? 0xffff : shed_time);
+	telemetry_put(TLM_LOAD, payload, sizeof(payload));
+}
+
+void telemetry_response(int request, unsigned int request_seq, int status, const unsigned char *data, unsigned int len)
+{
+	alt_u8 payload[4 + CMD_MAX_RESPONSE];
+
+	if (len > CMD_MAX_RESPONSE) {
+		len = CMD_MAX_RESPONSE;
+	}
+	payload[0] = request;
+	put_u16(payload + 1, request_seq);
+	payload[3] = status;
+	memcpy(payload + 4, data, len);
+	telemetry_put(TLM_RESPONSE, payload, 4 + len);
+}
+
+unsigned int telemetry_dropped(void)
+{
+	return tx_dropped;
+}
+
+void telemetry_rx_attach(TaskHandle_t task)
+{
+	alt_irq_context ctx = alt_irq_disable_all();
+	rx_task = task;
+	rx_control = ALTERA_AVALON_UART_CONTROL_RRDY_MSK;
+	IOWR_ALTERA_AVALON_UART_CONTROL(UART_BASE, rx_control | (tx_tail != tx_head ? ALTERA_AVALON_UART_CONTROL_TRDY_MSK : 0));
+	alt_irq_enable_all(ctx);
+}
+
+unsigned int telemetry_receive(unsigned char *buf, unsigned int n)
+{
+	unsigned int got = 0, head = rx_head;
+
+	while (got < n && rx_tail != head) {
+		buf[got++] = rx_ring[rx_tail & TLM_RX_RING_MASK];
+		rx_tail++;
+	}
+	return got;
+}
+
+unsigned int telemetry_rx_dropped(void)
+{
+	return rx_dropped;
+}
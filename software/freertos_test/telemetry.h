@@ -0,0 +1,62 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+/*
+ * Binary telemetry stream on the serial UART (UART_BASE).
+ *
+ * Every record is framed as:
+ *   0xA5 | type | payload length | seq (u16 LE) | tick (u32 LE) | payload | checksum
+ * where checksum is the two's complement of the byte sum from type to the end of the payload.
+ * Records are copied into a TX ring and sent by the UART TX interrupt. Producers never block:
+ * if the ring is full the record is dropped and counted. The sequence number is consumed
+ * by dropped records too, so gaps seen by the host decoder are exactly the drops.
+ *
+ * Decoder: software/host_tools/telemetry_decode.py
+ *
+ * The UART also receives remote requests (command.h). The RX interrupt empties the receiver into
+ * an RX ring, as many bytes as are waiting per interrupt, and notifies the attached task once per
+ * interrupt; responses go out as TLM_RESPONSE records in the TX stream. RX stays off until a task
+ * is attached.
+ */
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#define TLM_SYNC 0xA5
+#define TLM_HEADER_SIZE 9 // sync, type, len, seq(2), tick(4)
+#define TLM_TX_RING_SIZE 2048 // must be a power of two
+#define TLM_RX_RING_SIZE 256 // must be a power of two
+
+// Record types
+#define TLM_SAMPLE 		0x01 // payload: adc sample count (u32), from the analyser ISR
+#define TLM_ROC 		0x02 // payload: freq (f32), roc (f32), stable (u8)
+#define TLM_STATE 		0x03 // payload: previous state (u8), new state (u8)
+#define TLM_LOAD 		0x04 // payload: event (u8), load index (u8), shed time in ms (u16)
+#define TLM_RESPONSE 	0x05 // payload: request type (u8), request seq (u16), status (u8), data, see command.h
+
+// TLM_LOAD events
+#define TLM_LOAD_SHED 		0
+#define TLM_LOAD_RECONNECT 	1
+
+void telemetry_init(void);
+
+// All producers are safe to call from tasks and ISRs
+void telemetry_sample(unsigned int adc_samples);
+void telemetry_roc(double freq, double roc, int stable);
+void telemetry_state(int prev_state, int new_state);
+void telemetry_load(int event, int load, unsigned int shed_time);
+
+void telemetry_response(int request, unsigned int request_seq, int status, const unsigned char *data, unsigned int len);
+
+unsigned int telemetry_dropped(void);
+
+// Enables RX, task is notified (xTaskNotifyGive) when bytes arrive and reads them with telemetry_receive()
+void telemetry_rx_attach(TaskHandle_t task);
+
+// Up to n received bytes, returns how many. Only from the attached task
+unsigned int telemetry_receive(unsigned char *buf, unsigned int n);
+
+// Bytes lost to a full RX ring or a receiver overrun
+unsigned int telemetry_rx_dropped(void);
+
+#endif /* TELEMETRY_H */
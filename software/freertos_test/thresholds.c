@@ -0,0 +1,56 @@
+#include "sys/alt_irq.h"
+
+#include "thresholds.h"
+
+// Keeps the compiler from moving loads and stores across it. One Nios II core sees its own stores in order
+#define compiler_barrier() __asm__ __volatile__("" ::: "memory")
+
+static thresholds slots[2];
+static thresholds * volatile published = &slots[0];
+static unsigned int version = 0;
+
+static void fill(thresholds *slot, double freq, double roc)
+{
+	slot->version = 0;
+	compiler_barrier();
+	slot->freq = freq;
+	slot->roc = roc;
+	compiler_barrier();
+	if (++version == 0) {
+		version = 1; // 0 marks a slot being written
+	}
+	slot->version = version;
+}
+
+void thresholds_init(double freq, double roc)
+{
+	fill(&slots[0], freq, roc);
+	published = &slots[0];
+}
+
+void thresholds_read(thresholds *t)
+{
+	const thresholds *slot;
+	unsigned int before;
+
+	do {
+		slot = published;
+		before = slot->version;
+		compiler_barrier();
+		t->freq = slot->freq;
+		t->roc = slot->roc;
+		compiler_barrier();
+	} while (before == 0 || slot->version != before);
+	t->version = before;
+}
+
+void thresholds_publish(double freq, double roc)
+{
+	alt_irq_context ctx = alt_irq_disable_all();
+	thresholds *slot = published == &slots[0] ? &slots[1] : &slots[0];
+
+	fill(slot, freq, roc);
+	compiler_barrier();
+	published = slot;
+	alt_irq_enable_all(ctx);
+}
@@ -0,0 +1,29 @@
+#ifndef THRESHOLDS_H
+#define THRESHOLDS_H
+
+/*
+ * Frequency and RoC thresholds, published without a lock.
+ *
+ * A writer (the keyboard or command task) fills the slot that is not published and then publishes
+ * it with a single pointer store, holding interrupts for those few stores so two writers can't mix.
+ * Readers copy the published slot and check that its version did not change under them, which can
+ * only happen if the reader was preempted for long enough that the writers published twice. A
+ * reader never waits for a writer, and a high priority one never retries.
+ */
+
+typedef struct {
+	double freq; // Hz, unstable below it
+	double roc; // Hz/s, unstable at or above it in either direction
+	unsigned int version; // counts publishes, 0 while the slot is being written
+} thresholds;
+
+// Before the scheduler starts
+void thresholds_init(double freq, double roc);
+
+// Safe to call from tasks and ISRs, never blocks
+void thresholds_read(thresholds *t);
+
+// Tasks only. Writers race: a read, adjust and publish can lose another writer's change
+void thresholds_publish(double freq, double roc);
+
+#endif /* THRESHOLDS_H */
@@ -0,0 +1,68 @@
+#include <unistd.h>
+#include "system.h"
+#include "nios2.h"
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "usleep.h"
+
+#define USLEEP_COUNTS_PER_US (portTIMESTAMP_HZ / 1000000)
+#define USLEEP_CHUNK_US 10000000 // well inside the 2^32 timestamp counts before a difference wraps
+
+static volatile unsigned int slept_us = 0;
+static volatile unsigned int spun_us = 0;
+
+static int can_sleep(void)
+{
+	alt_u32 status;
+
+	NIOS2_READ_STATUS(status);
+	return (status & NIOS2_STATUS_PIE_MSK) && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+}
+
+// Microseconds since *start, which is moved up by them so the next call starts from there
+static unsigned int advance(uint32_t *start)
+{
+	unsigned int us = (ulPortGetTimestamp() - *start) / USLEEP_COUNTS_PER_US;
+
+	*start += us * USLEEP_COUNTS_PER_US;
+	return us;
+}
+
+#if defined (__GNUC__) && __GNUC__ >= 4
+int usleep(useconds_t us)
+#else
+unsigned int usleep(unsigned int us)
+#endif
+{
+	uint32_t start = ulPortGetTimestamp();
+	unsigned int elapsed = 0, remaining, chunk;
+
+	// the timestamp difference and us * USLEEP_COUNTS_PER_US wrap after 2^32 counts (43 s at
+	// 100 MHz), so long delays are slept and spun USLEEP_CHUNK_US at a time
+	if (can_sleep()) {
+		while (elapsed < us && us - elapsed > USLEEP_SPIN_MAX_US) {
+			remaining = us - elapsed < USLEEP_CHUNK_US ? us - elapsed : USLEEP_CHUNK_US;
+			vTaskDelay(remaining > USLEEP_TICK_US ? remaining / USLEEP_TICK_US : 1);
+			elapsed += advance(&start);
+		}
+		slept_us += elapsed;
+		us -= elapsed < us ? elapsed : us;
+	}
+	spun_us += us;
+	while (us > 0) {
+		chunk = us < USLEEP_CHUNK_US ? us : USLEEP_CHUNK_US;
+		while (ulPortGetTimestamp() - start < chunk * USLEEP_COUNTS_PER_US) {
+		}
+		start += chunk * USLEEP_COUNTS_PER_US;
+		us -= chunk;
+	}
+	return 0;
+}
+
+void usleep_stats(unsigned int *slept, unsigned int *spun)
+{
+	*slept = slept_us;
+	*spun = spun_us;
+}
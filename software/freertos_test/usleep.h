@@ -0,0 +1,26 @@
+#ifndef USLEEP_H
+#define USLEEP_H
+
+/*
+ * usleep() for the HAL drivers and the application, linked in place of the HAL's alt_busy_sleep()
+ * loop (alt_usleep.c is only pulled from the BSP library when nothing else defines usleep).
+ *
+ * From a task, whole ticks are slept with vTaskDelay() and only the rest is spun on the timestamp.
+ * The first vTaskDelay() tick is a partial one, so a remainder longer than USLEEP_SPIN_MAX_US
+ * sleeps one more tick instead: a delay then overshoots by less than a tick minus
+ * USLEEP_SPIN_MAX_US and never spins longer than USLEEP_SPIN_MAX_US. Before the scheduler starts,
+ * in ISRs and with interrupts held it spins for the whole delay, as the HAL did.
+ *
+ * The CFI flash driver polls erases with usleep(1000) for up to a second per sector, from
+ * Journal_Task. The LCD driver's start up delays run in alt_sys_init, before the scheduler.
+ */
+
+#include "FreeRTOS/FreeRTOS.h"
+
+#define USLEEP_TICK_US (1000000 / configTICK_RATE_HZ)
+#define USLEEP_SPIN_MAX_US (USLEEP_TICK_US / 2)
+
+// Microseconds usleep() has slept and spun since boot, both wrap after about 71 minutes
+void usleep_stats(unsigned int *slept, unsigned int *spun);
+
+#endif /* USLEEP_H */
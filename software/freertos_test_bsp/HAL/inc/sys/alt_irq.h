@@ -238,6 +238,23 @@ static ALT_INLINE alt_u32 ALT_ALWAYS_INLINE alt_irq_pending (void)
 }
 #endif 
 
+/*
+ * alt_irq_set_priority() sets the order in which alt_irq_handler() services
+ * simultaneously pending interrupts, highest priority first. IRQs that are
+ * not listed are serviced after the listed ones, lowest numbered first.
+ * Passing a count of zero restores the default numeric order.
+ */
+#ifndef NIOS2_EIC_PRESENT
+extern void alt_irq_set_priority (const alt_u8* order, alt_u32 count);
+
+/*
+ * Dispatch latency statistics, see alt_irq_handler.c. Measurement is off
+ * until alt_irq_dispatch_timestamp is pointed at a free running counter.
+ */
+extern alt_u32 (*alt_irq_dispatch_timestamp) (void);
+extern volatile alt_u32 alt_irq_dispatch_max[ALT_NIRQ];
+#endif
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -62,6 +62,65 @@ struct ALT_IRQ_HANDLER
   void *context;
 } alt_irq[ALT_NIRQ];
 
+/*
+ * Dispatch order for IRQs 0-7. alt_irq_select[pending & 0xff] is the pending
+ * interrupt to service first, so choosing the next handler is a single table
+ * lookup rather than a bit by bit scan. It defaults to the lowest numbered
+ * pending IRQ first, and is rebuilt from a priority list by
+ * alt_irq_set_priority(). IRQs 8 and up, if any, are scanned in numeric order
+ * after IRQs 0-7.
+ */
+static alt_u8 alt_irq_select[256] = {
+  0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  7, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+  4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+};
+
+/*
+ * Optional dispatch latency statistics. When alt_irq_dispatch_timestamp is
+ * set, alt_irq_dispatch_max[i] records the longest time, in timestamp counts,
+ * from entry to alt_irq_handler() until the handler for IRQ i was called, i.e.
+ * how long IRQ i waited behind the other handlers in the same exception.
+ */
+alt_u32 (*alt_irq_dispatch_timestamp) (void) = 0;
+volatile alt_u32 alt_irq_dispatch_max[ALT_NIRQ];
+
+void alt_irq_set_priority (const alt_u8* order, alt_u32 count)
+{
+  alt_u32 pattern;
+  alt_u32 n;
+  alt_irq_context context = alt_irq_disable_all ();
+
+  for (pattern = 1; pattern < 256; pattern++)
+  {
+    /* first listed IRQ that is pending, or the lowest numbered if none are */
+    alt_irq_select[pattern] = __builtin_ctz (pattern);
+    for (n = 0; n < count; n++)
+    {
+      if (order[n] < 8 && (pattern & (1 << order[n])))
+      {
+        alt_irq_select[pattern] = order[n];
+        break;
+      }
+    }
+  }
+
+  alt_irq_enable_all (context);
+}
+
 /*
  * alt_irq_handler() is called by the interrupt exception handler in order to 
  * process any outstanding interrupts. 
@@ -86,6 +145,7 @@ void alt_irq_handler (void)
   alt_u32 active;
   alt_u32 mask;
   alt_u32 i;
+  alt_u32 entry = 0;
 #endif /* ALT_CI_INTERRUPT_VECTOR */
   
   /*
@@ -125,34 +185,52 @@ void alt_irq_handler (void)
    * this is the case.
    */
 
+  if (alt_irq_dispatch_timestamp)
+  {
+    entry = alt_irq_dispatch_timestamp ();
+  }
+
   active = alt_irq_pending ();
 
   do
   {
-    i = 0;
-    mask = 1;
+    if (active & 0xff)
+    {
+      /* IRQs 0-7: one lookup picks the highest priority pending interrupt */
+      i = alt_irq_select[active & 0xff];
+    }
+    else
+    {
+      /*
+       * Test each bit in turn looking for an active interrupt.
+       */
+      i = 8;
+      mask = 1 << 8;
+      while (!(active & mask))
+      {
+        mask <<= 1;
+        i++;
+      }
+    }
+
+    if (alt_irq_dispatch_timestamp)
+    {
+      alt_u32 waited = alt_irq_dispatch_timestamp () - entry;
+      if (waited > alt_irq_dispatch_max[i])
+      {
+        alt_irq_dispatch_max[i] = waited;
+      }
+    }
 
     /*
-     * Test each bit in turn looking for an active interrupt. Once one is 
-     * found, the interrupt handler asigned by a call to alt_irq_register() is
+     * The interrupt handler asigned by a call to alt_irq_register() is
      * called to clear the interrupt condition.
      */
-
-    do
-    {
-      if (active & mask)
-      { 
 #ifdef ALT_ENHANCED_INTERRUPT_API_PRESENT
-        alt_irq[i].handler(alt_irq[i].context); 
+    alt_irq[i].handler(alt_irq[i].context); 
 #else
-        alt_irq[i].handler(alt_irq[i].context, i); 
+    alt_irq[i].handler(alt_irq[i].context, i); 
 #endif
-        break;
-      }
-      mask <<= 1;
-      i++;
-
-    } while (1);
 
     active = alt_irq_pending ();
     
@@ -0,0 +1,105 @@
+/*
+ * Host benchmark of the per-analyser pipeline (software/freertos_test/freq_channel.c): how many
+ * channels a CPU budget sustains with every channel sampled at mains frequency.
+ *
+ * For each RoC method and channel count it runs the calculation task's work for interleaved
+ * samples, as the single engine task takes them from the analysers: update the sample's channel
+ * and keep the count of unstable channels. Samples are 50 Hz period counts at 16 kHz with a count
+ * of jitter, converted in advance as the analyser ISR does. With many channels their state no
+ * longer fits in the cache, which shows in the time per sample.
+ *
+ * build and run:
+ *   gcc -O2 -I../freertos_test -o channel_bench channel_bench.c ../freertos_test/freq_channel.c ../freertos_test/roc_estimator.c -lm && ./channel_bench [budget %]
+ *
+ * The budget is the share of the CPU the calculation task may use, 50% by default. The target has
+ * no FPU, so its time per sample is far longer than the host's; the relay LOGs its worst case
+ * ("detection worst case", in ulPortGetTimestamp() counts), and the channels it sustains are
+ * budget / (MAINS_HZ * that time).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "freq_channel.h"
+
+#define SAMPLING_FREQ 16000.0
+#define MAINS_HZ 50 // samples per second per channel
+#define FREQ_THRESHOLD 49.0
+#define ROC_THRESHOLD 10.0
+#define MAX_CHANNELS 4096
+#define SAMPLES (1u << 22) // per method and channel count
+#define TRACE 4096 // distinct sample values, a power of two
+
+static freq_channel channels[MAX_CHANNELS];
+static double trace[TRACE];
+static volatile unsigned int sink;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ns per sample of n channels
+static double run(int method, unsigned int n)
+{
+	unsigned int i, ch = 0, unstable = 0;
+	int was_stable;
+	double t;
+
+	for (i = 0; i < n; i++) {
+		freq_channel_init(&channels[i], method, ROC_WINDOW, ROC_IIR_ALPHA);
+	}
+	t = now_ns();
+	for (i = 0; i < SAMPLES; i++) {
+		was_stable = channels[ch].stable;
+		if (freq_channel_update(&channels[ch], trace[(i + ch) & (TRACE - 1)], FREQ_THRESHOLD, ROC_THRESHOLD) != was_stable) {
+			unstable += was_stable ? 1 : -1;
+		}
+		if (++ch == n) {
+			ch = 0;
+		}
+	}
+	t = now_ns() - t;
+	sink = unstable;
+	return t / SAMPLES;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *methods[] = {"two point", "least squares", "iir"};
+	static const unsigned int counts[] = {1, 16, 256, 4096};
+	double budget = argc > 1 ? atof(argv[1]) : 50.0, ns;
+	unsigned int i, c;
+	uint32_t seed = 1;
+	int m;
+
+	if (!(budget > 0.0 && budget <= 100.0)) {
+		fprintf(stderr, "usage: %s [budget %%]\n", argv[0]);
+		return 1;
+	}
+	for (i = 0; i < TRACE; i++) {
+		seed = seed * 1664525 + 1013904223;
+		trace[i] = SAMPLING_FREQ / (320 + (int)(seed >> 30) - 1); // 319 to 322 counts
+	}
+
+	printf("ns per sample, and channels at %d Hz within %.0f%% of the CPU, sizeof(freq_channel) %u\n",
+		MAINS_HZ, budget, (unsigned int)sizeof(freq_channel));
+	printf("  method          ");
+	for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		printf("  %4u ch ns  channels", counts[c]);
+	}
+	printf("\n");
+	for (m = ROC_TWO_POINT; m <= ROC_IIR; m++) {
+		printf("  %-14s  ", methods[m]);
+		for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+			ns = run(m, counts[c]);
+			printf("  %10.1f  %8.0f", ns, budget / 100.0 * 1e9 / (MAINS_HZ * ns));
+		}
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Host benchmark of the remote command channel (software/freertos_test/command.h) over a pty.
+ *
+ * A device thread stands in for the relay: it reads whatever bytes are waiting on the pty master,
+ * as the UART ISR empties the receiver into the RX ring, runs them through the relay's own parser
+ * (command.c) and answers CMD_GET_STATUS with a TLM_RESPONSE record framed as telemetry.c frames
+ * it. It also sends the background telemetry of a running relay, a sample and a roc record every
+ * 20 ms, so the client has to pick its responses out of the stream.
+ *
+ * The client opens the pty slave like a serial port in raw mode and polls the status with 1, 4
+ * and 16 requests in flight, reporting requests per second and the latency distribution. A pty
+ * has no baud rate, so this measures the protocol and host path; the wire limit at 115200 baud
+ * is worked out from the frame sizes and printed alongside.
+ *
+ * build and run:
+ *   gcc -O2 -pthread -I../freertos_test -o cmd_bench cmd_bench.c ../freertos_test/command.c && ./cmd_bench
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "command.h"
+
+#define TLM_SYNC 0xA5
+#define TLM_HEADER_SIZE 9
+#define TLM_SAMPLE 0x01
+#define TLM_ROC 0x02
+#define TLM_RESPONSE 0x05
+#define REQUESTS 20000
+#define BAUD 115200
+#define TELEMETRY_BYTES_PER_S (50 * (TLM_HEADER_SIZE + 4 + 1) + 50 * (TLM_HEADER_SIZE + 9 + 1))
+
+static int master_fd;
+static volatile int stop = 0;
+
+static double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void write_all(int fd, const uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+		if (n <= 0) {
+			continue;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+// As telemetry_put() frames a record
+static size_t frame(uint8_t *out, uint8_t type, uint16_t seq, uint32_t tick, const uint8_t *payload, uint8_t len)
+{
+	uint8_t sum = 0;
+	size_t i, n = 0;
+
+	out[n++] = TLM_SYNC;
+	out[n++] = type;
+	out[n++] = len;
+	cmd_put_u16(out + n, seq);
+	n += 2;
+	cmd_put_u32(out + n, tick);
+	n += 4;
+	memcpy(out + n, payload, len);
+	n += len;
+	for (i = 1; i < n; i++) {
+		sum += out[i];
+	}
+	out[n++] = (uint8_t)(-sum);
+	return n;
+}
+
+static void *device(void *arg)
+{
+	cmd_parser parser;
+	uint8_t in[256], out[128], payload[4 + CMD_MAX_RESPONSE];
+	uint16_t seq = 0;
+	double next_telemetry = now_us();
+	ssize_t n, i;
+
+	(void)arg;
+	cmd_parser_init(&parser);
+	while (!stop) {
+		n = read(master_fd, in, sizeof(in));
+		for (i = 0; i < n; i++) {
+			if (!cmd_parser_feed(&parser, in[i])) {
+				continue;
+			}
+			memset(payload, 0, sizeof(payload));
+			payload[0] = parser.type;
+			cmd_put_u16(payload + 1, parser.seq);
+			payload[3] = parser.type == CMD_GET_STATUS && parser.len == 0 ? CMD_OK : CMD_BAD_REQUEST;
+			cmd_put_f32(payload + 4 + CMD_STATUS_FREQ, 49.98);
+			write_all(master_fd, out, frame(out, TLM_RESPONSE, seq++, 0, payload, 4 + CMD_STATUS_SIZE));
+		}
+		if (now_us() >= next_telemetry) {
+			uint8_t sample[4] = {64, 1, 0, 0}, roc[9] = {0};
+			write_all(master_fd, out, frame(out, TLM_SAMPLE, seq++, 0, sample, sizeof(sample)));
+			write_all(master_fd, out, frame(out, TLM_ROC, seq++, 0, roc, sizeof(roc)));
+			next_telemetry += 20000;
+		}
+	}
+	return NULL;
+}
+
+// Pulls telemetry frames out of the stream, returns the seq of the next response or -1
+typedef struct {
+	uint8_t buf[4096];
+	size_t len;
+} stream;
+
+static int next_response(stream *s)
+{
+	size_t start = 0, end, i;
+	uint8_t sum;
+	int found = -1;
+
+	while (found < 0 && start + TLM_HEADER_SIZE <= s->len) {
+		if (s->buf[start] != TLM_SYNC) {
+			start++;
+			continue;
+		}
+		end = start + TLM_HEADER_SIZE + s->buf[start + 2] + 1;
+		if (end > s->len) {
+			break;
+		}
+		for (i = start + 1, sum = 0; i < end; i++) {
+			sum += s->buf[i];
+		}
+		if (sum != 0) {
+			start++;
+			continue;
+		}
+		if (s->buf[start + 1] == TLM_RESPONSE) {
+			found = cmd_get_u16(s->buf + start + TLM_HEADER_SIZE + 1);
+		}
+		start = end;
+	}
+	memmove(s->buf, s->buf + start, s->len - start);
+	s->len -= start;
+	return found;
+}
+
+static int compare(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void run(int fd, unsigned int window)
+{
+	static double sent_at[65536], latency[REQUESTS];
+	stream s = {{0}, 0};
+	uint8_t req[CMD_HEADER_SIZE + 1];
+	unsigned int sent = 0, done = 0;
+	double t0, elapsed;
+	int seq;
+	ssize_t n;
+
+	t0 = now_us();
+	while (done < REQUESTS) {
+		while (sent < REQUESTS && sent - done < window) {
+			req[0] = CMD_SYNC;
+			req[1] = CMD_GET_STATUS;
+			req[2] = 0;
+			cmd_put_u16(req + 3, sent);
+			req[5] = (uint8_t)(-(req[1] + req[2] + req[3] + req[4]));
+			sent_at[sent & 0xffff] = now_us();
+			write_all(fd, req, sizeof(req));
+			sent++;
+		}
+		n = read(fd, s.buf + s.len, sizeof(s.buf) - s.len);
+		if (n <= 0) {
+			continue;
+		}
+		s.len += n;
+		while ((seq = next_response(&s)) >= 0) {
+			latency[done++] = now_us() - sent_at[seq];
+		}
+	}
+	elapsed = now_us() - t0;
+	qsort(latency, REQUESTS, sizeof(latency[0]), compare);
+	printf("  %6u  %12.0f  %8.1f  %8.1f  %8.1f  %8.1f\n", window, REQUESTS / elapsed * 1e6,
+		latency[REQUESTS / 2], latency[REQUESTS * 99 / 100], latency[REQUESTS * 999 / 1000], latency[REQUESTS - 1]);
+}
+
+int main(void)
+{
+	static const unsigned int windows[] = {1, 4, 16};
+	struct termios tio;
+	pthread_t thread;
+	unsigned int i;
+	int fd;
+	double request_bytes = CMD_HEADER_SIZE + 1, response_bytes = TLM_HEADER_SIZE + 4 + CMD_STATUS_SIZE + 1;
+	double wire_bytes_per_s = BAUD / 10.0, spare = wire_bytes_per_s - TELEMETRY_BYTES_PER_S;
+
+	master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+		perror("pty");
+		return 1;
+	}
+	fd = open(ptsname(master_fd), O_RDWR | O_NOCTTY);
+	if (fd < 0) {
+		perror(ptsname(master_fd));
+		return 1;
+	}
+	tcgetattr(fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(fd, TCSANOW, &tio);
+	pthread_create(&thread, NULL, device, NULL);
+
+	printf("CMD_GET_STATUS over a pty, %d requests, latency in us\n", REQUESTS);
+	printf("  window  requests/s       p50       p99     p99.9       max\n");
+	for (i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+		run(fd, windows[i]);
+	}
+	printf("\non the wire at %d baud: %.0f byte request, %.0f byte response, telemetry uses %d of %.0f bytes/s\n",
+		BAUD, request_bytes, response_bytes, TELEMETRY_BYTES_PER_S, wire_bytes_per_s);
+	printf("  at most %.0f status polls/s, %.2f ms per response on the wire\n", spare / response_bytes, response_bytes / wire_bytes_per_s * 1000);
+
+	stop = 1;
+	write_all(fd, (const uint8_t *)"\0", 1); // wakes the device thread out of read()
+	pthread_join(thread, NULL);
+	return 0;
+}
@@ -0,0 +1,283 @@
+/*
+ * Host benchmark of the flash journal (software/freertos_test/journal.c) on a RAM stand-in for
+ * the CFI flash with NOR rules: erase sets a sector to 0xff, programming can only clear bits.
+ * The geometry is the one shed_journal.c uses, 8 sectors of 64 KB.
+ *
+ *  - write amplification: flash bytes programmed per record byte, and erases per 1000 records,
+ *    when records arrive in bursts (a shed incident) and each burst is flushed, compared with
+ *    saving the statistics by erasing and rewriting a sector on every flush
+ *  - wear: erase count of each sector after the ring has gone round many times
+ *  - recovery: flash reads and time taken by journal_open() against a linear scan of the head
+ *    sector, and records recovered after power cuts that tear a program part way through
+ *
+ * build and run:
+ *   gcc -O2 -I../freertos_test -o journal_bench journal_bench.c ../freertos_test/journal.c && ./journal_bench
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "journal.h"
+
+#define SECTOR_SIZE 65536
+#define SECTORS 8
+#define RECORDS 500000
+#define RECORD_BYTES JOURNAL_DATA_SIZE
+
+typedef struct {
+	uint8_t mem[SECTORS * SECTOR_SIZE];
+	unsigned long long programmed; // bytes
+	unsigned long long reads;
+	unsigned long long read_bytes;
+	unsigned int erases[SECTORS];
+	unsigned int bad_programs; // tried to set a bit back to 1
+	long tear_at; // program byte count after which the power is cut, -1 never
+} ram_flash;
+
+static ram_flash ram;
+
+static int ram_read(void *ctx, unsigned int offset, void *dst, unsigned int len)
+{
+	ram_flash *f = ctx;
+	memcpy(dst, f->mem + offset, len);
+	f->reads++;
+	f->read_bytes += len;
+	return 0;
+}
+
+static int ram_program(void *ctx, unsigned int offset, const void *src, unsigned int len)
+{
+	ram_flash *f = ctx;
+	const uint8_t *p = src;
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		if (f->tear_at == 0) {
+			return 1;
+		}
+		if (f->tear_at > 0) {
+			f->tear_at--;
+		}
+		if (p[i] & ~f->mem[offset + i]) {
+			f->bad_programs++;
+		}
+		f->mem[offset + i] &= p[i];
+		f->programmed++;
+	}
+	return 0;
+}
+
+static int ram_erase(void *ctx, unsigned int offset)
+{
+	ram_flash *f = ctx;
+	if (f->tear_at == 0) {
+		return 1;
+	}
+	memset(f->mem + offset, 0xff, SECTOR_SIZE);
+	f->erases[offset / SECTOR_SIZE]++;
+	return 0;
+}
+
+static const journal_flash flash = {ram_read, ram_program, ram_erase, &ram, SECTOR_SIZE, SECTORS};
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void ram_reset(void)
+{
+	memset(&ram, 0, sizeof(ram));
+	memset(ram.mem, 0xff, sizeof(ram.mem));
+	ram.tear_at = -1;
+}
+
+static void make_record(uint8_t *r, uint32_t n)
+{
+	memset(r, 0, RECORD_BYTES);
+	memcpy(r, &n, sizeof(n));
+	r[RECORD_BYTES - 1] = n & 0x7f; // never all 0xff
+}
+
+// Appends RECORDS records, flushing after every burst of them
+static void fill(journal *j, unsigned int burst)
+{
+	uint8_t r[RECORD_BYTES];
+	uint32_t n;
+
+	for (n = 0; n < RECORDS; n++) {
+		make_record(r, n);
+		journal_append(j, r);
+		if ((n + 1) % burst == 0) {
+			journal_flush(j);
+		}
+	}
+	journal_flush(j);
+}
+
+static void write_amplification(void)
+{
+	static const unsigned int bursts[] = {1, 4, 10, 16, 64};
+	unsigned int i, s, min, max, total;
+	journal j;
+
+	printf("write amplification, %d records of %d bytes\n", RECORDS, RECORD_BYTES);
+	printf("  burst  journal bytes/byte  erases/1000  sector erases  |  rewrite erases/1000\n");
+	for (i = 0; i < sizeof(bursts) / sizeof(bursts[0]); i++) {
+		ram_reset();
+		journal_open(&j, &flash);
+		fill(&j, bursts[i]);
+		for (s = 0, min = ~0u, max = 0; s < SECTORS; s++) {
+			min = ram.erases[s] < min ? ram.erases[s] : min;
+			max = ram.erases[s] > max ? ram.erases[s] : max;
+		}
+		for (s = 0, total = 0; s < SECTORS; s++) {
+			total += ram.erases[s];
+		}
+		printf("  %5u  %18.3f  %11.3f  %8u..%-4u  |  %19.1f\n", bursts[i],
+			(double)ram.programmed / ((double)RECORDS * RECORD_BYTES), 1000.0 * total / RECORDS, min, max, 1000.0 / bursts[i]);
+		if (ram.bad_programs) {
+			printf("  %u programs tried to set bits\n", ram.bad_programs);
+		}
+	}
+}
+
+static int first_record(void *ctx, const void *data)
+{
+	memcpy(ctx, data, sizeof(uint32_t));
+	return 1;
+}
+
+static int newest_first(void *ctx, const void *data)
+{
+	uint32_t *expect = ctx, n;
+	memcpy(&n, data, sizeof(n));
+	if (*expect != UINT32_MAX && n != *expect) {
+		printf("  walk found record %u, expected %u\n", n, *expect);
+		return 1;
+	}
+	*expect = n - 1;
+	return 0;
+}
+
+static void recovery(void)
+{
+	static const unsigned int fills[] = {1, 100, 2000, 4094, 20000, 200000};
+	uint8_t r[RECORD_BYTES];
+	unsigned int i, n, k;
+	journal writer, reader;
+	double t0, open_ns, scan_ns;
+	unsigned long long open_reads;
+
+	printf("\nrecovery, %d sectors of %d slots\n", SECTORS, SECTOR_SIZE / JOURNAL_SLOT_SIZE);
+	printf("  records  open reads  open us  |  scan reads  scan us\n");
+	for (i = 0; i < sizeof(fills) / sizeof(fills[0]); i++) {
+		ram_reset();
+		journal_open(&writer, &flash);
+		for (n = 0; n < fills[i]; n++) {
+			make_record(r, n);
+			journal_append(&writer, r);
+		}
+		journal_flush(&writer);
+
+		ram.reads = 0;
+		t0 = now_ns();
+		for (k = 0; k < 1000; k++) {
+			journal_open(&reader, &flash);
+		}
+		open_ns = (now_ns() - t0) / 1000;
+		open_reads = ram.reads / 1000;
+		if (reader.head != writer.head || reader.next_slot != writer.next_slot || reader.seq != writer.seq) {
+			printf("  reopened at sector %u slot %u, writer at sector %u slot %u\n", reader.head, reader.next_slot, writer.head, writer.next_slot);
+		}
+
+		// what a scan for the first erased slot of every sector would read instead
+		ram.reads = 0;
+		t0 = now_ns();
+		for (k = 0; k < 1000; k++) {
+			unsigned int s, slot;
+			uint8_t buf[JOURNAL_SLOT_SIZE];
+			for (s = 0; s < SECTORS; s++) {
+				for (slot = 0; slot < SECTOR_SIZE / JOURNAL_SLOT_SIZE; slot++) {
+					ram_read(&ram, s * SECTOR_SIZE + slot * JOURNAL_SLOT_SIZE, buf, sizeof(buf));
+					if (buf[0] == 0xff && buf[JOURNAL_SLOT_SIZE - 1] == 0xff) {
+						break;
+					}
+				}
+			}
+		}
+		scan_ns = (now_ns() - t0) / 1000;
+		printf("  %7u  %10llu  %7.2f  |  %10llu  %7.2f\n", fills[i], open_reads, open_ns / 1000, ram.reads / 1000, scan_ns / 1000);
+	}
+}
+
+// Cuts the power at random points of a program or erase, reopens and checks that the records
+// are found newest first with no gaps, that only the cut batch lost records, and that appends
+// after the cut never program over written bits
+static void power_cuts(void)
+{
+	const unsigned int capacity = (SECTORS - 1) * (SECTOR_SIZE / JOURNAL_SLOT_SIZE - 1);
+	uint8_t r[RECORD_BYTES];
+	unsigned int trial, n, found, bad = 0, cut_lost = 0;
+	uint32_t written, newest, expect;
+	journal j;
+
+	srand(1);
+	for (trial = 0; trial < 1000; trial++) {
+		written = 1 + rand() % 60000;
+		ram_reset();
+		journal_open(&j, &flash);
+		for (n = 0; n < written; n++) {
+			make_record(r, n);
+			journal_append(&j, r);
+		}
+		journal_flush(&j);
+
+		// the next batch is cut part way through, which may be the erase of the next sector
+		ram.tear_at = rand() % (JOURNAL_BATCH * JOURNAL_SLOT_SIZE);
+		for (n = 0; n < JOURNAL_BATCH; n++) {
+			make_record(r, written + n);
+			journal_append(&j, r);
+		}
+		journal_flush(&j);
+		ram.tear_at = -1;
+
+		journal_open(&j, &flash);
+		newest = 0;
+		journal_walk(&j, first_record, &newest);
+		expect = UINT32_MAX;
+		found = journal_walk(&j, newest_first, &expect);
+		if (expect != UINT32_MAX && (found < written && found < capacity)) {
+			printf("  trial %u: %u of %u records found\n", trial, found, written);
+			bad++;
+		}
+		if (newest + 1 < written) {
+			printf("  trial %u: newest record %u, %u were flushed before the cut\n", trial, newest, written);
+			bad++;
+		}
+		cut_lost += written + JOURNAL_BATCH - 1 - newest;
+
+		// the reopened journal carries on after the torn slots
+		make_record(r, written + JOURNAL_BATCH);
+		journal_append(&j, r);
+		journal_flush(&j);
+		if (ram.bad_programs) {
+			printf("  trial %u: append after the cut programmed over written bits\n", trial);
+			bad++;
+		}
+	}
+	printf("\npower cuts: 1000 trials, %u failures, %.1f of the %d records in the cut batch lost on average\n", bad, (double)cut_lost / 1000, JOURNAL_BATCH);
+}
+
+int main(void)
+{
+	write_amplification();
+	recovery();
+	power_cuts();
+	return 0;
+}
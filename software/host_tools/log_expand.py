@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Re-expand the deferred log records written by Log_Drain_Task (software/freertos_test/log.h).
+
+The target prints lines of hex words on the JTAG UART:
+    #L <fmt id> <tick> <arg words>...   a LOG() record, fmt id is the address of the format string
+    #D <dropped> <truncated>            records dropped, and records that lost arguments, so far
+Profiler lines (#P, #T, #Q, see profile_fold.py) are skipped and every other line (plain printf
+output) is passed through unchanged.
+
+usage:
+    nios2-terminal | log_expand.py freertos_test.elf
+    log_expand.py freertos_test.elf capture.txt
+"""
+
+import re
+import struct
+import sys
+
+from nios2_elf import Elf
+
+SPEC = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|L|j|z|t)?([diouxXcpsfeEgGaA%])")
+
+
+def to_signed(v, bits):
+    return v - (1 << bits) if v & (1 << (bits - 1)) else v
+
+
+def expand(elf, fmt, words):
+    words = list(words)
+
+    def take():
+        return words.pop(0) if words else None
+
+    def convert(m):
+        flags, width, prec, length, conv = m.groups()
+        if conv == "%":
+            return "%"
+        if width == "*":
+            w = take()
+            width = str(to_signed(w, 32)) if w is not None else ""
+        if prec == "*":
+            p = take()
+            prec = str(to_signed(p, 32)) if p is not None else ""
+        spec = "%" + flags + (width or "") + ("." + prec if prec else "")
+        wide = conv in "feEgGaA" or length == "ll"
+        lo = take()
+        hi = take() if wide else 0
+        if lo is None or hi is None:
+            return "<?>"  # the record ran out of argument words
+        if conv in "feEgGaA":
+            (d,) = struct.unpack("<d", struct.pack("<II", lo, hi))
+            return (spec + ("f" if conv in "aA" else conv)) % d
+        value = lo | (hi << 32)
+        bits = 64 if wide else 32
+        if conv in "di":
+            return (spec + "d") % to_signed(value, bits)
+        if conv == "u":
+            return (spec + "d") % value
+        if conv in "oxX":
+            return (spec + conv) % value
+        if conv == "c":
+            return (spec + "c") % chr(value & 0xFF)
+        if conv == "p":
+            return (spec + "s") % ("0x%08x" % value)
+        s = elf.cstring(value)
+        return (spec + "s") % (s if s is not None else "<str@0x%08x>" % value)
+
+    return SPEC.sub(convert, fmt)
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write("usage: %s <elf> [capture]\n" % argv[0])
+        return 2
+    elf = Elf(argv[1])
+    stream = open(argv[2], "r", errors="replace") if len(argv) == 3 else sys.stdin
+    for line in stream:
+        if line.startswith("#L "):
+            try:
+                words = [int(w, 16) for w in line.split()[1:]]
+            except ValueError:
+                sys.stdout.write(line)
+                continue
+            fmt = elf.cstring(words[0]) if words else None
+            if fmt is None or len(words) < 2:
+                sys.stdout.write("[?] unknown log record: %s" % line)
+                continue
+            sys.stdout.write("[%10d] %s" % (words[1], expand(elf, fmt, words[2:])))
+            if not fmt.endswith("\n"):
+                sys.stdout.write("\n")
+        elif line.startswith("#D "):
+            counts = [int(w, 16) for w in line.split()[1:3]]
+            sys.stdout.write("[log] %d records dropped so far" % counts[0])
+            if len(counts) > 1 and counts[1]:
+                sys.stdout.write(", %d cut short at LOG_MAX_ARG_WORDS" % counts[1])
+            sys.stdout.write("\n")
+        elif line[:3] in ("#P ", "#T ", "#Q "):
+            continue  # profiler samples, for profile_fold.py
+        else:
+            sys.stdout.write(line)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
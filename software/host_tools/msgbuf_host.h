@@ -0,0 +1,72 @@
+/*
+ * Stand-ins for the kernel and Altera definitions used by
+ * software/freertos_test/msgbuf.c, so msgbuf_bench.c can build it on the host.
+ * The benchmark runs producer and consumer in one thread, so holding interrupts
+ * is a no-op and the consumer never has to wait.
+ */
+
+#ifndef MSGBUF_HOST_H
+#define MSGBUF_HOST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t alt_u32;
+typedef int alt_irq_context;
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef void *TaskHandle_t;
+typedef struct {
+	TickType_t entered;
+} TimeOut_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+
+static inline alt_irq_context alt_irq_disable_all(void)
+{
+	return 0;
+}
+
+static inline void alt_irq_enable_all(alt_irq_context context)
+{
+	(void)context;
+}
+
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return NULL;
+}
+
+static inline void vTaskSetTimeOutState(TimeOut_t *timeout)
+{
+	timeout->entered = 0;
+}
+
+static inline BaseType_t xTaskCheckForTimeOut(TimeOut_t *timeout, TickType_t *remaining)
+{
+	(void)timeout;
+	(void)remaining;
+	return pdTRUE;
+}
+
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout)
+{
+	(void)clear;
+	(void)timeout;
+	return 0;
+}
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+	(void)task;
+	return pdTRUE;
+}
+
+static inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_prio_woken)
+{
+	(void)task;
+	(void)higher_prio_woken;
+}
+
+#endif /* MSGBUF_HOST_H */
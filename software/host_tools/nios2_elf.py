@@ -0,0 +1,66 @@
+"""Minimal reader for the 32-bit little-endian ELF images produced by nios2-elf-gcc.
+
+Only what the host tools need: reading bytes and C strings at a target address and looking up the
+function containing an address, so there is no dependency on binutils or third party ELF packages.
+"""
+
+import bisect
+import struct
+
+
+class Elf(object):
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError("%s is not a 32-bit little-endian ELF file" % path)
+        (shoff,) = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            name, stype, flags, addr, offset, size, link = struct.unpack_from("<IIIIIII", self.data, shoff + i * shentsize)
+            self.sections.append([name, stype, flags, addr, offset, size, link])
+        names_offset = self.sections[shstrndx][4]
+        for sec in self.sections:
+            sec[0] = self._cstring_at(names_offset + sec[0])
+        self._functions = None
+
+    def _cstring_at(self, offset):
+        end = self.data.index(b"\0", offset)
+        return self.data[offset:end].decode("latin-1")
+
+    def _offset_of(self, addr):
+        for name, stype, flags, sec_addr, offset, size, link in self.sections:
+            # SHT_NOBITS (8) sections such as .bss have no file contents
+            if stype != 8 and (flags & 0x2) and sec_addr <= addr < sec_addr + size:
+                return offset + addr - sec_addr
+        return None
+
+    def cstring(self, addr):
+        """Returns the NUL terminated string at a target address, or None if it is not in the image."""
+        offset = self._offset_of(addr)
+        return None if offset is None else self._cstring_at(offset)
+
+    def _load_functions(self):
+        funcs = []
+        for name, stype, flags, addr, offset, size, link in self.sections:
+            if stype != 2:  # SHT_SYMTAB
+                continue
+            strtab = self.sections[link][4]
+            for entry in range(offset, offset + size, 16):
+                st_name, value, st_size, info = struct.unpack_from("<IIIB", self.data, entry)
+                if info & 0xF == 2 and st_size > 0:  # STT_FUNC
+                    funcs.append((value, st_size, self._cstring_at(strtab + st_name)))
+        funcs.sort()
+        self._functions = funcs
+        self._starts = [f[0] for f in funcs]
+
+    def function_at(self, addr):
+        """Returns the name of the function containing a target address, or None."""
+        if self._functions is None:
+            self._load_functions()
+        i = bisect.bisect_right(self._starts, addr) - 1
+        if i < 0:
+            return None
+        start, size, name = self._functions[i]
+        return name if addr < start + size else None
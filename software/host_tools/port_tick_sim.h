@@ -0,0 +1,70 @@
+/*
+ * Stand-ins for the kernel and Altera definitions used by
+ * software/freertos_test/freertos/port_tick.c, so tickless_sim.c can build it
+ * on the host against a simulated Avalon interval timer.
+ */
+
+#ifndef PORT_TICK_SIM_H
+#define PORT_TICK_SIM_H
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef int alt_irq_context;
+
+#define pdFALSE 0
+#define pdTRUE 1
+
+#define configUSE_TICKLESS_IDLE 1
+#define configTICK_RATE_HZ 1000
+
+#define portTICK_TIMER_BASE 0
+#define portTICK_TIMER_FREQ 100000000
+
+typedef enum {
+	eAbortSleep = 0,
+	eStandardSleep,
+	eNoTasksWaitingTimeout
+} eSleepModeStatus;
+
+// simulated kernel, tickless_sim.c
+TickType_t xTaskGetTickCountFromISR(void);
+eSleepModeStatus eTaskConfirmSleepModeStatus(void);
+void vTaskStepTick(const TickType_t xTicksToJump);
+
+// simulated CPU interrupt enable, tickless_sim.c
+alt_irq_context alt_irq_disable_all(void);
+void alt_irq_enable_all(alt_irq_context context);
+
+// simulated Avalon interval timer registers, tickless_sim.c
+uint32_t sim_timer_read(int reg);
+void sim_timer_write(int reg, uint32_t data);
+void sim_sleep_poll(void);
+
+#define portTICK_SLEEP_POLL() sim_sleep_poll()
+
+#define ALTERA_AVALON_TIMER_STATUS_REG 0
+#define ALTERA_AVALON_TIMER_CONTROL_REG 1
+#define ALTERA_AVALON_TIMER_PERIODL_REG 2
+#define ALTERA_AVALON_TIMER_PERIODH_REG 3
+#define ALTERA_AVALON_TIMER_SNAPL_REG 4
+#define ALTERA_AVALON_TIMER_SNAPH_REG 5
+
+#define ALTERA_AVALON_TIMER_STATUS_TO_MSK 0x1
+#define ALTERA_AVALON_TIMER_STATUS_RUN_MSK 0x2
+#define ALTERA_AVALON_TIMER_CONTROL_ITO_MSK 0x1
+#define ALTERA_AVALON_TIMER_CONTROL_CONT_MSK 0x2
+#define ALTERA_AVALON_TIMER_CONTROL_START_MSK 0x4
+#define ALTERA_AVALON_TIMER_CONTROL_STOP_MSK 0x8
+
+#define IORD_ALTERA_AVALON_TIMER_STATUS(base) sim_timer_read(ALTERA_AVALON_TIMER_STATUS_REG)
+#define IOWR_ALTERA_AVALON_TIMER_STATUS(base, data) sim_timer_write(ALTERA_AVALON_TIMER_STATUS_REG, data)
+#define IOWR_ALTERA_AVALON_TIMER_CONTROL(base, data) sim_timer_write(ALTERA_AVALON_TIMER_CONTROL_REG, data)
+#define IOWR_ALTERA_AVALON_TIMER_PERIODL(base, data) sim_timer_write(ALTERA_AVALON_TIMER_PERIODL_REG, data)
+#define IOWR_ALTERA_AVALON_TIMER_PERIODH(base, data) sim_timer_write(ALTERA_AVALON_TIMER_PERIODH_REG, data)
+#define IORD_ALTERA_AVALON_TIMER_SNAPL(base) sim_timer_read(ALTERA_AVALON_TIMER_SNAPL_REG)
+#define IORD_ALTERA_AVALON_TIMER_SNAPH(base) sim_timer_read(ALTERA_AVALON_TIMER_SNAPH_REG)
+#define IOWR_ALTERA_AVALON_TIMER_SNAPL(base, data) sim_timer_write(ALTERA_AVALON_TIMER_SNAPL_REG, data)
+
+#endif /* PORT_TICK_SIM_H */
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Fold the profiler samples streamed by Profile_Task (software/freertos_test/profiler.h).
+
+The target prints lines of hex words on the JTAG UART, mixed with the log:
+    #P <task> <pc> <ra>    a sample, task is the TCB address
+    #T <task> <name>       the name of a task, sent the first time it is seen
+    #Q <count>             the number of samples dropped so far
+pc and ra are resolved to functions with the ELF symbol table. ra is only taken as the caller
+when it lies in a different function than pc; once a function has made a call, ra points back
+into itself and the caller is unknown.
+
+The output is folded stacks, one "task;caller;function count" line per distinct stack, for
+flamegraph.pl. With --task only that task's samples are folded, without the task frame, which
+gives one flame graph per task. With --top N it prints each task's N hottest functions instead.
+
+usage:
+    nios2-terminal | tee capture.txt | log_expand.py freertos_test.elf
+    profile_fold.py freertos_test.elf capture.txt | flamegraph.pl > all.svg
+    profile_fold.py --task FSM_Tas freertos_test.elf capture.txt | flamegraph.pl > fsm.svg
+    profile_fold.py --top 10 freertos_test.elf capture.txt
+Task names are cut to configMAX_TASK_NAME_LEN - 1 characters on the target.
+"""
+
+import collections
+import sys
+
+from nios2_elf import Elf
+
+
+def usage(prog):
+    sys.stderr.write("usage: %s [--task name | --top n] <elf> [capture]\n" % prog)
+    return 2
+
+
+def main(argv):
+    args = argv[1:]
+    task_filter, top = None, 0
+    while args and args[0].startswith("--"):
+        if len(args) < 2 or args[0] not in ("--task", "--top"):
+            return usage(argv[0])
+        if args[0] == "--task":
+            task_filter = args[1]
+        else:
+            top = int(args[1])
+        args = args[2:]
+    if len(args) not in (1, 2):
+        return usage(argv[0])
+    elf = Elf(args[0])
+    stream = open(args[1], "r", errors="replace") if len(args) == 2 else sys.stdin
+
+    names = {}
+    stacks = collections.Counter()
+    dropped = 0
+
+    def function(addr):
+        name = elf.function_at(addr)
+        return name if name is not None else "0x%08x" % addr
+
+    for line in stream:
+        fields = line.split()
+        try:
+            if line.startswith("#P ") and len(fields) == 4:
+                task, pc, ra = (int(w, 16) for w in fields[1:])
+                stacks[(task, function(pc), function(ra))] += 1
+            elif line.startswith("#T ") and len(fields) >= 2:
+                names[int(fields[1], 16)] = " ".join(fields[2:]) or "?"
+            elif line.startswith("#Q ") and len(fields) == 2:
+                dropped = int(fields[1], 16)
+        except ValueError:
+            continue  # a line cut short by the capture starting or stopping
+
+    def task_name(task):
+        return names.get(task, "task@0x%08x" % task)
+
+    by_task = collections.defaultdict(collections.Counter)
+    for (task, func, caller), count in stacks.items():
+        frames = [func] if caller == func else [caller, func]
+        by_task[task_name(task)][tuple(frames)] += count
+
+    total = sum(stacks.values())
+    if top:
+        for name, folded in sorted(by_task.items(), key=lambda kv: -sum(kv[1].values())):
+            samples = sum(folded.values())
+            self_time = collections.Counter()
+            for frames, count in folded.items():
+                self_time[frames[-1]] += count
+            print("%s: %d samples, %.1f%% of all" % (name, samples, 100.0 * samples / total))
+            for func, count in self_time.most_common(top):
+                print("  %6.1f%%  %s" % (100.0 * count / samples, func))
+    else:
+        for name, folded in sorted(by_task.items()):
+            if task_filter is not None and name != task_filter:
+                continue
+            for frames, count in sorted(folded.items()):
+                root = [] if task_filter is not None else [name]
+                print("%s %d" % (";".join(root + list(frames)), count))
+    sys.stderr.write("%d samples, %d dropped on the target\n" % (total, dropped))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
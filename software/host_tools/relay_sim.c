@@ -0,0 +1,675 @@
+/*
+ * Discrete-event simulation of the relay on a virtual clock, for days of grid behaviour in
+ * seconds.
+ *
+ * The relay's own detection and load management code (roc_estimator.c, freq_channel.c and
+ * load_fsm.c) runs unchanged under a model of the kernel and the interrupts that drive it:
+ *   analyser interrupt      one per mains cycle, after the cycle's period count at 16 kHz
+ *   ROC_Calculation_Task    priority 4, takes each sample from the queue, ROC_CLOCKS per sample
+ *   Load_Management_Task    priority 3, ulTaskNotifyTake(pdTRUE, 5) then a pass, FSM_CLOCKS
+ *   deadline (deadline.c)   one-shot, TIMER_PERIOD_MS after deadline_arm(), notifies the FSM task
+ *   button                  maintenance mode toggled by the push button ISR
+ * on one CPU at 100 MHz with priority preemption. The lower priority tasks cannot delay these
+ * two and are not modelled. Time is in CPU clocks and jumps from one event to the next, the
+ * FreeRTOS tick included: tick n is at n ms, and task timeouts are posted for the tick they end
+ * on rather than counted down by tick interrupts. The FSM task's passes in normal operation with
+ * the system stable do nothing, so it is parked instead of woken every 5 ms, and woken on the
+ * tick its next pass would have run on as soon as something it reads changes.
+ *
+ * The grid is 50 Hz with slow drift, a count of jitter, the odd glitched cycle and, at random
+ * (mean every -e minutes), a disturbance: a ramp down at 1 to 25 Hz/s, or one time in four a
+ * step, 0.2 to 2.5 Hz deep, held 0.5 to 10 s, then back at the same rate. An operator flips a
+ * random load switch every -o hours on average and takes the relay into maintenance for 15 minutes
+ * every day at 02:00. Everything is drawn from one seeded generator and simultaneous events are
+ * taken in the order they were posted, so a seed always gives the same schedule; the hash of every
+ * dispatched event is printed to compare runs, and -c runs the scenario twice and checks it.
+ *
+ * It reports the relay's behaviour (sheds, initial shed times against the 200 ms requirement,
+ * false trips, missed disturbances, time in each state) and the simulated time against the wall
+ * clock time it took.
+ *
+ * build and run:
+ *   gcc -O2 -I../freertos_test -o relay_sim relay_sim.c ../freertos_test/load_fsm.c ../freertos_test/freq_channel.c ../freertos_test/roc_estimator.c -lm && ./relay_sim
+ *
+ * options: -d days (3), -s seed, -f Hz (49.5), -r Hz/s (10), -p deadline ms (500), -e minutes
+ * between disturbances (30), -o hours between switch flips (2), -v to print state transitions,
+ * -c to check the schedule is reproducible. The relay ships with 50 Hz, which trips on a count of
+ * jitter; threshold_sweep.c ranks the alternatives.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freq_channel.h"
+#include "load_fsm.h"
+
+#define CPU_HZ 100000000ULL
+#define CLOCKS_PER_TICK (CPU_HZ / 1000) // configTICK_RATE_HZ
+#define CLOCKS_PER_COUNT (CPU_HZ / 16000) // analyser counts
+#define SAMPLING_FREQ 16000.0
+#define ISR_CLOCKS 200 // an interrupt, entry to exit
+#define ROC_CLOCKS 10000 // calculation task per sample, soft-float, enough for least squares
+#define FSM_CLOCKS 2000 // FSM task per pass
+#define FSM_TIMEOUT_TICKS 5
+#define HW_DATA_QUEUE_SIZE 100
+#define SHED_LIMIT_MS 200
+#define ALL_SWITCHES ((1u << LOAD_FSM_LOADS) - 1)
+#define HEAP_SIZE 64 // cancelled events stay queued until their time
+#define MAINTENANCE_AT (2 * 3600 * CPU_HZ) // into the day
+#define MAINTENANCE_CLOCKS (15 * 60 * CPU_HZ)
+#define DAY_CLOCKS (86400 * CPU_HZ)
+#define TRIP_GRACE_CLOCKS (2 * CPU_HZ) // a trip this soon after a disturbance is not false
+
+typedef unsigned long long clocks_t;
+
+enum {EV_ANALYSER, EV_DEADLINE, EV_FSM_TIMEOUT, EV_BURST_END, EV_SWITCH, EV_BUTTON};
+enum {TASK_ROC, TASK_FSM, TASKS}; // highest priority first
+
+typedef struct {
+	clocks_t time;
+	unsigned long long seq; // ties are taken in the order they were posted
+	int type;
+	unsigned int gen; // stale if it no longer matches its source's
+} event;
+
+typedef struct {
+	double freq_threshold;
+	double roc_threshold;
+	unsigned int period_ms;
+	double days;
+	double disturbance_minutes;
+	double switch_hours;
+	unsigned long long seed;
+	int verbose;
+} options;
+
+typedef struct {
+	// event queue
+	event heap[HEAP_SIZE];
+	unsigned int heap_n;
+	unsigned long long seq;
+	clocks_t now;
+	uint64_t hash;
+	unsigned long long events;
+	// CPU
+	int running; // task, -1 idle
+	int ready[TASKS];
+	clocks_t left[TASKS]; // work left in the current burst
+	clocks_t burst_start;
+	clocks_t isr_debt; // interrupt time, charged to the next task to run
+	unsigned int burst_gen;
+	// calculation task and its queue
+	uint32_t queue[HW_DATA_QUEUE_SIZE];
+	clocks_t queued_at[HW_DATA_QUEUE_SIZE];
+	unsigned int q_head, q_count;
+	freq_channel channel;
+	int system_stable;
+	unsigned long long time_before_shed; // tick
+	unsigned long long shed_from; // time_before_shed of the initial shed, while no load is off yet
+	int shed_pending;
+	// FSM task and deadline
+	load_fsm fsm;
+	state prev_state; // button_irq's
+	unsigned int switches;
+	int notified;
+	int parked;
+	unsigned int presses;
+	unsigned long long park_tick;
+	unsigned int timeout_gen;
+	unsigned int deadline_gen;
+	int deadline_expired;
+	// grid
+	uint64_t rng;
+	double drift;
+	double dip; // Hz below nominal
+	int phase; // 0 quiet, 1 down, 2 hold, 3 up
+	double rate, depth;
+	clocks_t hold_end, next_disturbance, disturbance_end;
+	int seen; // the relay left normal operation during this disturbance
+	// results
+	unsigned long long samples, dropped, passes;
+	unsigned long long disturbances, missed, false_trips;
+	unsigned long long initial_sheds, sheds, reconnects, over_limit;
+	unsigned long long shed_ms_min, shed_ms_max, shed_ms_sum;
+	clocks_t detect_worst;
+	clocks_t in_state[4];
+	clocks_t state_since;
+	state reported_state;
+} simulation;
+
+static simulation s;
+static options opt;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ------------------------------------------------------------------ event queue
+
+static int earlier(const event *a, const event *b)
+{
+	return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void post(clocks_t time, int type, unsigned int gen)
+{
+	unsigned int i = s.heap_n++, parent;
+	event e;
+
+	if (s.heap_n > HEAP_SIZE) {
+		fprintf(stderr, "event queue overflow\n");
+		exit(1);
+	}
+	e.time = time;
+	e.seq = s.seq++;
+	e.type = type;
+	e.gen = gen;
+	for (; i > 0 && earlier(&e, &s.heap[parent = (i - 1) / 2]); i = parent) {
+		s.heap[i] = s.heap[parent];
+	}
+	s.heap[i] = e;
+}
+
+static event pop(void)
+{
+	event top = s.heap[0], last = s.heap[--s.heap_n];
+	unsigned int i = 0, child;
+
+	while ((child = 2 * i + 1) < s.heap_n) {
+		if (child + 1 < s.heap_n && earlier(&s.heap[child + 1], &s.heap[child])) {
+			child++;
+		}
+		if (!earlier(&s.heap[child], &last)) {
+			break;
+		}
+		s.heap[i] = s.heap[child];
+		i = child;
+	}
+	s.heap[i] = last;
+	return top;
+}
+
+// ------------------------------------------------------------------ random numbers
+
+static double uniform(void)
+{
+	s.rng ^= s.rng >> 12;
+	s.rng ^= s.rng << 25;
+	s.rng ^= s.rng >> 27;
+	return ((s.rng * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian(void)
+{
+	double u = uniform() + 1e-12, v = uniform();
+	return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static clocks_t exponential(double mean_seconds)
+{
+	return (clocks_t)(-log(1.0 - uniform()) * mean_seconds * CPU_HZ) + 1;
+}
+
+// ------------------------------------------------------------------ CPU
+
+static unsigned long long tick(void)
+{
+	return s.now / CLOCKS_PER_TICK;
+}
+
+// Takes the CPU off the running task, keeping what is left of its burst
+static void cpu_stop(void)
+{
+	if (s.running >= 0) {
+		s.left[s.running] -= s.now - s.burst_start;
+		s.running = -1;
+		s.burst_gen++;
+	}
+}
+
+// Gives the CPU to the highest priority ready task
+static void cpu_dispatch(void)
+{
+	int t;
+
+	for (t = 0; t < TASKS && !s.ready[t]; t++) {
+	}
+	if (t == TASKS) {
+		s.isr_debt = 0; // taken while idle
+		return;
+	}
+	s.left[t] += s.isr_debt;
+	s.isr_debt = 0;
+	s.running = t;
+	s.burst_start = s.now;
+	post(s.now + s.left[t], EV_BURST_END, ++s.burst_gen);
+}
+
+static void make_ready(int t, clocks_t cost)
+{
+	if (!s.ready[t]) {
+		s.ready[t] = 1;
+		s.left[t] = cost;
+	}
+}
+
+// ------------------------------------------------------------------ relay
+
+static const char *state_names[] = {"Normal", "Shed, stable", "Shed, unstable", "Maintenance"};
+
+static void note_state(void)
+{
+	if (s.fsm.state == s.reported_state) {
+		return;
+	}
+	s.in_state[s.reported_state] += s.now - s.state_since;
+	s.state_since = s.now;
+	if (opt.verbose) {
+		unsigned long long ms = s.now / (CPU_HZ / 1000);
+		printf("%llud %02llu:%02llu:%02llu.%03llu  %s -> %s\n", ms / 86400000, ms / 3600000 % 24, ms / 60000 % 60,
+			ms / 1000 % 60, ms % 1000, state_names[s.reported_state], state_names[s.fsm.state]);
+	}
+	s.reported_state = s.fsm.state;
+}
+
+// Something the FSM task reads changed at since, when the CPU was taken from whatever ran. A parked
+// task is woken when its next pass would have run, or now if that pass would still be under way
+static void fsm_poke(clocks_t since)
+{
+	unsigned long long k = (tick() - s.park_tick) / FSM_TIMEOUT_TICKS;
+	clocks_t last = (s.park_tick + k * FSM_TIMEOUT_TICKS) * CLOCKS_PER_TICK;
+
+	if (!s.parked) {
+		return;
+	}
+	s.parked = 0;
+	if (k > 0 && last + FSM_CLOCKS > since) {
+		s.ready[TASK_FSM] = 1;
+		s.left[TASK_FSM] = FSM_CLOCKS - (since > last ? since - last : 0);
+		return;
+	}
+	post((s.park_tick + (k + 1) * FSM_TIMEOUT_TICKS) * CLOCKS_PER_TICK, EV_FSM_TIMEOUT, ++s.timeout_gen);
+}
+
+// vTaskNotifyGiveFromISR
+static void fsm_notify(void)
+{
+	if (s.ready[TASK_FSM]) {
+		s.notified = 1;
+		return;
+	}
+	s.parked = 0;
+	s.timeout_gen++;
+	make_ready(TASK_FSM, FSM_CLOCKS);
+}
+
+static void deadline_arm(void)
+{
+	s.deadline_expired = 0;
+	post(s.now + (clocks_t)opt.period_ms * (CPU_HZ / 1000), EV_DEADLINE, ++s.deadline_gen);
+}
+
+// ROC_Calculation_Task, one sample
+static void calculation(void)
+{
+	uint32_t adc = s.queue[s.q_head];
+	clocks_t latency = s.now - s.queued_at[s.q_head];
+	int was_stable = s.system_stable;
+
+	s.q_head = (s.q_head + 1) % HW_DATA_QUEUE_SIZE;
+	s.q_count--;
+	freq_channel_update(&s.channel, SAMPLING_FREQ / (double)adc, opt.freq_threshold, opt.roc_threshold);
+	if (!s.channel.stable && (s.fsm.state != MAINTENANCE_MODE)) {
+		s.time_before_shed = tick();
+		s.system_stable = 0;
+	}
+	else {
+		s.system_stable = 1; // one channel, so no other channel can hold it unstable
+	}
+	if (s.system_stable != was_stable) {
+		fsm_poke(s.now - latency);
+	}
+	if (latency > s.detect_worst) {
+		s.detect_worst = latency;
+	}
+	if (s.q_count == 0) {
+		s.ready[TASK_ROC] = 0;
+	}
+	else {
+		s.left[TASK_ROC] = ROC_CLOCKS;
+	}
+}
+
+// Whether the relay has disconnected a load whose switch is on
+static int load_disconnected(const load_fsm *f)
+{
+	int i;
+
+	for (i = 0; i < LOAD_FSM_LOADS; i++) {
+		if (!f->load_on[i] && f->switch_on[i]) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Load_Management_Task, one pass and the wait for the next
+static void management(void)
+{
+	load_fsm_actions a;
+
+	note_state();
+	load_fsm_step(&s.fsm, s.system_stable, s.deadline_expired, s.switches, &a);
+	s.passes++;
+	if (a.shed >= 0) {
+		s.sheds++;
+	}
+	if (a.initial_shed) {
+		s.shed_from = s.time_before_shed;
+		s.shed_pending = 1;
+		if (s.phase == 0 && s.now - s.disturbance_end > TRIP_GRACE_CLOCKS) {
+			s.false_trips++;
+		}
+	}
+	if (s.shed_pending && load_disconnected(&s.fsm)) {
+		// update_shed_stats(), in ticks of 1 ms, but timed to a load actually being off rather
+		// than to the step that reports the shed
+		unsigned long long ms = tick() - s.shed_from;
+		if (ms == 0) {
+			ms = 1; // round up
+		}
+		if (s.initial_sheds == 0 || ms < s.shed_ms_min) {
+			s.shed_ms_min = ms;
+		}
+		if (ms > s.shed_ms_max) {
+			s.shed_ms_max = ms;
+		}
+		s.shed_ms_sum += ms;
+		s.over_limit += ms > SHED_LIMIT_MS;
+		s.initial_sheds++;
+		s.shed_pending = 0;
+	}
+	else if (s.shed_pending && (s.fsm.state == NORMAL_OPERATION || s.fsm.state == MAINTENANCE_MODE)) {
+		s.shed_pending = 0; // every switch was off, nothing to shed
+	}
+	if (a.arm_deadline) {
+		deadline_arm();
+	}
+	if (a.reconnected >= 0) {
+		s.reconnects++;
+	}
+	if (s.phase != 0 && s.fsm.state != NORMAL_OPERATION) {
+		s.seen = 1;
+	}
+	note_state();
+
+	// ulTaskNotifyTake(pdTRUE, 5)
+	if (s.notified) {
+		s.notified = 0;
+		s.left[TASK_FSM] = FSM_CLOCKS;
+		return;
+	}
+	s.ready[TASK_FSM] = 0;
+	if ((s.fsm.state == NORMAL_OPERATION && s.system_stable) || s.fsm.state == MAINTENANCE_MODE) {
+		s.parked = 1; // the passes until something changes would do nothing
+		s.park_tick = tick();
+	}
+	else {
+		post((tick() + FSM_TIMEOUT_TICKS) * CLOCKS_PER_TICK, EV_FSM_TIMEOUT, ++s.timeout_gen);
+	}
+}
+
+// ------------------------------------------------------------------ grid
+
+// Frequency of the next mains cycle
+static double grid_cycle(void)
+{
+	double f;
+
+	s.drift = s.drift * 0.999 + 0.0005 * gaussian();
+	switch (s.phase) {
+		case 0:
+			if (s.now >= s.next_disturbance) {
+				s.rate = 1.0 + 24.0 * uniform();
+				s.depth = 0.2 + 2.3 * uniform();
+				s.dip = uniform() < 0.25 ? s.depth : 0.0;
+				s.phase = 1;
+				s.seen = s.fsm.state != NORMAL_OPERATION;
+				s.disturbances++;
+			}
+			break;
+		case 1:
+			s.dip += s.rate / 50.0;
+			if (s.dip >= s.depth) {
+				s.dip = s.depth;
+				s.hold_end = s.now + (clocks_t)((0.5 + 9.5 * uniform()) * CPU_HZ);
+				s.phase = 2;
+			}
+			break;
+		case 2:
+			if (s.now >= s.hold_end) {
+				s.phase = 3;
+			}
+			break;
+		case 3:
+			s.dip -= s.rate / 50.0;
+			if (s.dip <= 0.0) {
+				s.dip = 0.0;
+				s.phase = 0;
+				s.missed += !s.seen;
+				s.disturbance_end = s.now;
+				s.next_disturbance = s.now + exponential(opt.disturbance_minutes * 60.0);
+			}
+			break;
+	}
+	f = 50.0 + s.drift - s.dip;
+	return f;
+}
+
+static void analyser(void)
+{
+	uint32_t adc = (uint32_t)floor(SAMPLING_FREQ / grid_cycle() + 0.5 + 0.6 * gaussian());
+
+	if (uniform() < 1.0 / 5000) {
+		adc += uniform() < 0.5 ? 6 : -6; // a glitched cycle
+	}
+	s.isr_debt += ISR_CLOCKS;
+	s.samples++;
+	if (s.q_count == HW_DATA_QUEUE_SIZE) {
+		s.dropped++;
+	}
+	else {
+		unsigned int tail = (s.q_head + s.q_count++) % HW_DATA_QUEUE_SIZE;
+		s.queue[tail] = adc;
+		s.queued_at[tail] = s.now;
+		make_ready(TASK_ROC, ROC_CLOCKS);
+	}
+	post(s.now + (clocks_t)adc * CLOCKS_PER_COUNT, EV_ANALYSER, 0);
+}
+
+// ------------------------------------------------------------------ simulation
+
+// button_irq, pressed at 02:00 and again at 02:15 every day
+static void button(void)
+{
+	s.isr_debt += ISR_CLOCKS;
+	if (s.fsm.state != MAINTENANCE_MODE) {
+		s.prev_state = s.fsm.state;
+		s.fsm.state = MAINTENANCE_MODE;
+	}
+	else {
+		s.fsm.state = s.prev_state;
+	}
+	if (s.phase != 0) {
+		s.seen = 1;
+	}
+	fsm_poke(s.now);
+	if (s.presses++ % 2 == 0) {
+		post(s.now + MAINTENANCE_CLOCKS, EV_BUTTON, 0);
+	}
+	else {
+		post(s.now - MAINTENANCE_CLOCKS + DAY_CLOCKS, EV_BUTTON, 0);
+	}
+}
+
+static void run(void)
+{
+	clocks_t end = (clocks_t)(opt.days * DAY_CLOCKS);
+	event e;
+	int finished;
+
+	memset(&s, 0, sizeof(s));
+	s.rng = opt.seed * 0x9e3779b97f4a7c15ULL + 1;
+	s.hash = 14695981039346656037ULL;
+	s.running = -1;
+	s.system_stable = 1;
+	s.switches = ALL_SWITCHES;
+	freq_channel_init(&s.channel, ROC_METHOD, ROC_WINDOW, ROC_IIR_ALPHA);
+	load_fsm_init(&s.fsm);
+	s.reported_state = s.fsm.state;
+	s.next_disturbance = exponential(opt.disturbance_minutes * 60.0);
+
+	post((clocks_t)(320 * uniform()) * CLOCKS_PER_COUNT, EV_ANALYSER, 0);
+	make_ready(TASK_FSM, FSM_CLOCKS);
+	cpu_dispatch();
+	post(exponential(opt.switch_hours * 3600.0), EV_SWITCH, 0);
+	post(MAINTENANCE_AT, EV_BUTTON, 0);
+
+	while (s.heap_n > 0 && s.heap[0].time < end) {
+		e = pop();
+		if ((e.type == EV_BURST_END && e.gen != s.burst_gen) || (e.type == EV_FSM_TIMEOUT && e.gen != s.timeout_gen)
+			|| (e.type == EV_DEADLINE && e.gen != s.deadline_gen)) {
+			continue; // cancelled
+		}
+		s.now = e.time;
+		s.events++;
+		s.hash = (s.hash ^ (e.time * 8 + e.type)) * 1099511628211ULL;
+		finished = s.running;
+		cpu_stop();
+		switch (e.type) {
+			case EV_ANALYSER:
+				analyser();
+				break;
+			case EV_DEADLINE:
+				s.isr_debt += ISR_CLOCKS;
+				s.deadline_expired = 1;
+				fsm_notify();
+				break;
+			case EV_FSM_TIMEOUT:
+				make_ready(TASK_FSM, FSM_CLOCKS);
+				break;
+			case EV_BURST_END:
+				if (finished == TASK_ROC) {
+					calculation();
+				}
+				else {
+					management();
+				}
+				break;
+			case EV_SWITCH:
+				s.switches ^= 1u << (unsigned int)(uniform() * LOAD_FSM_LOADS);
+				fsm_poke(s.now);
+				post(s.now + exponential(opt.switch_hours * 3600.0), EV_SWITCH, 0);
+				break;
+			case EV_BUTTON:
+				button();
+				break;
+		}
+		cpu_dispatch();
+	}
+	s.now = end;
+	s.in_state[s.reported_state] += s.now - s.state_since;
+}
+
+int main(int argc, char *argv[])
+{
+	double wall, sim_seconds;
+	uint64_t hash;
+	int check = 0, i, st;
+
+	opt.freq_threshold = 49.5;
+	opt.roc_threshold = 10.0;
+	opt.period_ms = 500;
+	opt.days = 3.0;
+	opt.disturbance_minutes = 30.0;
+	opt.switch_hours = 2.0;
+	opt.seed = 1;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			opt.days = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			opt.seed = strtoull(argv[++i], NULL, 0);
+		}
+		else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			opt.freq_threshold = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			opt.roc_threshold = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			opt.period_ms = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+			opt.disturbance_minutes = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			opt.switch_hours = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-v") == 0) {
+			opt.verbose = 1;
+		}
+		else if (strcmp(argv[i], "-c") == 0) {
+			check = 1;
+		}
+		else {
+			fprintf(stderr, "usage: %s [-d days] [-s seed] [-f Hz] [-r Hz/s] [-p ms] [-e minutes] [-o hours] [-v] [-c]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!(opt.days > 0) || opt.period_ms == 0 || !(opt.disturbance_minutes > 0) || !(opt.switch_hours > 0)) {
+		fprintf(stderr, "days, period, and the mean times between events must be positive\n");
+		return 1;
+	}
+
+	wall = now_ns();
+	run();
+	wall = (now_ns() - wall) / 1e9;
+	sim_seconds = opt.days * 86400.0;
+
+	printf("%.2f days at %.2f Hz, %.1f Hz/s, deadline %u ms, seed %llu\n", opt.days, opt.freq_threshold,
+		opt.roc_threshold, opt.period_ms, opt.seed);
+	printf("  samples %llu, dropped %llu, worst sample to decision %.0f us, FSM passes %llu\n", s.samples, s.dropped,
+		s.detect_worst * 1e6 / CPU_HZ, s.passes);
+	printf("  disturbances %llu, missed %llu, false trips %llu\n", s.disturbances, s.missed, s.false_trips);
+	printf("  initial sheds %llu: min %llu ms, mean %.1f ms, max %llu ms, %llu over %d ms\n", s.initial_sheds,
+		s.shed_ms_min, s.initial_sheds ? (double)s.shed_ms_sum / s.initial_sheds : 0.0, s.shed_ms_max, s.over_limit, SHED_LIMIT_MS);
+	printf("  loads shed %llu, reconnected %llu\n", s.sheds, s.reconnects);
+	printf("  time in state:");
+	for (st = 0; st < 4; st++) {
+		printf(" %s %.3f%%%s", state_names[st], 100.0 * s.in_state[st] / (opt.days * DAY_CLOCKS), st < 3 ? "," : "\n");
+	}
+	printf("%llu events (%.0f tick interrupts jumped over), schedule hash %016llx\n", s.events, sim_seconds * 1000.0,
+		(unsigned long long)s.hash);
+	printf("%.0f s simulated in %.2f s, %.0fx real time, %.1f M events/s\n", sim_seconds, wall, sim_seconds / wall,
+		s.events / wall / 1e6);
+
+	if (check) {
+		hash = s.hash;
+		opt.verbose = 0;
+		run();
+		if (s.hash != hash) {
+			printf("FAIL: the second run's schedule hash is %016llx\n", (unsigned long long)s.hash);
+			return 1;
+		}
+		printf("second run identical\n");
+	}
+	return 0;
+}
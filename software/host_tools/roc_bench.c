@@ -0,0 +1,260 @@
+/*
+ * Host benchmark of the RoC estimators in software/freertos_test/roc_estimator.c: CPU per sample,
+ * and how often each one crosses the RoC threshold when it should not (false sheds) or late.
+ *
+ * Traces are the analyser's period counts at 16 kHz, one per mains cycle, as the relay sees them.
+ * Recorded traces come from the telemetry stream (README, section 4), decoded to CSV:
+ *   telemetry_decode.py run.bin > run.csv && ./roc_bench run.csv
+ * The "sample" rows are used. A recorded run has no ground truth, so every threshold crossing is
+ * counted as a trip; capture it with the network quiet and the trips are the false sheds.
+ *
+ * Without arguments it generates its own traces: an hour at 50 Hz with slow drift, period counts
+ * rounded to whole 16 kHz counts with gaussian jitter, occasional glitched periods (one noisy
+ * cycle), and separately 200 genuine frequency ramps at 1.5x the threshold to measure how long
+ * each estimator takes to see them.
+ *
+ * build and run:
+ *   gcc -O2 -I../freertos_test -o roc_bench roc_bench.c ../freertos_test/roc_estimator.c -lm && ./roc_bench
+ *
+ * The target has no FPU, so its cost is the soft-float calls per update: two-point 1 div, 3 mul,
+ * 2 add/sub; least squares 3 div, 6 mul, 7 add/sub, plus 1 mul and 3 add per sample for summing
+ * the window afresh; IIR two-point plus 1 mul, 2 add/sub.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "roc_estimator.h"
+
+#define SAMPLING_FREQ 16000.0
+#define NOMINAL 50.0
+#define ROC_THRESHOLD 10.0 // Hz/s, the relay's default
+#define QUIET_SECONDS 3600
+#define EVENTS 200
+#define EVENT_ROC (-1.5 * ROC_THRESHOLD)
+#define EVENT_SECONDS 0.5
+
+typedef struct {
+	const char *name;
+	int method;
+	unsigned int window;
+	double alpha;
+} config;
+
+static const config configs[] = {
+	{"two-point", ROC_TWO_POINT, 2, 0},
+	{"lsq 4", ROC_LEAST_SQUARES, 4, 0},
+	{"lsq 6", ROC_LEAST_SQUARES, 6, 0},
+	{"lsq 8", ROC_LEAST_SQUARES, 8, 0},
+	{"lsq 12", ROC_LEAST_SQUARES, 12, 0},
+	{"iir 0.5", ROC_IIR, 2, 0.5},
+	{"iir 0.6", ROC_IIR, 2, 0.6},
+	{"iir 0.75", ROC_IIR, 2, 0.75},
+};
+#define CONFIGS (sizeof(configs) / sizeof(configs[0]))
+
+typedef struct {
+	unsigned int *adc;
+	unsigned int n;
+	unsigned int cap;
+} trace;
+
+static void trace_add(trace *t, unsigned int adc)
+{
+	if (t->n == t->cap) {
+		t->cap = t->cap ? 2 * t->cap : 4096;
+		t->adc = realloc(t->adc, t->cap * sizeof(*t->adc));
+	}
+	t->adc[t->n++] = adc;
+}
+
+static double gaussian(void)
+{
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return sqrt(-2.0 * log(u)) * cos(2 * M_PI * v);
+}
+
+// One period count of a signal at frequency f, with jitter and the odd glitched period
+static unsigned int measure(double f, double jitter, double glitch_rate)
+{
+	double counts = SAMPLING_FREQ / f + jitter * gaussian();
+	if ((double)rand() / RAND_MAX < glitch_rate) {
+		counts += (rand() & 1) ? 3 : -3;
+	}
+	return (unsigned int)lround(counts);
+}
+
+static void quiet_trace(trace *t, double jitter, double glitch_rate)
+{
+	double time = 0, f;
+
+	while (time < QUIET_SECONDS) {
+		f = NOMINAL + 0.1 * sin(2 * M_PI * time / 60.0); // drift far below the threshold
+		trace_add(t, measure(f, jitter, glitch_rate));
+		time += 1.0 / f;
+	}
+}
+
+// Samples to the first trip for each ramp, starting from the ramp's first sample
+static void event_trace(trace *t, unsigned int *starts, double jitter, double glitch_rate)
+{
+	unsigned int e;
+	double time, f;
+
+	for (e = 0; e < EVENTS; e++) {
+		for (time = 0; time < 1.0; time += 1.0 / NOMINAL) {
+			trace_add(t, measure(NOMINAL, jitter, glitch_rate));
+		}
+		starts[e] = t->n;
+		for (f = NOMINAL, time = 0; time < EVENT_SECONDS; time += 1.0 / f) {
+			f = NOMINAL + EVENT_ROC * time;
+			trace_add(t, measure(f, jitter, glitch_rate));
+		}
+		for (time = 0; time < 1.0; time += 1.0 / f) {
+			trace_add(t, measure(f, jitter, glitch_rate)); // settled at the new frequency
+		}
+	}
+}
+
+static int load_csv(const char *path, trace *t)
+{
+	char line[256];
+	FILE *fp = fopen(path, "r");
+	unsigned int adc;
+
+	if (fp == NULL) {
+		perror(path);
+		return 1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		char *p = strstr(line, ",sample,");
+		if (p && sscanf(p + 8, "%u", &adc) == 1 && adc > 0) {
+			trace_add(t, adc);
+		}
+	}
+	fclose(fp);
+	return 0;
+}
+
+// Rising edges of |roc| >= threshold
+static unsigned int trips(const config *c, const trace *t, double *ns_per_sample)
+{
+	roc_estimator e;
+	unsigned int i, count = 0;
+	int tripped = 0;
+	struct timespec t0, t1;
+
+	roc_init(&e, c->method, c->window, c->alpha);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < t->n; i++) {
+		int now = fabs(roc_update(&e, SAMPLING_FREQ / t->adc[i])) >= ROC_THRESHOLD;
+		count += now && !tripped;
+		tripped = now;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (ns_per_sample) {
+		*ns_per_sample = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / t->n;
+	}
+	return count;
+}
+
+static void detection(const config *c, const trace *t, const unsigned int *starts, unsigned int *missed, double *mean_ms, double *worst_ms)
+{
+	roc_estimator e;
+	unsigned int i, ev = 0, delay_sum = 0, worst = 0;
+	int seen = 0;
+
+	*missed = 0;
+	roc_init(&e, c->method, c->window, c->alpha);
+	for (i = 0; i < t->n; i++) {
+		int now = fabs(roc_update(&e, SAMPLING_FREQ / t->adc[i])) >= ROC_THRESHOLD;
+		if (ev < EVENTS && i == starts[ev]) {
+			seen = 0;
+		}
+		if (ev < EVENTS && i >= starts[ev]) {
+			if (now && !seen) {
+				delay_sum += i - starts[ev];
+				worst = i - starts[ev] > worst ? i - starts[ev] : worst;
+				seen = 1;
+			}
+			if (i - starts[ev] > EVENT_SECONDS * NOMINAL) {
+				*missed += !seen;
+				ev++;
+			}
+		}
+	}
+	*mean_ms = EVENTS > *missed ? 1000.0 / NOMINAL * delay_sum / (EVENTS - *missed) : 0;
+	*worst_ms = 1000.0 / NOMINAL * worst;
+}
+
+static void two_point_matches_original(const trace *t)
+{
+	roc_estimator e;
+	double prev = 0, f, roc, expect;
+	unsigned int i;
+
+	roc_init(&e, ROC_TWO_POINT, 2, 0);
+	for (i = 0; i < t->n; i++) {
+		f = SAMPLING_FREQ / (double)t->adc[i];
+		expect = (f - prev) * 2.0 * f * prev / (f + prev);
+		if (expect > 100.0) {
+			expect = 100.0;
+		}
+		roc = roc_update(&e, f);
+		if (memcmp(&roc, &expect, sizeof(roc)) != 0) {
+			printf("two-point differs from the original at sample %u\n", i);
+			return;
+		}
+		prev = f;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const double jitters[] = {0.3, 0.5, 0.8};
+	unsigned int i, j, c;
+	double ns;
+
+	if (argc > 1) {
+		for (i = 1; i < (unsigned int)argc; i++) {
+			trace t = {0};
+			if (load_csv(argv[i], &t) || t.n < 2) {
+				continue;
+			}
+			printf("%s: %u samples, about %.0f s\n", argv[i], t.n, t.n / NOMINAL);
+			two_point_matches_original(&t);
+			for (c = 0; c < CONFIGS; c++) {
+				unsigned int n = trips(&configs[c], &t, &ns);
+				printf("  %-10s %6u trips  %8.1f per hour  %6.1f ns/sample\n", configs[c].name, n, n * 3600.0 * NOMINAL / t.n, ns);
+			}
+			free(t.adc);
+		}
+		return 0;
+	}
+
+	srand(1);
+	for (j = 0; j < sizeof(jitters) / sizeof(jitters[0]); j++) {
+		trace quiet = {0}, events = {0};
+		unsigned int starts[EVENTS];
+
+		quiet_trace(&quiet, jitters[j], 1e-3);
+		event_trace(&events, starts, jitters[j], 1e-3);
+		two_point_matches_original(&quiet);
+		printf("jitter %.1f counts rms, 1 in 1000 periods glitched by 3 counts, threshold %.0f Hz/s\n", jitters[j], ROC_THRESHOLD);
+		printf("  method      false trips/h   ns/sample  |  ramps of %.0f Hz/s: missed  mean ms  worst ms\n", EVENT_ROC);
+		for (c = 0; c < CONFIGS; c++) {
+			unsigned int missed;
+			double mean_ms, worst_ms;
+			unsigned int n = trips(&configs[c], &quiet, &ns);
+			detection(&configs[c], &events, starts, &missed, &mean_ms, &worst_ms);
+			printf("  %-10s  %13.1f  %10.1f  |  %26u  %7.0f  %8.0f\n", configs[c].name, n * 3600.0 / QUIET_SECONDS, ns, missed, mean_ms, worst_ms);
+		}
+		printf("\n");
+		free(quiet.adc);
+		free(events.adc);
+	}
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Host micro-benchmark of the two ways FreeRTOS picks the next ready priority in
+ * vTaskSwitchContext(), for the 12 priorities used by freertos_test:
+ *   generic - tasks.c walks uxTopReadyPriority down past empty ready lists
+ *   bitmap  - the Nios II port keeps a ready bitmap and looks the top bit up a
+ *             byte at a time (uxPortHighestSetBit() in portmacro.h)
+ * Both selectors are copied here so the benchmark builds without the BSP.
+ *
+ * build and run:
+ *   gcc -O2 -o task_select_bench task_select_bench.c && ./task_select_bench
+ *
+ * The on-target figure comes from setting configMEASURE_TASK_SELECTION to 1 in
+ * FreeRTOSConfig.h, which LOGs the cost of each second's selections.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_PRIORITIES 12
+#define ROUNDS 2000000
+#define SETS 1024
+
+static uint8_t highest_bit[256];
+
+static volatile unsigned int sink;
+
+// ready_count has one entry per priority, the number of tasks in that ready list
+static unsigned int select_generic(const unsigned int *ready_count, unsigned int *top_ready)
+{
+	unsigned int top = *top_ready;
+	while (ready_count[top] == 0) {
+		--top;
+	}
+	*top_ready = top;
+	return top;
+}
+
+static unsigned int select_bitmap(uint32_t bitmap)
+{
+	if (bitmap >> 16) {
+		return (bitmap >> 24) ? 24 + highest_bit[bitmap >> 24] : 16 + highest_bit[(bitmap >> 16) & 0xff];
+	}
+	if (bitmap >> 8) {
+		return 8 + highest_bit[bitmap >> 8];
+	}
+	return highest_bit[bitmap];
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+	static uint32_t sets[SETS];
+	static unsigned int stale_top[SETS];
+	static unsigned int ready_count[SETS][MAX_PRIORITIES];
+	unsigned int i, p, r;
+	double t0, generic_ns, bitmap_ns;
+
+	for (i = 1; i < 256; i++) {
+		for (p = 7; !(i & (1u << p)); p--) {
+		}
+		highest_bit[i] = p;
+	}
+
+	// random ready sets, the idle priority is always ready. The generic walk starts from a
+	// stale top priority, as it does after the task that raised it has blocked again
+	srand(1);
+	for (i = 0; i < SETS; i++) {
+		sets[i] = 1 | (rand() & ((1u << MAX_PRIORITIES) - 1) & rand());
+		stale_top[i] = select_bitmap(sets[i]) + rand() % (MAX_PRIORITIES - select_bitmap(sets[i]));
+		for (p = 0; p < MAX_PRIORITIES; p++) {
+			ready_count[i][p] = (sets[i] >> p) & 1;
+		}
+	}
+
+	for (i = 0; i < SETS; i++) {
+		unsigned int top = stale_top[i];
+		if (select_generic(ready_count[i], &top) != select_bitmap(sets[i])) {
+			printf("selectors disagree on set 0x%03x\n", sets[i]);
+			return 1;
+		}
+	}
+
+	t0 = now_ns();
+	for (r = 0; r < ROUNDS / SETS; r++) {
+		for (i = 0; i < SETS; i++) {
+			unsigned int top = stale_top[i];
+			sink = select_generic(ready_count[i], &top);
+		}
+	}
+	generic_ns = now_ns() - t0;
+
+	t0 = now_ns();
+	for (r = 0; r < ROUNDS / SETS; r++) {
+		for (i = 0; i < SETS; i++) {
+			sink = select_bitmap(sets[i]);
+		}
+	}
+	bitmap_ns = now_ns() - t0;
+
+	printf("%d selections over %d random ready sets\n", (ROUNDS / SETS) * SETS, SETS);
+	printf("generic walk: %.2f ns/selection\n", generic_ns / ((ROUNDS / SETS) * SETS));
+	printf("bitmap:       %.2f ns/selection\n", bitmap_ns / ((ROUNDS / SETS) * SETS));
+	return 0;
+}
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Decode the binary telemetry stream sent by the relay on its serial UART.
+
+Frame layout (see software/freertos_test/telemetry.h):
+    0xA5 | type | len | seq (u16 LE) | tick (u32 LE) | payload[len] | checksum
+checksum is the two's complement of the byte sum from type to the end of the payload.
+
+Capture a run with e.g.
+    stty -F /dev/ttyUSB0 115200 raw && cat /dev/ttyUSB0 > run.bin
+then decode it offline:
+    telemetry_decode.py run.bin > run.csv
+Reading from '-' decodes stdin, so the capture can also be piped in live.
+
+--adc FILE also writes the adc count of every sample record to FILE as little endian u32, the
+input of trace_scan.c:
+    telemetry_decode.py --adc run.adc run.bin > run.csv
+"""
+
+import struct
+import sys
+
+SYNC = 0xA5
+HEADER_SIZE = 9
+
+SAMPLE, ROC, STATE, LOAD, RESPONSE = 0x01, 0x02, 0x03, 0x04, 0x05
+
+STATES = ["NORMAL_OPERATION", "LOAD_MGMT_MONITOR_STABLE", "LOAD_MGMT_MONITOR_UNSTABLE", "MAINTENANCE_MODE"]
+LOAD_EVENTS = ["shed", "reconnect"]
+SAMPLING_FREQ = 16000.0
+
+
+def state_name(s):
+    return STATES[s] if s < len(STATES) else str(s)
+
+
+def describe(rtype, payload):
+    """Returns (record name, csv fields) for a record payload."""
+    if rtype == SAMPLE and len(payload) == 4:
+        (adc,) = struct.unpack("<I", payload)
+        freq = SAMPLING_FREQ / adc if adc else 0.0
+        return "sample", [adc, "%.6f" % freq]
+    if rtype == ROC and len(payload) == 9:
+        freq, roc, stable = struct.unpack("<ffB", payload)
+        return "roc", ["%.6f" % freq, "%.6f" % roc, stable]
+    if rtype == STATE and len(payload) == 2:
+        return "state", [state_name(payload[0]), state_name(payload[1])]
+    if rtype == LOAD and len(payload) == 4:
+        event, load, shed_time = struct.unpack("<BBH", payload)
+        name = LOAD_EVENTS[event] if event < len(LOAD_EVENTS) else str(event)
+        return "load", [name, load, shed_time]
+    if rtype == RESPONSE and len(payload) >= 4:
+        request, request_seq, status = struct.unpack_from("<BHB", payload)
+        return "response", ["0x%02x" % request, request_seq, status, payload[4:].hex()]
+    return "type%d" % rtype, [payload.hex()]
+
+
+def frames(stream):
+    """Yields (type, seq, tick, payload) for every valid frame, resynchronising on bad checksums."""
+    buf = bytearray()
+    eof = False
+    while not eof:
+        chunk = stream.read(4096)
+        eof = not chunk
+        buf += chunk
+        pos = 0
+        while True:
+            start = buf.find(SYNC, pos)
+            if start < 0:
+                pos = len(buf)
+                break
+            end = start + HEADER_SIZE + (buf[start + 2] if len(buf) > start + 2 else 0) + 1
+            if len(buf) - start < HEADER_SIZE or len(buf) < end:
+                if eof:
+                    pos = start + 1  # truncated frame or false sync at the end of the capture
+                    continue
+                pos = start
+                break
+            if sum(buf[start + 1:end]) & 0xFF != 0:
+                pos = start + 1  # false sync byte, or a corrupted frame
+                continue
+            rtype = buf[start + 1]
+            seq, tick = struct.unpack_from("<HI", buf, start + 3)
+            yield rtype, seq, tick, bytes(buf[start + HEADER_SIZE:end - 1])
+            pos = end
+        del buf[:pos]
+
+
+def main(argv):
+    adc_out = None
+    if len(argv) == 4 and argv[1] == "--adc":
+        adc_out = open(argv[2], "wb")
+        argv = argv[:1] + argv[3:]
+    if len(argv) != 2:
+        sys.stderr.write("usage: %s [--adc counts.adc] <capture file | ->\n" % argv[0])
+        return 2
+    stream = sys.stdin.buffer if argv[1] == "-" else open(argv[1], "rb")
+    out = sys.stdout
+    expected = None
+    records = 0
+    lost = 0
+    out.write("seq,tick_ms,record,fields...\n")
+    for rtype, seq, tick, payload in frames(stream):
+        if expected is not None and seq != expected:
+            lost += (seq - expected) & 0xFFFF  # dropped on target or corrupted in transit
+        expected = (seq + 1) & 0xFFFF
+        records += 1
+        name, fields = describe(rtype, payload)
+        out.write(",".join(str(f) for f in [seq, tick, name] + fields) + "\n")
+        if adc_out is not None and name == "sample":
+            adc_out.write(payload)
+    sys.stderr.write("%d records decoded, %d lost\n" % (records, lost))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,558 @@
+/*
+ * Host sweep of the relay's tuning parameters: every combination of frequency threshold, RoC
+ * threshold and deadline period (TIMER_PERIOD_MS) replayed over a corpus of disturbances through
+ * the relay's own detection and load management code, on all cores.
+ *
+ * Each trace is the analyser's period counts at 16 kHz, one per mains cycle. The replay runs in
+ * analyser counts, so sample times are exact: a sample arrives when its period has elapsed and
+ * sets the system stable or unstable as ROC_Calculation_Task does (freq_channel_update()'s test),
+ * and load_fsm.c is stepped when Load_Management_Task would run, 5 ms after its last pass or at
+ * the deadline expiry, whichever is first. Passes that cannot change anything (normal operation,
+ * stable) are skipped. All switches are on.
+ *
+ * For each configuration it reports
+ *   sheds       loads shed over the corpus
+ *   stable ms   mean time from detecting a disturbance to the relay being back in normal
+ *               operation with every load reconnected
+ *   unresolved  disturbance traces that end still in load management
+ *   false       load management entered on quiet traces
+ *   missed      disturbance traces that never shed
+ * and ranks them: fewest missed, then unresolved, then false, then sheds, then stable ms.
+ *
+ * The corpus is either recorded captures (telemetry_decode.py --adc run.bin > run.adc), given as
+ * disturbances or, with -q, as quiet captures, or without files a synthetic one: an hour of quiet
+ * network (drift, a count of jitter and the odd glitched cycle) and 48 disturbances, ramps from
+ * 2 to 24 Hz/s and steps, 0.3 to 2 Hz deep, with the network recovering at the same rate.
+ *
+ * build and run:
+ *   gcc -O2 -pthread -I../freertos_test -o threshold_sweep threshold_sweep.c ../freertos_test/load_fsm.c ../freertos_test/roc_estimator.c -lm && ./threshold_sweep
+ *
+ * Configurations are shared out by work stealing: each worker starts with an equal slice of them
+ * in its own deque, runs them from one end and, once it is empty, steals from the other end of
+ * the others'. Configurations at low thresholds trip constantly and take several times longer
+ * than the rest, so a static split leaves cores idle. The sweep is timed on 1, 2, 4 ... threads up
+ * to the core count (or -j), and should speed up linearly since workers share nothing but the
+ * read-only corpus.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "load_fsm.h"
+#include "roc_estimator.h"
+
+#define SAMPLING_FREQ 16000.0
+#define COUNTS_PER_MS 16 // analyser counts
+#define PASS_MS 5 // Load_Management_Task's ulTaskNotifyTake() timeout
+#define ALL_SWITCHES ((1u << LOAD_FSM_LOADS) - 1)
+#define MAX_TRACES 256
+#define MAX_THREADS 64
+#define TOP 10
+
+typedef struct {
+	const char *name;
+	int quiet; // no disturbance, any shed is a false trip
+	unsigned int n;
+	uint32_t *adc; // period counts
+	double *freq; // what ROC_Calculation_Task sees for each sample, independent of the thresholds
+	double *roc;
+} trace;
+
+typedef struct {
+	double freq_threshold;
+	double roc_threshold;
+	unsigned int period_ms;
+	// results
+	unsigned long sheds;
+	unsigned long false_trips;
+	unsigned long missed;
+	unsigned long episodes; // resolved
+	unsigned long unresolved;
+	double stable_ms; // sum over resolved episodes
+} config;
+
+typedef struct {
+	pthread_mutex_t lock;
+	unsigned int *jobs; // config indices, [head, tail) left to run
+	unsigned int head, tail;
+} deque;
+
+static trace traces[MAX_TRACES];
+static unsigned int trace_count;
+static int synthetic;
+static config *configs;
+static unsigned int config_count;
+static deque deques[MAX_THREADS];
+static unsigned int worker_count;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ------------------------------------------------------------------ corpus
+
+static uint32_t seed = 1;
+
+static double uniform(void)
+{
+	seed = seed * 1664525 + 1013904223;
+	return (seed >> 8) / 16777216.0;
+}
+
+static double gaussian(void)
+{
+	double u = uniform() + 1e-12, v = uniform();
+	return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static void trace_add(trace *t, double f)
+{
+	// the analyser counts whole 16 kHz periods, a count of jitter either way
+	t->adc[t->n++] = (uint32_t)floor(SAMPLING_FREQ / f + 0.5 + 0.6 * gaussian());
+}
+
+static trace *trace_new(const char *name, int quiet, unsigned int capacity)
+{
+	trace *t = &traces[trace_count++];
+	t->name = name;
+	t->quiet = quiet;
+	t->n = 0;
+	t->adc = malloc(capacity * sizeof(t->adc[0]));
+	return t;
+}
+
+static void synthetic_corpus(void)
+{
+	unsigned int i, k;
+	double f, drift;
+
+	for (i = 0; i < 6; i++) { // an hour of quiet network in 10 minute traces
+		trace *t = trace_new("quiet", 1, 600 * 50);
+		f = 50.0;
+		drift = 0.0;
+		for (k = 0; k < 600 * 50; k++) {
+			drift += 0.0005 * gaussian();
+			drift *= 0.999;
+			trace_add(t, f + drift);
+			if (uniform() < 1.0 / 5000) {
+				t->adc[t->n - 1] += uniform() < 0.5 ? 6 : -6; // a glitched cycle
+			}
+		}
+	}
+	for (i = 0; i < 48; i++) { // 5 s quiet, the disturbance, then 40 s quiet to reconnect
+		trace *t = trace_new(i % 4 == 3 ? "step" : "ramp", 0, 120 * 50);
+		double rate = 2.0 + 22.0 * (i % 12) / 11.0; // Hz/s
+		double depth = 0.3 + 1.7 * ((i * 7) % 12) / 11.0; // Hz
+		double hold = 1.0 + (i % 5); // s at the bottom
+		unsigned int held = 0;
+		f = 50.0;
+		for (k = 0; k < 5 * 50; k++) {
+			trace_add(t, f);
+		}
+		if (i % 4 == 3) {
+			f -= depth;
+		}
+		while (f > 50.0 - depth) { // ramp down, one cycle at a time
+			f -= rate / f;
+			trace_add(t, f);
+		}
+		for (held = 0; held < hold * 50; held++) {
+			trace_add(t, 50.0 - depth);
+		}
+		f = 50.0 - depth;
+		while (f < 50.0) {
+			f += rate / f;
+			trace_add(t, f < 50.0 ? f : 50.0);
+		}
+		for (k = 0; k < 40 * 50; k++) {
+			trace_add(t, 50.0);
+		}
+	}
+}
+
+static int load_capture(const char *path, int quiet)
+{
+	FILE *fp = fopen(path, "rb");
+	unsigned int capacity = 1 << 16;
+	trace *t;
+	size_t n;
+
+	if (fp == NULL) {
+		perror(path);
+		return 1;
+	}
+	if (trace_count == MAX_TRACES) {
+		fprintf(stderr, "%s: more than %d traces\n", path, MAX_TRACES);
+		fclose(fp);
+		return 1;
+	}
+	t = trace_new(path, quiet, capacity);
+	while ((n = fread(t->adc + t->n, sizeof(t->adc[0]), capacity - t->n, fp)) > 0) {
+		t->n += n;
+		if (t->n == capacity) {
+			capacity *= 2;
+			t->adc = realloc(t->adc, capacity * sizeof(t->adc[0]));
+		}
+	}
+	fclose(fp);
+	return 0;
+}
+
+// The estimator does not depend on the thresholds, so its output is worked out once per trace
+static void prepare(trace *t)
+{
+	roc_estimator e;
+	unsigned int k;
+
+	t->freq = malloc(t->n * sizeof(t->freq[0]));
+	t->roc = malloc(t->n * sizeof(t->roc[0]));
+	roc_init(&e, ROC_METHOD, ROC_WINDOW, ROC_IIR_ALPHA);
+	for (k = 0; k < t->n; k++) {
+		t->freq[k] = SAMPLING_FREQ / (double)t->adc[k];
+		t->roc[k] = roc_update(&e, t->freq[k]);
+	}
+}
+
+// ------------------------------------------------------------------ replay
+
+static void replay(config *c, const trace *t)
+{
+	const uint64_t pass = PASS_MS * COUNTS_PER_MS, period = (uint64_t)c->period_ms * COUNTS_PER_MS;
+	uint64_t next_sample = t->adc[0], next_pass = pass, deadline = 0, detected = 0;
+	unsigned int k = 0;
+	int stable = 1, armed = 0, expired = 0, shed = 0;
+	load_fsm f;
+	load_fsm_actions a;
+
+	load_fsm_init(&f);
+	while (k < t->n) {
+		if (armed && deadline <= next_sample && deadline <= next_pass) {
+			// the deadline ISR wakes the task, whose next timeout runs from then
+			armed = 0;
+			expired = 1;
+			next_pass = deadline;
+		}
+		if (next_sample <= next_pass) { // the analyser interrupt preempts the task
+			stable = !((t->freq[k] < c->freq_threshold) || (fabs(t->roc[k]) >= c->roc_threshold));
+			if (!stable && f.state == NORMAL_OPERATION && !detected) {
+				detected = next_sample; // time_before_shed
+			}
+			if (++k < t->n) {
+				next_sample += t->adc[k];
+			}
+			continue;
+		}
+		if (f.state == NORMAL_OPERATION && stable) {
+			// nothing to do until the next sample, skip the passes before it
+			next_pass += (next_sample - next_pass + pass - 1) / pass * pass;
+			continue;
+		}
+		load_fsm_step(&f, stable, expired, ALL_SWITCHES, &a);
+		if (a.shed >= 0) {
+			c->sheds++;
+		}
+		if (a.initial_shed) {
+			if (t->quiet) {
+				c->false_trips++;
+			}
+			shed = 1;
+		}
+		if (a.arm_deadline) {
+			armed = 1;
+			expired = 0;
+			deadline = next_pass + period;
+		}
+		if (f.state == NORMAL_OPERATION && detected) {
+			if (!t->quiet) {
+				c->episodes++;
+				c->stable_ms += (double)(next_pass - detected) / COUNTS_PER_MS;
+			}
+			detected = 0;
+		}
+		next_pass += pass;
+	}
+	if (f.state != NORMAL_OPERATION && !t->quiet) {
+		c->unresolved++;
+	}
+	if (!t->quiet && !shed) {
+		c->missed++;
+	}
+}
+
+static void run_config(config *c)
+{
+	unsigned int i;
+
+	c->sheds = c->false_trips = c->missed = c->episodes = c->unresolved = 0;
+	c->stable_ms = 0;
+	for (i = 0; i < trace_count; i++) {
+		replay(c, &traces[i]);
+	}
+}
+
+// ------------------------------------------------------------------ work stealing
+
+static int take(deque *d, int own, unsigned int *job)
+{
+	int found = 0;
+
+	pthread_mutex_lock(&d->lock);
+	if (d->head < d->tail) {
+		*job = own ? d->jobs[--d->tail] : d->jobs[d->head++];
+		found = 1;
+	}
+	pthread_mutex_unlock(&d->lock);
+	return found;
+}
+
+static void *worker(void *arg)
+{
+	unsigned int self = (unsigned int)(uintptr_t)arg, victim, job, i;
+
+	for (;;) {
+		while (take(&deques[self], 1, &job)) {
+			run_config(&configs[job]);
+		}
+		// nothing left of our own, steal from the first worker that still has some
+		for (i = 1; i < worker_count; i++) {
+			victim = (self + i) % worker_count;
+			if (take(&deques[victim], 0, &job)) {
+				run_config(&configs[job]);
+				break;
+			}
+		}
+		if (i == worker_count) {
+			return NULL; // every deque is empty and nothing adds to them
+		}
+	}
+}
+
+static double sweep(unsigned int threads)
+{
+	pthread_t tid[MAX_THREADS];
+	unsigned int i, j;
+	double t;
+
+	worker_count = threads;
+	for (i = 0; i < threads; i++) {
+		// contiguous slices, so neighbouring (similarly costly) configurations start on one worker
+		deques[i].head = 0;
+		deques[i].tail = 0;
+		for (j = config_count * i / threads; j < config_count * (i + 1) / threads; j++) {
+			deques[i].jobs[deques[i].tail++] = j;
+		}
+	}
+	t = now_ns();
+	for (i = 1; i < threads; i++) {
+		pthread_create(&tid[i], NULL, worker, (void *)(uintptr_t)i);
+	}
+	worker((void *)0);
+	for (i = 1; i < threads; i++) {
+		pthread_join(tid[i], NULL);
+	}
+	return (now_ns() - t) / 1e9;
+}
+
+// ------------------------------------------------------------------ results
+
+static double mean_stable_ms(const config *c)
+{
+	return c->episodes ? c->stable_ms / c->episodes : 0.0;
+}
+
+static int rank(const void *pa, const void *pb)
+{
+	const config *a = pa, *b = pb;
+
+	if (a->missed != b->missed) {
+		return a->missed < b->missed ? -1 : 1;
+	}
+	if (a->unresolved != b->unresolved) {
+		return a->unresolved < b->unresolved ? -1 : 1;
+	}
+	if (a->false_trips != b->false_trips) {
+		return a->false_trips < b->false_trips ? -1 : 1;
+	}
+	if (a->sheds != b->sheds) {
+		return a->sheds < b->sheds ? -1 : 1;
+	}
+	return mean_stable_ms(a) < mean_stable_ms(b) ? -1 : mean_stable_ms(a) > mean_stable_ms(b);
+}
+
+static void print_config(const config *c)
+{
+	printf("  %6.2f  %5.1f  %5u  %8lu  %9.0f  %10lu  %5lu  %6lu\n", c->freq_threshold, c->roc_threshold,
+		c->period_ms, c->sheds, mean_stable_ms(c), c->unresolved, c->false_trips, c->missed);
+}
+
+static int parse_range(const char *s, double *lo, double *hi, double *step)
+{
+	return sscanf(s, "%lf:%lf:%lf", lo, hi, step) == 3 && *step > 0 && *lo <= *hi;
+}
+
+// The figures count the sheds load_fsm.c reports, so check the initial one really disconnects
+// the load with its switch still on
+static int check_initial_shed(void)
+{
+	load_fsm f;
+	load_fsm_actions a;
+	int i;
+
+	load_fsm_init(&f);
+	load_fsm_step(&f, 1, 0, ALL_SWITCHES, &a);
+	load_fsm_step(&f, 0, 0, ALL_SWITCHES, &a);
+	if (!a.initial_shed || a.shed != 0 || f.load_on[0] || f.state != LOAD_MGMT_MONITOR_UNSTABLE) {
+		fprintf(stderr, "load_fsm.c: initial shed reported load %d, but loads are", a.shed);
+		for (i = 0; i < LOAD_FSM_LOADS; i++) {
+			fprintf(stderr, " %d", f.load_on[i]);
+		}
+		fprintf(stderr, " in state %d\n", f.state);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	double f_lo = 48.5, f_hi = 50.0, f_step = 0.1, r_lo = 2.0, r_hi = 30.0, r_step = 2.0, f, r, t1 = 0, t;
+	unsigned int periods[16] = {250, 500, 750, 1000}, period_count = 4, max_threads, threads, i, p;
+	const char *csv = NULL;
+	unsigned long samples = 0;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	config *sorted;
+	FILE *out;
+
+	max_threads = cores > 0 ? (unsigned int)cores : 1;
+	for (i = 1; i < (unsigned int)argc; i++) {
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < (unsigned int)argc && parse_range(argv[i + 1], &f_lo, &f_hi, &f_step)) {
+			i++;
+		}
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < (unsigned int)argc && parse_range(argv[i + 1], &r_lo, &r_hi, &r_step)) {
+			i++;
+		}
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < (unsigned int)argc) {
+			char *s = argv[++i];
+			period_count = 0;
+			while (period_count < 16 && (periods[period_count] = strtoul(s, &s, 10)) > 0) {
+				period_count++;
+				if (*s++ != ',') {
+					break;
+				}
+			}
+		}
+		else if (strcmp(argv[i], "-j") == 0 && i + 1 < (unsigned int)argc) {
+			max_threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < (unsigned int)argc) {
+			csv = argv[++i];
+		}
+		else if (strcmp(argv[i], "-q") == 0 && i + 1 < (unsigned int)argc) {
+			if (load_capture(argv[++i], 1)) {
+				return 1;
+			}
+		}
+		else if (argv[i][0] != '-') {
+			if (load_capture(argv[i], 0)) {
+				return 1;
+			}
+		}
+		else {
+			fprintf(stderr, "usage: %s [-f lo:hi:step Hz] [-r lo:hi:step Hz/s] [-p ms,ms,...] [-j threads] [-c results.csv] [-q quiet.adc] [disturbance.adc ...]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (period_count == 0 || max_threads < 1 || max_threads > MAX_THREADS) {
+		fprintf(stderr, "need at least one period and 1 to %d threads\n", MAX_THREADS);
+		return 1;
+	}
+	if (check_initial_shed()) {
+		return 1;
+	}
+	if (trace_count == 0) {
+		synthetic_corpus();
+		synthetic = 1;
+	}
+	for (i = 0; i < trace_count; i++) {
+		if (traces[i].n == 0) {
+			fprintf(stderr, "%s: empty\n", traces[i].name);
+			return 1;
+		}
+		prepare(&traces[i]);
+		samples += traces[i].n;
+	}
+
+	// f and r are stepped by count, so the grid does not depend on rounding of the sums
+	config_count = 0;
+	configs = malloc((size_t)((f_hi - f_lo) / f_step + 1.5) * (size_t)((r_hi - r_lo) / r_step + 1.5) * period_count * sizeof(config));
+	for (i = 0; (f = f_lo + i * f_step) <= f_hi + f_step / 2; i++) {
+		unsigned int j;
+		for (j = 0; (r = r_lo + j * r_step) <= r_hi + r_step / 2; j++) {
+			for (p = 0; p < period_count; p++) {
+				config *c = &configs[config_count++];
+				memset(c, 0, sizeof(*c));
+				c->freq_threshold = f;
+				c->roc_threshold = r;
+				c->period_ms = periods[p];
+			}
+		}
+	}
+	for (i = 0; i < MAX_THREADS; i++) {
+		pthread_mutex_init(&deques[i].lock, NULL);
+		deques[i].jobs = malloc(config_count * sizeof(unsigned int));
+	}
+	printf("%u configurations over %u traces, %.1f hours of samples (%s, RoC method %d)\n",
+		config_count, trace_count, samples / 50.0 / 3600.0, synthetic ? "synthetic" : "recorded", ROC_METHOD);
+
+	printf("%ld cores online\n  threads  seconds  speed-up  configs/s\n", cores);
+	for (threads = 1;; threads *= 2) {
+		if (threads > max_threads) {
+			threads = max_threads;
+		}
+		t = sweep(threads);
+		if (threads == 1) {
+			t1 = t;
+		}
+		printf("  %7u  %7.2f  %8.2f  %9.0f\n", threads, t, t1 / t, config_count / t);
+		if (threads == max_threads) {
+			break;
+		}
+	}
+
+	sorted = malloc(config_count * sizeof(config));
+	memcpy(sorted, configs, config_count * sizeof(config));
+	qsort(sorted, config_count, sizeof(config), rank);
+	printf("best configurations\n     Hz   Hz/s  ms    sheds  stable ms  unresolved  false  missed\n");
+	for (i = 0; i < TOP && i < config_count; i++) {
+		print_config(&sorted[i]);
+	}
+	printf("as shipped (FREQ_THRESHOLD 50, ROC_THRESHOLD 10, TIMER_PERIOD_MS 500)\n");
+	for (i = 0; i < config_count; i++) {
+		if (fabs(configs[i].freq_threshold - 50.0) < 1e-9 && fabs(configs[i].roc_threshold - 10.0) < 1e-9 && configs[i].period_ms == 500) {
+			print_config(&configs[i]);
+		}
+	}
+
+	if (csv != NULL) {
+		if ((out = fopen(csv, "w")) == NULL) {
+			perror(csv);
+			return 1;
+		}
+		fprintf(out, "freq_threshold,roc_threshold,period_ms,sheds,stable_ms,unresolved,false_trips,missed\n");
+		for (i = 0; i < config_count; i++) {
+			config *c = &configs[i];
+			fprintf(out, "%.3f,%.3f,%u,%lu,%.1f,%lu,%lu,%lu\n", c->freq_threshold, c->roc_threshold, c->period_ms,
+				c->sheds, mean_stable_ms(c), c->unresolved, c->false_trips, c->missed);
+		}
+		fclose(out);
+	}
+	return 0;
+}
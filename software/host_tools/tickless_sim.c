@@ -0,0 +1,370 @@
+/*
+ * Host simulation of the Nios II port tick timer (freertos/port_tick.c) against a
+ * model of the Avalon interval timer, to check tickless idle and measure the tick
+ * interrupts it saves.
+ *
+ * port_tick.c is built unchanged with portTICK_TIMER_SIMULATED, which swaps the
+ * kernel and Altera headers for port_tick_sim.h. The simulated timer counts in
+ * timer clocks, charges SIM_IO_CLOCKS per register access and SIM_IRQ_LATENCY
+ * before the tick handler runs, and a small scheduler model stands in for the
+ * freertos_test tasks:
+ *   Load_Management_Task  vTaskDelay(5), 20 us per pass
+ *   Log_Drain_Task        vTaskDelay(10), 20 us per pass
+ *   ROC task              woken by the frequency analyser interrupt every 20.03 ms, 100 us
+ *   VGA_Task              redraws for 4 ms, then vTaskDelay(throttle); a throttle of
+ *                         0 is the current free running loop, idle never runs
+ *
+ * For each VGA throttle it reports the tick interrupts per second with and without
+ * tickless idle, and checks that
+ *   - the kernel tick never drifts from the timer clock (worst lateness of a tick),
+ *   - ulPortGetTimestamp() follows the timer clock exactly,
+ *   - no delayed task is released late.
+ *
+ * build and run:
+ *   gcc -O2 -I. -o tickless_sim tickless_sim.c && ./tickless_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define portTICK_TIMER_SIMULATED
+#define SIM_IO_CLOCKS 5
+// clocks from latching the counter to the restart in prvElapsed() + prvRestart(): the
+// SNAPL write latches, then 3 reads and 4 writes, the last one starting the timer
+#define portTICK_TIMER_RESTART_CLOCKS (7 * SIM_IO_CLOCKS)
+#include "../freertos_test/freertos/port_tick.c"
+
+#define SIM_IRQ_LATENCY 150 // clocks from TO to the tick handler, 1.5 us
+#define SIM_POLL_CLOCKS 50 // clocks per pass of the tickless idle loop
+#define SIM_SECONDS 20
+#define CLOCKS_PER_MS (portTICK_TIMER_FREQ / 1000)
+
+typedef unsigned long long clocks_t;
+
+// ------------------------------------------------------------------ timer model
+static clocks_t now_clocks = 0;
+static uint32_t period_reg = 0, counter = 0, snap = 0;
+static int running = 0, cont = 0, ito = 0, timeout = 0;
+
+static void timer_advance(clocks_t n)
+{
+	while (n > 0) {
+		if (!running) {
+			now_clocks += n;
+			return;
+		}
+		if (counter >= n) {
+			counter -= n;
+			now_clocks += n;
+			return;
+		}
+		// counter reaches zero and reloads on the next clock
+		n -= (clocks_t)counter + 1;
+		now_clocks += (clocks_t)counter + 1;
+		counter = period_reg;
+		timeout = 1;
+		if (!cont) {
+			running = 0;
+		}
+	}
+}
+
+static clocks_t snap_clocks; // when the last snapshot was latched
+
+uint32_t sim_timer_read(int reg)
+{
+	timer_advance(SIM_IO_CLOCKS);
+	switch (reg) {
+	case ALTERA_AVALON_TIMER_STATUS_REG:
+		return (timeout ? ALTERA_AVALON_TIMER_STATUS_TO_MSK : 0) | (running ? ALTERA_AVALON_TIMER_STATUS_RUN_MSK : 0);
+	case ALTERA_AVALON_TIMER_SNAPL_REG:
+		return snap & 0xffff;
+	case ALTERA_AVALON_TIMER_SNAPH_REG:
+		return snap >> 16;
+	}
+	return 0;
+}
+
+void sim_timer_write(int reg, uint32_t data)
+{
+	timer_advance(SIM_IO_CLOCKS);
+	switch (reg) {
+	case ALTERA_AVALON_TIMER_STATUS_REG:
+		timeout = 0; // any write clears TO
+		break;
+	case ALTERA_AVALON_TIMER_CONTROL_REG:
+		ito = !!(data & ALTERA_AVALON_TIMER_CONTROL_ITO_MSK);
+		cont = !!(data & ALTERA_AVALON_TIMER_CONTROL_CONT_MSK);
+		if (data & ALTERA_AVALON_TIMER_CONTROL_STOP_MSK) {
+			running = 0;
+		} else if (data & ALTERA_AVALON_TIMER_CONTROL_START_MSK) {
+			running = 1;
+		}
+		break;
+	case ALTERA_AVALON_TIMER_PERIODL_REG:
+	case ALTERA_AVALON_TIMER_PERIODH_REG:
+		// writing either half stops the timer and loads the counter
+		if (reg == ALTERA_AVALON_TIMER_PERIODL_REG) {
+			period_reg = (period_reg & 0xffff0000) | (data & 0xffff);
+		} else {
+			period_reg = (period_reg & 0xffff) | ((data & 0xffff) << 16);
+		}
+		counter = period_reg;
+		running = 0;
+		break;
+	case ALTERA_AVALON_TIMER_SNAPL_REG:
+	case ALTERA_AVALON_TIMER_SNAPH_REG:
+		snap = counter;
+		snap_clocks = now_clocks;
+		break;
+	}
+}
+
+// ------------------------------------------------------------------ kernel model
+// tasks that block with vTaskDelay, highest priority first, the last one is VGA_Task
+#define NTASKS 3
+#define VGA (NTASKS - 1)
+static TickType_t task_period[NTASKS] = {5, 10, 0};
+static const clocks_t task_cost[NTASKS] = {20 * 100, 20 * 100, 4 * CLOCKS_PER_MS};
+static TickType_t task_due[NTASKS];
+static int task_blocked[NTASKS];
+static clocks_t task_left[NTASKS];
+#define SLICE_CLOCKS (100 * 100) // long tasks run in slices so higher priority ones can preempt them
+
+static TickType_t tick_count = 0, pended_ticks = 0;
+static int scheduler_suspended = 0, pended_ready = 0, roc_ready = 0;
+static int irq_enabled = 1, in_isr = 0;
+
+#define ANALYSER_PERIOD (20 * CLOCKS_PER_MS + 3000)
+#define ROC_COST (100 * 100)
+static clocks_t next_analyser = ANALYSER_PERIOD / 3;
+
+// results
+static clocks_t worst_tick_late = 0;
+static long long worst_ts_error = 0;
+static clocks_t ts_origin;
+static TickType_t worst_release_late = 0;
+static unsigned long analyser_irqs = 0;
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+	return tick_count;
+}
+
+eSleepModeStatus eTaskConfirmSleepModeStatus(void)
+{
+	return pended_ready ? eAbortSleep : eStandardSleep;
+}
+
+static TickType_t next_unblock(void)
+{
+	TickType_t next = tick_count + 100000;
+	int i;
+	for (i = 0; i < NTASKS; i++) {
+		if (task_blocked[i] && (TickType_t)(task_due[i] - next) > 0x80000000u) {
+			next = task_due[i];
+		}
+	}
+	return next;
+}
+
+void vTaskStepTick(const TickType_t xTicksToJump)
+{
+	if (tick_count + xTicksToJump > next_unblock()) {
+		printf("FAIL: stepped %u ticks past the next unblock time\n", (unsigned)xTicksToJump);
+		exit(1);
+	}
+	tick_count += xTicksToJump;
+}
+
+static void tick_isr(void)
+{
+	clocks_t ideal;
+	if (scheduler_suspended) {
+		pended_ticks++;
+	} else {
+		tick_count++;
+	}
+	vPortTickTimerExpired();
+	if (xSleeping != pdFALSE || scheduler_suspended) {
+		return; // the tick count is only put right once tickless idle returns
+	}
+	// how late this tick is against the ideal grid (tick n at n ms after the timer start)
+	ideal = (clocks_t)tick_count * portTICK_TIMER_RELOAD + ts_origin;
+	if (now_clocks > ideal && now_clocks - ideal > worst_tick_late) {
+		worst_tick_late = now_clocks - ideal;
+	}
+}
+
+static void deliver_irqs(void)
+{
+	if (!irq_enabled || in_isr) {
+		return;
+	}
+	in_isr = 1;
+	irq_enabled = 0;
+	if (timeout && ito) {
+		timer_advance(SIM_IRQ_LATENCY);
+		tick_isr();
+	}
+	if (now_clocks >= next_analyser) {
+		analyser_irqs++;
+		next_analyser += ANALYSER_PERIOD;
+		roc_ready = 1;
+		if (scheduler_suspended) {
+			pended_ready = 1;
+		}
+	}
+	irq_enabled = 1;
+	in_isr = 0;
+}
+
+alt_irq_context alt_irq_disable_all(void)
+{
+	alt_irq_context was = irq_enabled;
+	irq_enabled = 0;
+	return was;
+}
+
+void alt_irq_enable_all(alt_irq_context context)
+{
+	irq_enabled = context;
+	deliver_irqs();
+}
+
+// runs for n clocks with interrupts enabled
+static void busy(clocks_t n)
+{
+	while (n > 0) {
+		clocks_t step = n < SIM_POLL_CLOCKS ? n : SIM_POLL_CLOCKS;
+		timer_advance(step);
+		n -= step;
+		deliver_irqs();
+	}
+}
+
+void sim_sleep_poll(void)
+{
+	busy(SIM_POLL_CLOCKS);
+}
+
+static void check_timestamp(void)
+{
+	uint32_t ts = ulPortGetTimestamp();
+	long long err = (long long)(int32_t)(ts - (uint32_t)(snap_clocks - ts_origin));
+	if (llabs(err) > llabs(worst_ts_error)) {
+		worst_ts_error = err;
+	}
+}
+
+static void resume_all(void)
+{
+	scheduler_suspended = 0;
+	tick_count += pended_ticks;
+	pended_ticks = 0;
+	pended_ready = 0;
+}
+
+// one run of the workload, returns tick interrupts per second
+static double run(TickType_t vga_throttle, int tickless)
+{
+	clocks_t end;
+	int i;
+
+	now_clocks = 0;
+	period_reg = counter = snap = 0;
+	running = cont = ito = timeout = 0;
+	tick_count = pended_ticks = 0;
+	scheduler_suspended = pended_ready = roc_ready = 0;
+	irq_enabled = 1;
+	next_analyser = ANALYSER_PERIOD / 3;
+	worst_tick_late = 0;
+	worst_ts_error = 0;
+	worst_release_late = 0;
+	analyser_irqs = 0;
+	ulTickInterrupts = 0;
+	task_period[VGA] = vga_throttle;
+	for (i = 0; i < NTASKS; i++) {
+		task_due[i] = 0;
+		task_blocked[i] = 1;
+		task_left[i] = task_cost[i];
+	}
+
+	irq_enabled = 0;
+	vPortTickTimerStart();
+	ts_origin = now_clocks; // the timestamp reads 0 as the first tick period starts
+	irq_enabled = 1;
+	end = ts_origin + (clocks_t)SIM_SECONDS * portTICK_TIMER_FREQ;
+
+	while (now_clocks < end) {
+		clocks_t left;
+
+		// preemptive priority scheduling: the ROC task, then the delayed tasks in order, then idle
+		if (roc_ready) {
+			roc_ready = 0;
+			busy(ROC_COST);
+			continue;
+		}
+		for (i = 0; i < NTASKS; i++) {
+			if (task_blocked[i] && (TickType_t)(tick_count - task_due[i]) < 0x80000000u) {
+				if (tick_count - task_due[i] > worst_release_late) {
+					worst_release_late = tick_count - task_due[i];
+				}
+				task_blocked[i] = 0;
+				task_left[i] = task_cost[i];
+			}
+			if (!task_blocked[i]) {
+				break;
+			}
+		}
+		if (i < NTASKS) {
+			left = task_left[i] < SLICE_CLOCKS ? task_left[i] : SLICE_CLOCKS;
+			busy(left);
+			task_left[i] -= left;
+			if (task_left[i] == 0) {
+				check_timestamp();
+				// a throttle of 0 is the free running VGA loop, it never blocks
+				task_blocked[i] = task_period[i] != 0;
+				task_due[i] = tick_count + task_period[i];
+				task_left[i] = task_cost[i];
+			}
+			continue;
+		}
+
+		// idle task
+		if (tickless && next_unblock() - tick_count >= 2) {
+			scheduler_suspended = 1;
+			if (next_unblock() - tick_count >= 2) {
+				vPortSuppressTicksAndSleep(next_unblock() - tick_count);
+			}
+			irq_enabled = 0;
+			resume_all();
+			irq_enabled = 1;
+			deliver_irqs();
+			check_timestamp();
+		} else {
+			busy(SIM_POLL_CLOCKS);
+		}
+	}
+	return ulPortTickInterrupts() / (double)SIM_SECONDS;
+}
+
+int main(void)
+{
+	static const TickType_t throttles[] = {0, 15, 50, 100};
+	unsigned int i;
+	int failed = 0;
+
+	printf("%d s simulated, %.1f analyser interrupts/s\n", SIM_SECONDS, (double)portTICK_TIMER_FREQ / ANALYSER_PERIOD);
+	printf("vga throttle | tick irq/s periodic | tick irq/s tickless | reduction | worst tick late | worst timestamp error | worst release late\n");
+	for (i = 0; i < sizeof(throttles) / sizeof(throttles[0]); i++) {
+		double periodic = run(throttles[i], 0);
+		double tickless = run(throttles[i], 1);
+		printf("%9u ms | %19.1f | %19.1f | %8.1f%% | %12.2f us | %15lld clocks | %11u ticks\n",
+			(unsigned)throttles[i], periodic, tickless, 100.0 * (periodic - tickless) / periodic,
+			worst_tick_late / 100.0, worst_ts_error, (unsigned)worst_release_late);
+		failed |= worst_ts_error != 0 || worst_release_late > 0 || worst_tick_late > 10000;
+	}
+	printf(failed ? "FAIL\n" : "ok\n");
+	return failed;
+}
@@ -0,0 +1,177 @@
+/*
+ * Host benchmark of the software timer backends in freertos/timers.c, at 10, 100 and 10000 active
+ * timers:
+ *   list  - the sorted active list, vListInsert() on start (configUSE_TIMER_WHEEL 0)
+ *   wheel - the hierarchical timing wheel in freertos/timer_wheel.c (configUSE_TIMER_WHEEL 1)
+ * list.c and timer_wheel.c are built unchanged with tmrWHEEL_SIMULATED, which swaps the kernel
+ * headers for timer_wheel_sim.h.
+ *
+ * Timers have random periods of 1 to MAX_PERIOD ticks. For each count it times
+ *   stop  - removing a running timer, as prvProcessReceivedCommands() does before any command
+ *   start - inserting a stopped timer with a new expiry time
+ *   run   - the timer task's work per expiry with every timer auto reloading: asking for the next
+ *           expiry time, taking the expired timer and inserting it again. Time jumps straight to
+ *           each next expiry time, as the timer task sleeps until it
+ * and checks that the wheel expires every timer exactly on its expiry tick, including across the
+ * tick count wrapping (the runs with fewer timers pass it). The list model has no overflow list, so its run starts where it can't wrap.
+ *
+ * build and run:
+ *   gcc -O2 -I. -I../freertos_test/freertos -o timer_wheel_bench timer_wheel_bench.c && ./timer_wheel_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define tmrWHEEL_SIMULATED
+#include "timer_wheel.h"
+#include "../freertos_test/freertos/list.c"
+#include "../freertos_test/freertos/timer_wheel.c"
+
+#define MAX_TIMERS 10000
+#define MAX_PERIOD 5000
+#define OPS 2000000 // operations per count up to 100 timers, scaled down above so the list finishes
+#define START_TIME ((TickType_t)0 - 1000000) // wraps during the run
+
+typedef struct {
+	ListItem_t item;
+	TickType_t period;
+} timer;
+
+static timer timers[MAX_TIMERS];
+static List_t active;
+static TimerWheel_t wheel;
+static uint32_t seed = 1;
+
+static uint32_t rnd(void)
+{
+	seed = seed * 1664525 + 1013904223;
+	return seed >> 8;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void setup(unsigned int n, int use_wheel, TickType_t now)
+{
+	unsigned int i;
+
+	vListInitialise(&active);
+	vTimerWheelInitialise(&wheel, now);
+	for (i = 0; i < n; i++) {
+		vListInitialiseItem(&timers[i].item);
+		listSET_LIST_ITEM_OWNER(&timers[i].item, &timers[i]);
+		timers[i].period = 1 + rnd() % MAX_PERIOD;
+		listSET_LIST_ITEM_VALUE(&timers[i].item, now + timers[i].period);
+		if (use_wheel) {
+			vTimerWheelInsert(&wheel, &timers[i].item, now);
+		} else {
+			vListInsert(&active, &timers[i].item);
+		}
+	}
+}
+
+// Times stopping and starting random timers, ns per operation
+static void start_stop(unsigned int n, unsigned int ops, int use_wheel, double *stop_ns, double *start_ns)
+{
+	static unsigned int picks[MAX_TIMERS];
+	unsigned int batch = n < 1000 ? n : 1000, rounds = ops / batch, r, i;
+	TickType_t now = START_TIME;
+	double t, stop = 0, start = 0;
+
+	setup(n, use_wheel, now);
+	for (r = 0; r < rounds; r++) {
+		// distinct timers, a random window of the array
+		unsigned int first = rnd() % n;
+		for (i = 0; i < batch; i++) {
+			picks[i] = (first + i) % n;
+		}
+		t = now_ns();
+		for (i = 0; i < batch; i++) {
+			if (use_wheel) {
+				vTimerWheelRemove(&wheel, &timers[picks[i]].item);
+			} else {
+				(void)uxListRemove(&timers[picks[i]].item);
+			}
+		}
+		stop += now_ns() - t;
+		for (i = 0; i < batch; i++) {
+			listSET_LIST_ITEM_VALUE(&timers[picks[i]].item, now + 1 + rnd() % MAX_PERIOD);
+		}
+		t = now_ns();
+		for (i = 0; i < batch; i++) {
+			if (use_wheel) {
+				vTimerWheelInsert(&wheel, &timers[picks[i]].item, now);
+			} else {
+				vListInsert(&active, &timers[picks[i]].item);
+			}
+		}
+		start += now_ns() - t;
+	}
+	*stop_ns = stop / ((double)rounds * batch);
+	*start_ns = start / ((double)rounds * batch);
+}
+
+// Runs auto reloading timers through ops expiries, ns per expiry
+static double run(unsigned int n, unsigned int ops, int use_wheel)
+{
+	TickType_t now = use_wheel ? START_TIME : 0, next, expiry;
+	BaseType_t empty;
+	ListItem_t *item;
+	timer *tm;
+	unsigned int done = 0;
+	double t;
+
+	setup(n, use_wheel, now);
+	t = now_ns();
+	while (done < ops) {
+		if (use_wheel) {
+			next = xTimerWheelNextExpireTime(&wheel, &empty);
+			now = next;
+			while ((item = pxTimerWheelNextExpired(&wheel, now)) != NULL) {
+				tm = listGET_LIST_ITEM_OWNER(item);
+				expiry = listGET_LIST_ITEM_VALUE(item);
+				if (expiry != now) {
+					fprintf(stderr, "wheel expired a timer due at %u at %u\n", (unsigned int)expiry, (unsigned int)now);
+					exit(1);
+				}
+				listSET_LIST_ITEM_VALUE(item, expiry + tm->period);
+				vTimerWheelInsert(&wheel, item, now);
+				done++;
+			}
+		} else {
+			now = listGET_ITEM_VALUE_OF_HEAD_ENTRY(&active);
+			tm = listGET_OWNER_OF_HEAD_ENTRY(&active);
+			(void)uxListRemove(&tm->item);
+			listSET_LIST_ITEM_VALUE(&tm->item, now + tm->period);
+			vListInsert(&active, &tm->item);
+			done++;
+		}
+	}
+	return (now_ns() - t) / done;
+}
+
+int main(void)
+{
+	static const unsigned int counts[] = {10, 100, 10000};
+	double stop[2], start[2], per_expiry[2];
+	unsigned int c, n, ops;
+	int w;
+
+	printf("ns per operation, periods of 1 to %d ticks\n", MAX_PERIOD);
+	printf("  timers    list stop  wheel stop   list start  wheel start   list run  wheel run\n");
+	for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		n = counts[c];
+		ops = n > 100 ? OPS / (n / 100) : OPS;
+		for (w = 0; w < 2; w++) {
+			start_stop(n, ops, w, &stop[w], &start[w]);
+			per_expiry[w] = run(n, ops, w);
+		}
+		printf("  %6u  %11.1f  %10.1f  %11.1f  %11.1f  %9.1f  %9.1f\n", n, stop[0], stop[1], start[0], start[1], per_expiry[0], per_expiry[1]);
+	}
+	return 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * Stand-ins for the kernel definitions used by
+ * software/freertos_test/freertos/list.c and timer_wheel.c, so
+ * timer_wheel_bench.c can build them on the host.  list.h itself is the
+ * kernel's.
+ */
+
+#ifndef TIMER_WHEEL_SIM_H
+#define TIMER_WHEEL_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define portMAX_DELAY ( TickType_t ) 0xffffffffUL
+
+#define configUSE_TIMERS 1
+#define configUSE_TIMER_WHEEL 1
+#define configUSE_16_BIT_TICKS 0
+#define configUSE_LIST_DATA_INTEGRITY_CHECK_BYTES 0
+#define configASSERT( x )
+#define mtCOVERAGE_TEST_MARKER()
+#define PRIVILEGED_FUNCTION
+
+/* list.c includes FreeRTOS.h, which is skipped once this guard is defined */
+#define INC_FREERTOS_H
+#include "list.h"
+
+#endif /* TIMER_WHEEL_SIM_H */
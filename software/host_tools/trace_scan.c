@@ -0,0 +1,436 @@
+/*
+ * Offline stability analysis of captured analyser traces, with the relay's own RoC method and
+ * threshold test, fast enough for weeks of captures.
+ *
+ * Input is the analyser's period counts at 16 kHz, one per mains cycle, as little endian u32:
+ *   telemetry_decode.py --adc run.adc run.bin > run.csv && ./trace_scan run.adc
+ * By default each sample goes through freq_channel.c with ROC_METHOD, the method
+ * ROC_Calculation_Task uses, one sample at a time, so the flags are the relay's.
+ *
+ * The SIMD kernels cover only the ROC_TWO_POINT method (-m two), the relay's original one:
+ *   f = 16000.0 / adc
+ *   roc = (f - prev) * 2.0 * f * prev / (f + prev), clamped at +100 Hz/s only
+ *   unstable = f < freq threshold || |roc| >= roc threshold
+ * in double precision, with the same IEEE operations in the same order as the target's soft-float
+ * code, so every f, roc and flag matches freq_channel.c in two-point mode bit for bit. Build with
+ * -ffp-contract=off so no multiply and add are ever fused. prev is 0 for the first sample, as
+ * after a reset. Only prev links one sample to the next, and it is just the previous sample's f,
+ * so the kernels run 4 samples per AVX2 instruction or 2 per SSE2 one and take prev from the
+ * neighbouring lane. AVX2 is used when the CPU has it, SSE2 otherwise, and a scalar loop off x86.
+ * The least squares and IIR methods carry running sums from sample to sample and have no SIMD
+ * kernel.
+ *
+ * Prints the unstable samples, the unstable episodes (runs of unstable samples) and where the first
+ * ones start. Without a file it generates a week of samples in memory, checks every kernel against
+ * freq_channel.c in two-point mode bit for bit and reports their throughput in GB/s of capture.
+ *
+ * build and run:
+ *   gcc -O2 -ffp-contract=off -I../freertos_test -o trace_scan trace_scan.c ../freertos_test/freq_channel.c ../freertos_test/roc_estimator.c -lm
+ *   ./trace_scan [-f Hz] [-r Hz/s] [-m two|lsq|iir] [-k scalar|sse2|avx2] [-e episodes] [capture.adc]
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#else
+#define HAVE_X86 0
+#endif
+
+#include "freq_channel.h"
+
+#define SAMPLING_FREQ 16000.0
+#define NOMINAL 50.0
+#define FREQ_THRESHOLD 50.0 // Hz, the relay's power up thresholds
+#define ROC_THRESHOLD 10.0 // Hz/s
+#define ROC_TWO_POINT_CLAMP 100.0
+#define BLOCK (1u << 20) // samples read and scanned at a time, a multiple of 64
+#define SYNTHETIC (7u * 24 * 3600 * 50) // a week at 50 Hz
+
+typedef struct {
+	double freq; // unstable below it
+	double roc; // unstable at or above it in either direction
+} limits;
+
+// Scans n samples following one of frequency prev. Sets bit i of unstable (byte i / 8, bit i % 8)
+// for each unstable sample and clears the others, stores f and roc when freq is not NULL, and
+// returns the last sample's f
+typedef double (*kernel_fn)(const uint32_t *adc, size_t n, double prev, const limits *l, uint8_t *unstable, double *freq, double *roc);
+
+typedef struct {
+	const char *name;
+	kernel_fn scan;
+	int available;
+} kernel;
+
+typedef struct {
+	uint64_t samples;
+	uint64_t unstable;
+	uint64_t episodes;
+	unsigned int last; // whether the last sample so far was unstable
+	unsigned int to_print; // episode starts still to be printed
+} summary;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// The ROC_TWO_POINT arithmetic of roc_estimator.c
+static double two_point(double f, double prev)
+{
+	double roc = (f - prev) * 2.0 * f * prev / (f + prev);
+	if (roc > ROC_TWO_POINT_CLAMP) {
+		roc = ROC_TWO_POINT_CLAMP;
+	}
+	return roc;
+}
+
+// Samples i to n - 1, for the kernels' tails too
+static double scan_scalar_from(const uint32_t *adc, size_t i, size_t n, double prev, const limits *l, uint8_t *unstable, double *freq, double *roc)
+{
+	double f, r;
+
+	for (; i < n; i++) {
+		f = SAMPLING_FREQ / (double)adc[i];
+		r = two_point(f, prev);
+		if ((i & 7) == 0) {
+			unstable[i >> 3] = 0;
+		}
+		if ((f < l->freq) || (fabs(r) >= l->roc)) {
+			unstable[i >> 3] |= 1u << (i & 7);
+		}
+		if (freq) {
+			freq[i] = f;
+			roc[i] = r;
+		}
+		prev = f;
+	}
+	return prev;
+}
+
+static double scan_scalar(const uint32_t *adc, size_t n, double prev, const limits *l, uint8_t *unstable, double *freq, double *roc)
+{
+	return scan_scalar_from(adc, 0, n, prev, l, unstable, freq, roc);
+}
+
+#if HAVE_X86
+static double scan_sse2(const uint32_t *adc, size_t n, double prev, const limits *l, uint8_t *unstable, double *freq, double *roc)
+{
+	const __m128d k = _mm_set1_pd(SAMPLING_FREQ), two = _mm_set1_pd(2.0), clamp = _mm_set1_pd(ROC_TWO_POINT_CLAMP);
+	const __m128d fth = _mm_set1_pd(l->freq), rth = _mm_set1_pd(l->roc), zero = _mm_setzero_pd();
+	const __m128d wrap = _mm_set1_pd(4294967296.0), abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+	__m128d carry = _mm_set1_pd(prev), c, f, p, r, m, u;
+	unsigned int bits, q;
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		bits = 0;
+		for (q = 0; q < 4; q++) {
+			c = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i *)(adc + i + 2 * q)));
+			c = _mm_add_pd(c, _mm_and_pd(_mm_cmplt_pd(c, zero), wrap)); // counts of 2^31 and up
+			f = _mm_div_pd(k, c);
+			p = _mm_shuffle_pd(carry, f, 1); // the last f of the previous pair, then this pair's first
+			carry = f;
+			r = _mm_div_pd(_mm_mul_pd(_mm_mul_pd(_mm_mul_pd(_mm_sub_pd(f, p), two), f), p), _mm_add_pd(f, p));
+			m = _mm_cmpgt_pd(r, clamp);
+			r = _mm_or_pd(_mm_andnot_pd(m, r), _mm_and_pd(m, clamp));
+			u = _mm_or_pd(_mm_cmplt_pd(f, fth), _mm_cmpge_pd(_mm_and_pd(r, abs_mask), rth));
+			bits |= (unsigned int)_mm_movemask_pd(u) << (2 * q);
+			if (freq) {
+				_mm_storeu_pd(freq + i + 2 * q, f);
+				_mm_storeu_pd(roc + i + 2 * q, r);
+			}
+		}
+		unstable[i >> 3] = bits;
+	}
+	prev = _mm_cvtsd_f64(_mm_unpackhi_pd(carry, carry));
+	return scan_scalar_from(adc, i, n, prev, l, unstable, freq, roc);
+}
+
+__attribute__((target("avx2")))
+static double scan_avx2(const uint32_t *adc, size_t n, double prev, const limits *l, uint8_t *unstable, double *freq, double *roc)
+{
+	const __m256d k = _mm256_set1_pd(SAMPLING_FREQ), two = _mm256_set1_pd(2.0), clamp = _mm256_set1_pd(ROC_TWO_POINT_CLAMP);
+	const __m256d fth = _mm256_set1_pd(l->freq), rth = _mm256_set1_pd(l->roc), zero = _mm256_setzero_pd();
+	const __m256d wrap = _mm256_set1_pd(4294967296.0), abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+	__m256d carry = _mm256_set1_pd(prev), c, f, rot, p, r, u;
+	unsigned int bits, h;
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		bits = 0;
+		for (h = 0; h < 2; h++) {
+			c = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(adc + i + 4 * h)));
+			c = _mm256_add_pd(c, _mm256_and_pd(_mm256_cmp_pd(c, zero, _CMP_LT_OQ), wrap));
+			f = _mm256_div_pd(k, c);
+			rot = _mm256_permute4x64_pd(f, _MM_SHUFFLE(2, 1, 0, 3)); // f3 f0 f1 f2
+			p = _mm256_blend_pd(rot, carry, 1); // lane 0 from the previous quad's f3
+			carry = rot;
+			r = _mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_sub_pd(f, p), two), f), p), _mm256_add_pd(f, p));
+			r = _mm256_blendv_pd(r, clamp, _mm256_cmp_pd(r, clamp, _CMP_GT_OQ));
+			u = _mm256_or_pd(_mm256_cmp_pd(f, fth, _CMP_LT_OQ), _mm256_cmp_pd(_mm256_and_pd(r, abs_mask), rth, _CMP_GE_OQ));
+			bits |= (unsigned int)_mm256_movemask_pd(u) << (4 * h);
+			if (freq) {
+				_mm256_storeu_pd(freq + i + 4 * h, f);
+				_mm256_storeu_pd(roc + i + 4 * h, r);
+			}
+		}
+		unstable[i >> 3] = bits;
+	}
+	prev = _mm256_cvtsd_f64(carry);
+	return scan_scalar_from(adc, i, n, prev, l, unstable, freq, roc);
+}
+#endif
+
+static kernel kernels[] = {
+	{"scalar", scan_scalar, 1},
+#if HAVE_X86
+	{"sse2", scan_sse2, 1},
+	{"avx2", scan_avx2, 0},
+#endif
+};
+#define KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+// The target's own code, any method. The channel's ring stands in for the prev carried by the kernels
+static void scan_channel(freq_channel *c, const uint32_t *adc, size_t n, const limits *l, uint8_t *unstable, double *freq, double *roc)
+{
+	double f;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		f = SAMPLING_FREQ / (double)adc[i];
+		if ((i & 7) == 0) {
+			unstable[i >> 3] = 0;
+		}
+		if (!freq_channel_update(c, f, l->freq, l->roc)) {
+			unstable[i >> 3] |= 1u << (i & 7);
+		}
+		if (freq) {
+			freq[i] = f;
+			roc[i] = freq_channel_roc(c, FREQ_CHANNEL_SAMPLES - 1);
+		}
+	}
+}
+
+// Adds a block's flags to the summary, base being the index of its first sample
+static void summarise(summary *s, const uint8_t *unstable, size_t n, uint64_t base, const uint32_t *adc)
+{
+	uint64_t w, starts;
+	size_t k, words = (n + 63) / 64, i;
+
+	for (k = 0; k < words; k++) {
+		w = 0;
+		memcpy(&w, unstable + 8 * k, (n - 64 * k) >= 64 ? 8 : (n - 64 * k + 7) / 8);
+		if (n - 64 * k < 64) {
+			w &= (1ull << (n - 64 * k)) - 1;
+		}
+		starts = w & ~((w << 1) | s->last);
+		s->unstable += __builtin_popcountll(w);
+		s->episodes += __builtin_popcountll(starts);
+		for (; starts != 0 && s->to_print > 0; starts &= starts - 1, s->to_print--) {
+			i = 64 * k + __builtin_ctzll(starts);
+			printf("  episode at sample %llu (%.1f s): %u counts, %.6f Hz\n", (unsigned long long)(base + i),
+				(base + i) / NOMINAL, adc[i], SAMPLING_FREQ / (double)adc[i]);
+		}
+		s->last = (n - 64 * k) >= 64 ? w >> 63 : (w >> (n - 64 * k - 1)) & 1;
+	}
+	s->samples += n;
+}
+
+static void print_summary(const summary *s)
+{
+	printf("%llu samples (%.1f h), %llu unstable, %llu unstable episodes\n", (unsigned long long)s->samples,
+		s->samples / NOMINAL / 3600.0, (unsigned long long)s->unstable, (unsigned long long)s->episodes);
+}
+
+static const kernel *pick_kernel(const char *name)
+{
+	unsigned int i;
+
+	if (name == NULL) {
+		for (i = KERNELS; i-- > 0;) {
+			if (kernels[i].available) {
+				return &kernels[i]; // the widest one the CPU has
+			}
+		}
+		return NULL;
+	}
+	for (i = 0; i < KERNELS; i++) {
+		if (strcmp(kernels[i].name, name) == 0) {
+			if (!kernels[i].available) {
+				fprintf(stderr, "%s is not supported by this CPU\n", name);
+				return NULL;
+			}
+			return &kernels[i];
+		}
+	}
+	fprintf(stderr, "unknown kernel %s\n", name);
+	return NULL;
+}
+
+static int scan_file(const char *path, const kernel *kn, int method, const limits *l, unsigned int episodes)
+{
+	static uint32_t adc[BLOCK];
+	static uint8_t unstable[BLOCK / 8];
+	FILE *fp = fopen(path, "rb");
+	summary s = {0};
+	freq_channel c;
+	double prev = 0, t0, scan = 0;
+	size_t n;
+
+	if (fp == NULL) {
+		perror(path);
+		return 1;
+	}
+	freq_channel_init(&c, method, ROC_WINDOW, ROC_IIR_ALPHA);
+	s.to_print = episodes;
+	t0 = now_ns();
+	while ((n = fread(adc, sizeof(adc[0]), BLOCK, fp)) > 0) {
+		// the file is little endian, as is every host this builds on with SIMD
+		double t = now_ns();
+		if (method == ROC_TWO_POINT) {
+			prev = kn->scan(adc, n, prev, l, unstable, NULL, NULL);
+		}
+		else {
+			scan_channel(&c, adc, n, l, unstable, NULL, NULL);
+		}
+		scan += now_ns() - t;
+		summarise(&s, unstable, n, s.samples, adc);
+	}
+	fclose(fp);
+	print_summary(&s);
+	printf("%s: %.2f GB/s scanning, %.2f GB/s including reading the file\n",
+		method == ROC_TWO_POINT ? kn->name : "freq_channel.c", s.samples * 4.0 / scan, s.samples * 4.0 / (now_ns() - t0));
+	return 0;
+}
+
+// 50.3 Hz with one period in 32 a count long or short, dropping to 49.1 Hz for four seconds every
+// ten minutes
+static uint32_t *synthesise(size_t n)
+{
+	uint32_t *adc = malloc(n * sizeof(*adc)), seed = 1;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		seed = seed * 1664525 + 1013904223;
+		adc[i] = 318 + (seed >> 26 == 0) - (seed >> 26 == 63) + (i % 30000 < 200 ? 8 : 0);
+	}
+	return adc;
+}
+
+// Compares kn with freq_channel.c one block at a time, bit for bit
+static int verify(const kernel *kn, const uint32_t *adc, size_t n, const limits *l)
+{
+	static double freq[2][BLOCK], roc[2][BLOCK];
+	static uint8_t unstable[2][BLOCK / 8];
+	freq_channel c;
+	double prev = 0;
+	size_t at, m, i;
+
+	freq_channel_init(&c, ROC_TWO_POINT, 2, 0);
+	for (at = 0; at < n; at += m) {
+		m = n - at < BLOCK ? n - at : BLOCK;
+		prev = kn->scan(adc + at, m, prev, l, unstable[0], freq[0], roc[0]);
+		scan_channel(&c, adc + at, m, l, unstable[1], freq[1], roc[1]);
+		if (memcmp(freq[0], freq[1], m * sizeof(double)) || memcmp(roc[0], roc[1], m * sizeof(double))
+			|| memcmp(unstable[0], unstable[1], (m + 7) / 8)) {
+			for (i = 0; i < m && !memcmp(&freq[0][i], &freq[1][i], sizeof(double)) && !memcmp(&roc[0][i], &roc[1][i], sizeof(double)); i++) {
+			}
+			printf("%s differs from freq_channel.c near sample %zu\n", kn->name, at + i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void benchmark(const limits *l, unsigned int episodes)
+{
+	static uint8_t unstable[SYNTHETIC / 8 + 8];
+	uint32_t *adc = synthesise(SYNTHETIC);
+	freq_channel c;
+	summary s = {0};
+	double t, reference;
+	unsigned int i;
+
+	printf("a week of synthetic samples, %.0f MB, thresholds %.2f Hz and %.1f Hz/s\n", SYNTHETIC * 4.0 / 1e6, l->freq, l->roc);
+	freq_channel_init(&c, ROC_TWO_POINT, 2, 0);
+	t = now_ns();
+	scan_channel(&c, adc, SYNTHETIC, l, unstable, NULL, NULL);
+	reference = now_ns() - t;
+	s.to_print = episodes;
+	summarise(&s, unstable, SYNTHETIC, 0, adc);
+	print_summary(&s);
+	printf("  %-16s %6.2f GB/s\n", "freq_channel.c", SYNTHETIC * 4.0 / reference);
+
+	for (i = 0; i < KERNELS; i++) {
+		if (!kernels[i].available) {
+			printf("  %-16s not supported by this CPU\n", kernels[i].name);
+			continue;
+		}
+		if (verify(&kernels[i], adc, SYNTHETIC, l)) {
+			continue;
+		}
+		t = now_ns();
+		kernels[i].scan(adc, SYNTHETIC, 0, l, unstable, NULL, NULL);
+		t = now_ns() - t;
+		printf("  %-16s %6.2f GB/s  %5.1fx, bit exact\n", kernels[i].name, SYNTHETIC * 4.0 / t, reference / t);
+	}
+	free(adc);
+}
+
+int main(int argc, char *argv[])
+{
+	limits l = {FREQ_THRESHOLD, ROC_THRESHOLD};
+	const char *path = NULL, *kernel_name = NULL;
+	const kernel *kn;
+	unsigned int episodes = 10;
+	int method = ROC_METHOD, i; // as the relay, -m two for the SIMD kernels
+
+#if HAVE_X86
+	kernels[KERNELS - 1].available = __builtin_cpu_supports("avx2");
+#endif
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			l.freq = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			l.roc = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			i++;
+			method = strcmp(argv[i], "lsq") == 0 ? ROC_LEAST_SQUARES : strcmp(argv[i], "iir") == 0 ? ROC_IIR : ROC_TWO_POINT;
+		}
+		else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+			kernel_name = argv[++i];
+		}
+		else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+			episodes = atoi(argv[++i]);
+		}
+		else if (argv[i][0] != '-' && path == NULL) {
+			path = argv[i];
+		}
+		else {
+			fprintf(stderr, "usage: %s [-f Hz] [-r Hz/s] [-m two|lsq|iir] [-k scalar|sse2|avx2] [-e episodes] [capture.adc]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (path == NULL) {
+		benchmark(&l, episodes);
+		return 0;
+	}
+	kn = pick_kernel(kernel_name);
+	if (kn == NULL) {
+		return 2;
+	}
+	return scan_file(path, kn, method, &l, episodes);
+}